@@ -0,0 +1,393 @@
+#include "adc_dsp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "adc_stream.h"
+
+static const char *TAG = "ADC_DSP";
+
+#define BLOCK_SAMPLES       CONFIG_ADC_STREAM_BLOCK_SAMPLES
+#define DECIM_MAX           1024
+#define WINDOW_MAX          100000
+#define STREAM_MAX_BLOCKS   100000
+#define STREAM_MAX_MS       CONFIG_ADC_STREAM_MAX_MS    // whole stream, also bounds ms
+#define POLL_MS             5
+#define LINE_LEN            512
+#define STREAM_TASK_STACK   4096        // vsnprintf of floats
+#define STREAM_TASK_PRIO    5
+#define BENCH_FIR_TAPS      DSP_FIR_MAX_TAPS
+
+/* ====== Pipeline ====== */
+
+static bool is_count(float v, float max)
+{
+    return v >= 1.0f && v <= max && v == floorf(v);
+}
+
+esp_err_t adc_dsp_parse(adc_dsp_pipeline_t *p, const char *spec, float rate_hz)
+{
+    ESP_RETURN_ON_FALSE(p && spec && rate_hz > 0.0f, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    memset(p, 0, sizeof(*p));
+    p->out = ADC_DSP_OUT_SAMPLES;
+    float rate = rate_hz;
+
+    const char *s = spec;
+    while (*s) {
+        // RMS/peak reduce the signal to results, nothing can follow them
+        if (p->out != ADC_DSP_OUT_SAMPLES) return ESP_ERR_INVALID_ARG;
+
+        char name[8];
+        size_t k = 0;
+        while (*s && *s != ':' && *s != ',') {
+            if (k >= sizeof(name) - 1) return ESP_ERR_INVALID_ARG;
+            name[k++] = *s++;
+        }
+        name[k] = '\0';
+
+        float args[2];
+        int nargs = 0;
+        while (*s == ':') {
+            char *end;
+            float v = strtof(++s, &end);
+            if (end == s || nargs == 2) return ESP_ERR_INVALID_ARG;
+            args[nargs++] = v;
+            s = end;
+        }
+        if (*s == ',') {
+            s++;
+        } else if (*s) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        bool reducer = !strcmp(name, "rms") || !strcmp(name, "peak");
+        if (!reducer && p->n_stages == ADC_DSP_MAX_STAGES) return ESP_ERR_INVALID_ARG;
+        adc_dsp_stage_t *st = &p->stages[p->n_stages];
+
+        if (reducer) {
+            if (nargs != 1 || !is_count(args[0], WINDOW_MAX)) return ESP_ERR_INVALID_ARG;
+            p->out = name[0] == 'r' ? ADC_DSP_OUT_RMS : ADC_DSP_OUT_PEAK;
+            p->window = (uint32_t)args[0];
+            rate /= args[0];
+        } else if (!strcmp(name, "decim")) {
+            if (nargs != 1 || !is_count(args[0], DECIM_MAX)) return ESP_ERR_INVALID_ARG;
+            st->kind = ADC_DSP_DECIM;
+            dsp_decim_init(&st->decim, (uint32_t)args[0]);
+            rate /= args[0];
+            p->n_stages++;
+        } else if (!strcmp(name, "fir")) {
+            if (nargs != 2 || !is_count(args[0], DSP_FIR_MAX_TAPS)) return ESP_ERR_INVALID_ARG;
+            if (args[1] <= 0.0f || args[1] >= rate / 2.0f) return ESP_ERR_INVALID_ARG;
+            st->kind = ADC_DSP_FIR;
+            dsp_fir_init_lowpass(&st->fir, (uint32_t)args[0], args[1] / rate);
+            p->n_stages++;
+        } else if (!strcmp(name, "lp") || !strcmp(name, "hp")) {
+            if (nargs != 1 || args[0] <= 0.0f || args[0] >= rate / 2.0f) return ESP_ERR_INVALID_ARG;
+            st->kind = ADC_DSP_BIQUAD;
+            dsp_biquad_init(&st->biquad, args[0] / rate, name[0] == 'h');
+            p->n_stages++;
+        } else {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    p->rate_hz = rate;
+    return ESP_OK;
+}
+
+size_t adc_dsp_run(adc_dsp_pipeline_t *p, float *buf, size_t n, float *out)
+{
+    for (size_t i = 0; i < p->n_stages && n > 0; i++) {
+        adc_dsp_stage_t *st = &p->stages[i];
+        switch (st->kind) {
+        case ADC_DSP_DECIM:
+            n = dsp_decim_f32(&st->decim, buf, buf, n);
+            break;
+        case ADC_DSP_FIR:
+            dsp_fir_f32(&st->fir, buf, buf, n);
+            break;
+        case ADC_DSP_BIQUAD:
+            dsp_biquad_f32(&st->biquad, buf, buf, n);
+            break;
+        }
+    }
+
+    if (p->out == ADC_DSP_OUT_SAMPLES) {
+        memcpy(out, buf, n * sizeof(out[0]));
+        return n;
+    }
+
+    // windows span calls, results are emitted when a window is complete
+    size_t m = 0;
+    for (size_t i = 0; i < n;) {
+        size_t k = p->window - p->acc_n;
+        if (k > n - i) k = n - i;
+        if (p->acc_n == 0) {
+            p->acc_sumsq = 0.0f;
+            p->acc_min = INFINITY;
+            p->acc_max = -INFINITY;
+        }
+        if (p->out == ADC_DSP_OUT_RMS) {
+            p->acc_sumsq += dsp_sumsq_f32(&buf[i], k);
+        } else {
+            dsp_minmax_f32(&buf[i], k, &p->acc_min, &p->acc_max);
+        }
+        p->acc_n += k;
+        i += k;
+
+        if (p->acc_n == p->window) {
+            if (p->out == ADC_DSP_OUT_RMS) {
+                out[m++] = sqrtf(p->acc_sumsq / (float)p->window);
+            } else {
+                out[m++] = p->acc_min;
+                out[m++] = p->acc_max;
+            }
+            p->acc_n = 0;
+        }
+    }
+    return m;
+}
+
+/* ====== Handler: GET /api/adc/dsp ====== */
+
+// stream state, too large for the scratch arena or a task stack: one stream at a time
+typedef struct {
+    httpd_req_t           *req;
+    int                    ch;
+    uint32_t               cursor;
+    int64_t                blocks;
+    int64_t                wait_ms;
+    adc_dsp_pipeline_t     p;
+    adc_stream_block_hdr_t hdr;
+    uint16_t               samples[BLOCK_SAMPLES];
+    float                  buf[BLOCK_SAMPLES];
+    float                  out[2 * BLOCK_SAMPLES];
+    char                   line[LINE_LEN];
+} dsp_stream_t;
+
+static dsp_stream_t s_stream;
+static atomic_bool s_stream_busy;
+static TaskHandle_t s_stream_task;
+
+static const char *out_name(adc_dsp_out_t out)
+{
+    switch (out) {
+    case ADC_DSP_OUT_RMS: return "rms";
+    case ADC_DSP_OUT_PEAK: return "peak";
+    default: return "samples";
+    }
+}
+
+static void send_results(http_hal_stream_t *o, dsp_stream_t *ds, size_t m, size_t *sent)
+{
+    size_t step = ds->p.out == ADC_DSP_OUT_PEAK ? 2 : 1;
+    for (size_t i = 0; i < m; i += step) {
+        const char *sep = (*sent)++ ? "," : "";
+        if (step == 2) {
+            http_hal_stream_printf(o, "%s[%.1f,%.1f]", sep, ds->out[i], ds->out[i + 1]);
+        } else {
+            http_hal_stream_printf(o, "%s%.1f", sep, ds->out[i]);
+        }
+    }
+}
+
+static esp_err_t stream_dsp(dsp_stream_t *ds)
+{
+    http_hal_stream_t out, *o = &out;
+    http_hal_stream_begin(o, ds->req, ds->line, LINE_LEN, "application/json");
+    http_hal_stream_printf(o, "{\"ok\":true,\"ch\":%d,\"kind\":\"%s\",\"rate\":%.3f,\"backend\":\"%s\",\"out\":[",
+                           ds->ch, out_name(ds->p.out), ds->p.rate_hz, dsp_backend());
+
+    uint32_t lost = 0;
+    size_t sent = 0;
+    // bounded by STREAM_MAX_MS so one client cannot keep the stream forever, it resumes from next
+    int64_t idle_since = esp_timer_get_time();
+    int64_t deadline = idle_since + (int64_t)STREAM_MAX_MS * 1000;
+    while (o->err == ESP_OK && ds->blocks > 0 && esp_timer_get_time() < deadline && !http_hal_ending(ds->req)) {
+        if (!adc_stream_read(&ds->cursor, &ds->hdr, ds->samples)) {
+            if (esp_timer_get_time() - idle_since >= ds->wait_ms * 1000) break;
+            vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+            continue;
+        }
+        idle_since = esp_timer_get_time();
+        lost += ds->hdr.lost;
+        ds->blocks--;
+
+        // keep the requested channel only
+        size_t n = 0;
+        for (size_t i = 0; i < ds->hdr.count; i++) {
+            if (ADC_STREAM_CHANNEL(ds->samples[i]) == ds->ch) {
+                ds->buf[n++] = (float)ADC_STREAM_VALUE(ds->samples[i]);
+            }
+        }
+        size_t m = adc_dsp_run(&ds->p, ds->buf, n, ds->out);
+        if (m > 0) send_results(o, ds, m, &sent);
+    }
+
+    http_hal_stream_printf(o, "],\"next\":%u,\"lost\":%u}", (unsigned)ds->cursor, (unsigned)lost);
+    return http_hal_stream_end(o);
+}
+
+static void stream_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_err_t err = stream_dsp(&s_stream);
+        http_hal_detach_end(s_stream.req, err);
+        atomic_store(&s_stream_busy, false);
+    }
+}
+
+static esp_err_t dsp_get_handler(httpd_req_t *req)
+{
+    adc_stream_status_t st;
+    adc_stream_get_status(&st);
+    if (!st.running) {
+        return http_hal_send_err(req, 503, "ADC not running");
+    }
+
+    uint32_t cursor = st.head >= CONFIG_ADC_STREAM_RING_BLOCKS ? st.head - (CONFIG_ADC_STREAM_RING_BLOCKS - 1) : 0;
+    int64_t ch = -1, blocks = STREAM_MAX_BLOCKS, wait_ms = 0, v;
+    const char *spec = "";
+
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *ch_str = http_hal_scratch_query_value(req, query, "ch");
+        char *p_str = http_hal_scratch_query_value(req, query, "p");
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        char *blocks_str = http_hal_scratch_query_value(req, query, "blocks");
+        char *ms_str = http_hal_scratch_query_value(req, query, "ms");
+        if (ch_str && !http_hal_parse_int(ch_str, 0, 31, &ch)) {
+            return http_hal_send_err(req, 400, "Invalid ch");
+        }
+        if (p_str) spec = p_str;
+        if (since_str) {
+            if (!http_hal_parse_int(since_str, 0, UINT32_MAX, &v)) {
+                return http_hal_send_err(req, 400, "Invalid since");
+            }
+            cursor = (uint32_t)v;
+        }
+        if (blocks_str && !http_hal_parse_int(blocks_str, 1, STREAM_MAX_BLOCKS, &blocks)) {
+            return http_hal_send_err(req, 400, "Invalid blocks");
+        }
+        if (ms_str && !http_hal_parse_int(ms_str, 0, STREAM_MAX_MS, &wait_ms)) {
+            return http_hal_send_err(req, 400, "Invalid ms");
+        }
+    }
+    if (ch < 0 || !(st.channel_mask & (1u << ch))) {
+        return http_hal_send_err(req, 400, "ch must be a sampled channel");
+    }
+
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_stream_busy, &idle, true)) {
+        return http_hal_send_err(req, 503, "DSP stream busy");
+    }
+    dsp_stream_t *ds = &s_stream;
+    if (adc_dsp_parse(&ds->p, spec, (float)st.sample_hz / (float)st.channels) != ESP_OK) {
+        atomic_store(&s_stream_busy, false);
+        return http_hal_send_err(req, 400, "Invalid pipeline");
+    }
+    ds->ch = (int)ch;
+    ds->cursor = cursor;
+    ds->blocks = blocks;
+    ds->wait_ms = wait_ms;
+
+    // the worker streams while the server task goes on serving other clients
+    httpd_req_t *copy;
+    if (s_stream_task && http_hal_detach(req, &copy) == ESP_OK) {
+        ds->req = copy;
+        xTaskNotifyGive(s_stream_task);
+        return ESP_OK;
+    }
+    // draining or stopping: the stream ends at once, answer it here
+    ds->req = req;
+    esp_err_t err = stream_dsp(ds);
+    atomic_store(&s_stream_busy, false);
+    return err;
+}
+
+esp_err_t adc_dsp_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/adc/dsp",
+        .method = HTTP_GET,
+        .handler = dsp_get_handler,
+        .user_ctx = NULL
+    };
+    if (!s_stream_task) {
+        ESP_RETURN_ON_FALSE(xTaskCreate(stream_task, "adc_dsp", STREAM_TASK_STACK, NULL, STREAM_TASK_PRIO,
+                                        &s_stream_task) == pdPASS, ESP_ERR_NO_MEM, TAG, "task create failed");
+    }
+    return http_hal_register_endpoint(h, &ep);
+}
+
+/* ====== Kernel benchmark ====== */
+
+#if CONFIG_ADC_DSP_BENCH
+#define BENCH_SAMPLES   CONFIG_ADC_DSP_BENCH_SAMPLES
+#define BENCH_REPS      CONFIG_ADC_DSP_BENCH_REPS
+
+static float bench_ns(int64_t t0, size_t n, size_t reps)
+{
+    return (float)(esp_timer_get_time() - t0) * 1000.0f / (float)(n * reps);
+}
+
+void adc_dsp_bench(void)
+{
+    static float x[BENCH_SAMPLES], y[BENCH_SAMPLES];
+    static dsp_fir_t fir;
+    static dsp_biquad_t biquad;
+    static dsp_decim_t decim;
+    const size_t n = BENCH_SAMPLES, reps = BENCH_REPS;
+
+    for (size_t i = 0; i < n; i++) {
+        x[i] = 2048.0f + 1000.0f * sinf(0.05f * (float)i) + (float)(i * 7919 % 61);
+    }
+    dsp_fir_init_lowpass(&fir, BENCH_FIR_TAPS, 0.1f);
+    dsp_biquad_init(&biquad, 0.1f, 0);
+    dsp_decim_init(&decim, 4);
+
+    // kernels write y, never x, so every repetition sees the same input;
+    // the task yields between kernels, outside the timed loops
+    int64_t t0 = esp_timer_get_time();
+    for (size_t r = 0; r < reps; r++) dsp_decim_f32(&decim, x, y, n);
+    float decim_ns = bench_ns(t0, n, reps);
+    vTaskDelay(1);
+
+    t0 = esp_timer_get_time();
+    for (size_t r = 0; r < reps; r++) dsp_fir_f32(&fir, x, y, n);
+    float fir_ns = bench_ns(t0, n, reps);
+    vTaskDelay(1);
+
+    t0 = esp_timer_get_time();
+    for (size_t r = 0; r < reps; r++) dsp_biquad_f32(&biquad, x, y, n);
+    float biquad_ns = bench_ns(t0, n, reps);
+    vTaskDelay(1);
+
+    volatile float check = 0.0f;
+    t0 = esp_timer_get_time();
+    for (size_t r = 0; r < reps; r++) check += dsp_sumsq_f32(x, n);
+    float sumsq_ns = bench_ns(t0, n, reps);
+    vTaskDelay(1);
+
+    float lo = INFINITY, hi = -INFINITY;
+    t0 = esp_timer_get_time();
+    for (size_t r = 0; r < reps; r++) dsp_minmax_f32(x, n, &lo, &hi);
+    float minmax_ns = bench_ns(t0, n, reps);
+
+    ESP_LOGI(TAG, "Bench (%s, n=%u, reps=%u) ns/sample: decim4 %.1f, fir%d %.1f, biquad %.1f, sumsq %.1f, minmax %.1f",
+             dsp_backend(), (unsigned)n, (unsigned)reps,
+             decim_ns, BENCH_FIR_TAPS, fir_ns, biquad_ns, sumsq_ns, minmax_ns);
+}
+#endif
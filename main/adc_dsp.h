@@ -0,0 +1,129 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file adc_dsp.h
+ * @brief Per-stream processing pipelines on the continuous ADC data
+ * A pipeline is described by a short text, e.g. "decim:4,lp:200,rms:50":
+ * - decim:<n>           mean of every n samples (box-car decimation)
+ * - fir:<taps>:<hz>     windowed-sinc low-pass FIR
+ * - lp:<hz>, hp:<hz>    2nd order Butterworth low/high-pass
+ * - rms:<n>, peak:<n>   optional last stage: one RMS value, or one
+ *                       [min,max] pair, per n samples
+ * Stages run in the given order. An /api/adc/dsp request builds its
+ * pipeline over one channel of the adc_stream ring, so the client receives
+ * the reduced signal rather than raw samples.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "dsp.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_DSP_MAX_STAGES 4
+
+typedef enum {
+    ADC_DSP_DECIM,
+    ADC_DSP_FIR,
+    ADC_DSP_BIQUAD,
+} adc_dsp_stage_kind_t;
+
+typedef enum {
+    ADC_DSP_OUT_SAMPLES,
+    ADC_DSP_OUT_RMS,
+    ADC_DSP_OUT_PEAK,
+} adc_dsp_out_t;
+
+typedef struct {
+    adc_dsp_stage_kind_t kind;
+    union {
+        dsp_decim_t  decim;
+        dsp_fir_t    fir;
+        dsp_biquad_t biquad;
+    };
+} adc_dsp_stage_t;
+
+/**
+ * @brief Pipeline and its state
+ */
+typedef struct {
+    size_t          n_stages;
+    adc_dsp_stage_t stages[ADC_DSP_MAX_STAGES];
+    adc_dsp_out_t   out;
+    uint32_t        window;     // samples per RMS/peak result
+    float           rate_hz;    // output rate
+    // current RMS/peak window
+    uint32_t        acc_n;
+    float           acc_sumsq;
+    float           acc_min;
+    float           acc_max;
+} adc_dsp_pipeline_t;
+
+/**
+ * @brief Build a pipeline from its text description
+ *
+ * @param[out] p       Pipeline
+ * @param[in]  spec    Description (see above), "" passes samples through
+ * @param[in]  rate_hz Input sample rate
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a malformed spec or a
+ *         cutoff at or above the Nyquist frequency of its stage
+ */
+esp_err_t adc_dsp_parse(adc_dsp_pipeline_t *p, const char *spec, float rate_hz);
+
+/**
+ * @brief Run samples through the pipeline
+ *
+ * @param[in,out] p   Pipeline
+ * @param[in,out] buf Input samples, overwritten by the stages
+ * @param[in]     n   Number of samples
+ * @param[out]    out Results, at least 2 * n entries (peak results are pairs)
+ * @return Number of entries written to out
+ */
+size_t adc_dsp_run(adc_dsp_pipeline_t *p, float *buf, size_t n, float *out);
+
+/**
+ * @brief Measure the kernels and log ns per sample (CONFIG_ADC_DSP_BENCH)
+ *
+ * Runs for a while on the calling task, meant for startup. Yields between
+ * kernels so the idle task keeps feeding the task watchdog.
+ */
+void adc_dsp_bench(void);
+
+/**
+ * @brief Register GET /api/adc/dsp
+ *
+ * GET /api/adc/dsp?ch=<c>&p=<spec>&blocks=<n>&ms=<t> streams the output of a
+ * pipeline on ADC1 channel c; blocks and ms bound the stream as in
+ * /api/adc/stream. The stream is sent by a worker task (see http_hal_detach());
+ * one runs at a time, others get 503.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t adc_dsp_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
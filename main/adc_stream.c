@@ -0,0 +1,427 @@
+#include "adc_stream.h"
+
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "stream_codec.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_adc/adc_continuous.h"
+#include "soc/soc_caps.h"
+#endif
+
+static const char *TAG = "ADC_STREAM";
+
+#define BLOCK_SAMPLES       CONFIG_ADC_STREAM_BLOCK_SAMPLES
+#define RING_BLOCKS         CONFIG_ADC_STREAM_RING_BLOCKS
+#define RING_MASK           (RING_BLOCKS - 1)
+#define STREAM_MAX_BLOCKS   100000
+#define STREAM_MAX_MS       CONFIG_ADC_STREAM_MAX_MS    // whole stream, also bounds ms
+#define POLL_MS             5
+#define CODEC_BUF           192
+#define STREAM_TASK_STACK   3072
+#define STREAM_TASK_PRIO    5
+
+_Static_assert((RING_BLOCKS & RING_MASK) == 0, "ADC_STREAM_RING_BLOCKS must be a power of two");
+_Static_assert(sizeof(adc_stream_block_hdr_t) == 12, "block header is sent as is");
+
+typedef struct {
+    uint32_t t_us;
+    uint16_t count;
+} block_meta_t;
+
+// single producer (the packing task), any number of cursor readers
+static uint16_t s_ring[RING_BLOCKS][BLOCK_SAMPLES];
+static block_meta_t s_meta[RING_BLOCKS];
+static atomic_uint s_head;
+
+static bool s_running;
+static uint32_t s_sample_hz;
+static size_t s_channels;
+static uint32_t s_channel_mask;
+static volatile uint32_t s_pool_ovf;
+
+#if !CONFIG_IDF_TARGET_LINUX
+
+/* ====== Sampling (chip) ====== */
+
+#define FRAME_BYTES         (BLOCK_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES)
+#define POOL_FRAMES         4
+#define DATA_SHIFT          (SOC_ADC_DIGI_MAX_BITWIDTH - 12)
+#define TASK_STACK          3072
+#define TASK_PRIO           6
+
+// ESP32 and ESP32-S2 report 2-byte results, the newer targets 4-byte ones
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define OUTPUT_FORMAT       ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define RESULT_CHANNEL(p)   ((p)->type1.channel)
+#define RESULT_DATA(p)      ((p)->type1.data)
+#else
+#define OUTPUT_FORMAT       ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define RESULT_CHANNEL(p)   ((p)->type2.channel)
+#define RESULT_DATA(p)      ((p)->type2.data)
+#endif
+
+static uint8_t s_frame[FRAME_BYTES];
+static adc_continuous_handle_t s_adc;
+
+static bool IRAM_ATTR pool_ovf_cb(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    (void)handle;
+    (void)edata;
+    (void)user_data;
+
+    s_pool_ovf++;
+    return false;
+}
+
+static void pack_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        uint32_t len = 0;
+        if (adc_continuous_read(s_adc, s_frame, FRAME_BYTES, &len, ADC_MAX_DELAY) != ESP_OK) continue;
+
+        uint32_t h = atomic_load_explicit(&s_head, memory_order_relaxed);
+        uint16_t *block = s_ring[h & RING_MASK];
+        uint16_t n = 0;
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *r = (const adc_digi_output_data_t *)&s_frame[i];
+            uint32_t ch = RESULT_CHANNEL(r);
+            if (ch >= SOC_ADC_MAX_CHANNEL_NUM) continue;
+            block[n++] = ADC_STREAM_SAMPLE(ch, RESULT_DATA(r) >> DATA_SHIFT);
+        }
+        if (n == 0) continue;
+
+        s_meta[h & RING_MASK] = (block_meta_t){
+            .t_us = (uint32_t)esp_timer_get_time(),
+            .count = n
+        };
+        // publishes the block: readers never look past head
+        atomic_store_explicit(&s_head, h + 1, memory_order_release);
+    }
+}
+
+esp_err_t adc_stream_init(const int *channels, size_t n, uint32_t sample_hz)
+{
+    ESP_RETURN_ON_FALSE(channels && n > 0 && n <= ADC_STREAM_MAX_CHANNELS, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    ESP_RETURN_ON_FALSE(sample_hz >= SOC_ADC_SAMPLE_FREQ_THRES_LOW && sample_hz <= SOC_ADC_SAMPLE_FREQ_THRES_HIGH,
+                        ESP_ERR_INVALID_ARG, TAG, "sample rate out of range");
+    ESP_RETURN_ON_FALSE(!s_adc, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    adc_digi_pattern_config_t pattern[ADC_STREAM_MAX_CHANNELS];
+    for (size_t i = 0; i < n; i++) {
+        ESP_RETURN_ON_FALSE(channels[i] >= 0 && channels[i] < SOC_ADC_MAX_CHANNEL_NUM, ESP_ERR_INVALID_ARG,
+                            TAG, "bad channel %d", channels[i]);
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = ADC_ATTEN_DB_12,
+            .channel = (uint8_t)channels[i],
+            .unit = ADC_UNIT_1,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH
+        };
+        s_channel_mask |= 1u << channels[i];
+    }
+
+    const adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = FRAME_BYTES * POOL_FRAMES,
+        .conv_frame_size = FRAME_BYTES,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_new_handle(&handle_cfg, &s_adc), TAG, "adc_continuous_new_handle failed");
+
+    const adc_continuous_config_t cfg = {
+        .pattern_num = n,
+        .adc_pattern = pattern,
+        .sample_freq_hz = sample_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = OUTPUT_FORMAT,
+    };
+    const adc_continuous_evt_cbs_t cbs = {
+        .on_pool_ovf = pool_ovf_cb
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_config(s_adc, &cfg), TAG, "adc_continuous_config failed");
+    ESP_RETURN_ON_ERROR(adc_continuous_register_event_callbacks(s_adc, &cbs, NULL), TAG, "register callbacks failed");
+
+    ESP_RETURN_ON_FALSE(xTaskCreate(pack_task, "adc_pack", TASK_STACK, NULL, TASK_PRIO, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    ESP_RETURN_ON_ERROR(adc_continuous_start(s_adc), TAG, "adc_continuous_start failed");
+
+    s_sample_hz = sample_hz;
+    s_channels = n;
+    s_running = true;
+    LOG_ADC("Sampling %u channels at %u Hz, %d-sample blocks", (unsigned)n, (unsigned)sample_hz, BLOCK_SAMPLES);
+    return ESP_OK;
+}
+
+#else
+
+/* ====== Sampling (linux) ====== */
+
+esp_err_t adc_stream_init(const int *channels, size_t n, uint32_t sample_hz)
+{
+    // no ADC on the host: the ring stays empty and the endpoints report it
+    ESP_LOGE(TAG, "Continuous ADC is not available on the linux target");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+/* ====== API ====== */
+
+uint32_t adc_stream_head(void)
+{
+    return atomic_load_explicit(&s_head, memory_order_acquire);
+}
+
+bool adc_stream_read(uint32_t *cursor, adc_stream_block_hdr_t *hdr, uint16_t *samples)
+{
+    uint32_t seq = *cursor;
+    uint32_t skipped = 0;
+
+    for (;;) {
+        uint32_t h = atomic_load_explicit(&s_head, memory_order_acquire);
+        if (h == seq) return false;
+
+        // the slot of head is being written, so at most RING_BLOCKS - 1 are readable
+        if (h - seq >= RING_BLOCKS) {
+            skipped += h - (RING_BLOCKS - 1) - seq;
+            seq = h - (RING_BLOCKS - 1);
+        }
+
+        block_meta_t meta = s_meta[seq & RING_MASK];
+        memcpy(samples, s_ring[seq & RING_MASK], meta.count * sizeof(samples[0]));
+
+        // the producer may have lapped the reader while copying: retry past it
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t h2 = atomic_load_explicit(&s_head, memory_order_relaxed);
+        if (h2 - seq < RING_BLOCKS) {
+            hdr->seq = seq;
+            hdr->t_us = meta.t_us;
+            hdr->count = meta.count;
+            hdr->lost = skipped > UINT16_MAX ? UINT16_MAX : (uint16_t)skipped;
+            *cursor = seq + 1;
+            return true;
+        }
+    }
+}
+
+void adc_stream_get_status(adc_stream_status_t *out)
+{
+    if (!out) return;
+
+    out->running = s_running;
+    out->sample_hz = s_sample_hz;
+    out->channels = s_channels;
+    out->channel_mask = s_channel_mask;
+    out->head = adc_stream_head();
+    out->pool_ovf = s_pool_ovf;
+}
+
+/* ====== Handlers: /api/adc ====== */
+
+// one frame per block, one channel section per channel present in the block
+static void encode_block(stream_codec_enc_t *enc, const adc_stream_block_hdr_t *hdr, const uint16_t *samples)
+{
+    uint16_t counts[16] = { 0 };
+    uint32_t mask = 0;
+    for (size_t i = 0; i < hdr->count; i++) {
+        counts[ADC_STREAM_CHANNEL(samples[i])]++;
+    }
+    for (int ch = 0; ch < 16; ch++) {
+        if (counts[ch]) mask |= 1u << ch;
+    }
+
+    stream_codec_frame(enc, hdr->seq, hdr->t_us, mask, hdr->lost);
+    for (int ch = 0; ch < 16; ch++) {
+        if (!counts[ch]) continue;
+        stream_codec_channel(enc, counts[ch]);
+        for (size_t i = 0; i < hdr->count; i++) {
+            if (ADC_STREAM_CHANNEL(samples[i]) == ch) {
+                stream_codec_value(enc, ADC_STREAM_VALUE(samples[i]));
+            }
+        }
+    }
+}
+
+static esp_err_t adc_get_handler(httpd_req_t *req)
+{
+    adc_stream_status_t st;
+    adc_stream_get_status(&st);
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"running\":%s,\"sample_hz\":%u,\"channels\":%u,"
+             "\"block_samples\":%d,\"ring_blocks\":%d,\"head\":%u,\"pool_ovf\":%u}",
+             st.running ? "true" : "false", (unsigned)st.sample_hz, (unsigned)st.channels,
+             BLOCK_SAMPLES, RING_BLOCKS, (unsigned)st.head, (unsigned)st.pool_ovf);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+// one stream at a time, its state lives here rather than on the server stack
+typedef struct {
+    httpd_req_t *req;
+    uint32_t     cursor;
+    int64_t      blocks;
+    int64_t      wait_ms;
+    bool         frames;
+    // hdr and samples are contiguous so each block is one chunk
+    struct {
+        adc_stream_block_hdr_t hdr;
+        uint16_t samples[BLOCK_SAMPLES];
+    } blk;
+    uint8_t            codec_buf[CODEC_BUF];
+    stream_codec_enc_t enc;
+} stream_job_t;
+
+static stream_job_t s_job;
+static atomic_bool s_job_busy;
+static TaskHandle_t s_stream_task;
+
+static esp_err_t stream_run(stream_job_t *j)
+{
+    httpd_req_t *req = j->req;
+    struct {
+        char     magic[4];
+        uint16_t version;
+        uint16_t block_samples;
+        uint32_t sample_hz;
+        uint32_t first;
+    } sh = { { 'A', 'D', 'C', 'S' }, ADC_STREAM_VERSION, BLOCK_SAMPLES, s_sample_hz, j->cursor };
+
+    stream_codec_init(&j->enc, j->codec_buf, sizeof(j->codec_buf), stream_codec_http_flush, req);
+
+    esp_err_t err = ESP_OK;
+    if (j->frames) {
+        httpd_resp_set_type(req, STREAM_CODEC_MIME);
+    } else {
+        httpd_resp_set_type(req, "application/octet-stream");
+        err = httpd_resp_send_chunk(req, (const char *)&sh, sizeof(sh));
+    }
+
+    // bounded by STREAM_MAX_MS so one client cannot keep the stream forever, it resumes from next
+    int64_t idle_since = esp_timer_get_time();
+    int64_t deadline = idle_since + (int64_t)STREAM_MAX_MS * 1000;
+    while (err == ESP_OK && j->blocks > 0 && esp_timer_get_time() < deadline && !http_hal_ending(req)) {
+        if (!adc_stream_read(&j->cursor, &j->blk.hdr, j->blk.samples)) {
+            if (esp_timer_get_time() - idle_since >= j->wait_ms * 1000) break;
+            vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+            continue;
+        }
+        if (j->frames) {
+            encode_block(&j->enc, &j->blk.hdr, j->blk.samples);
+            err = stream_codec_flush(&j->enc);
+        } else {
+            err = httpd_resp_send_chunk(req, (const char *)&j->blk,
+                                        sizeof(j->blk.hdr) + j->blk.hdr.count * sizeof(j->blk.samples[0]));
+        }
+        idle_since = esp_timer_get_time();
+        j->blocks--;
+    }
+    if (err != ESP_OK) return err;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static void stream_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_err_t err = stream_run(&s_job);
+        http_hal_detach_end(s_job.req, err);
+        atomic_store(&s_job_busy, false);
+    }
+}
+
+static esp_err_t stream_get_handler(httpd_req_t *req)
+{
+    uint32_t head = adc_stream_head();
+    uint32_t cursor = head >= RING_BLOCKS ? head - (RING_BLOCKS - 1) : 0;
+    int64_t blocks = STREAM_MAX_BLOCKS, wait_ms = 0;
+    bool frames = false;
+
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        char *blocks_str = http_hal_scratch_query_value(req, query, "blocks");
+        char *ms_str = http_hal_scratch_query_value(req, query, "ms");
+        char *fmt_str = http_hal_scratch_query_value(req, query, "fmt");
+        int64_t v;
+        if (since_str) {
+            if (!http_hal_parse_int(since_str, 0, UINT32_MAX, &v)) {
+                return http_hal_send_err(req, 400, "Invalid since");
+            }
+            cursor = (uint32_t)v;
+        }
+        if (blocks_str && !http_hal_parse_int(blocks_str, 1, STREAM_MAX_BLOCKS, &blocks)) {
+            return http_hal_send_err(req, 400, "Invalid blocks");
+        }
+        if (ms_str && !http_hal_parse_int(ms_str, 0, STREAM_MAX_MS, &wait_ms)) {
+            return http_hal_send_err(req, 400, "Invalid ms");
+        }
+        if (fmt_str) {
+            if (strcmp(fmt_str, "frames") == 0) {
+                frames = true;
+            } else if (strcmp(fmt_str, "raw") != 0) {
+                return http_hal_send_err(req, 400, "Invalid fmt");
+            }
+        }
+    }
+    if (!s_running) {
+        return http_hal_send_err(req, 503, "ADC not running");
+    }
+
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_job_busy, &idle, true)) {
+        return http_hal_send_err(req, 503, "ADC stream busy");
+    }
+    stream_job_t *j = &s_job;
+    j->cursor = cursor;
+    j->blocks = blocks;
+    j->wait_ms = wait_ms;
+    j->frames = frames;
+
+    // the worker streams while the server task goes on serving other clients
+    httpd_req_t *copy;
+    if (s_stream_task && http_hal_detach(req, &copy) == ESP_OK) {
+        j->req = copy;
+        xTaskNotifyGive(s_stream_task);
+        return ESP_OK;
+    }
+    // draining or stopping: the stream ends at once, answer it here
+    j->req = req;
+    esp_err_t err = stream_run(j);
+    atomic_store(&s_job_busy, false);
+    return err;
+}
+
+esp_err_t adc_stream_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/adc",
+        .method = HTTP_GET,
+        .handler = adc_get_handler,
+        .user_ctx = NULL
+    };
+    ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &ep), TAG, "register adc failed");
+
+    if (!s_stream_task) {
+        ESP_RETURN_ON_FALSE(xTaskCreate(stream_task, "adc_stream", STREAM_TASK_STACK, NULL, STREAM_TASK_PRIO,
+                                        &s_stream_task) == pdPASS, ESP_ERR_NO_MEM, TAG, "task create failed");
+    }
+
+    http_hal_endpoint_t stream_ep = {
+        .uri = "/api/adc/stream",
+        .method = HTTP_GET,
+        .handler = stream_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &stream_ep);
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file adc_stream.h
+ * @brief Continuous ADC sampling into a ring of sample blocks
+ * ADC1 channels are converted in continuous mode: the ADC digital controller
+ * and DMA fill conversion frames without CPU work per sample. A task packs
+ * each frame into a block of 16-bit samples (channel in bits 15..12, value in
+ * bits 11..0) and publishes it in a ring written only by that task. Readers
+ * keep a block cursor, as with gpio_capture, and blocks overwritten before
+ * they are read are reported as lost.
+ *
+ * Binary stream format (little endian), as sent by /api/adc/stream:
+ * - stream header: "ADCS", u16 version (1), u16 samples per block,
+ *   u32 sample rate (Hz), u32 first block sequence number
+ * - blocks: u32 sequence number, u32 timestamp of the last sample (us, low
+ *   32 bits of esp_timer), u16 sample count, u16 lost blocks before this one,
+ *   then the samples
+ * With fmt=frames the stream instead uses the compact frames of
+ * stream_codec.h: one frame per block, one section per ADC channel holding
+ * the 12-bit values of that channel.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_STREAM_MAX_CHANNELS 8
+#define ADC_STREAM_VERSION      1
+
+#define ADC_STREAM_SAMPLE(ch, v) ((uint16_t)(((ch) << 12) | ((v) & 0x0FFF)))
+#define ADC_STREAM_CHANNEL(s)    ((s) >> 12)
+#define ADC_STREAM_VALUE(s)      ((s) & 0x0FFF)
+
+/**
+ * @brief Block header, followed by count samples (no padding, sent as is)
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t t_us;
+    uint16_t count;
+    uint16_t lost;
+} adc_stream_block_hdr_t;
+
+/**
+ * @brief Sampler status
+ */
+typedef struct {
+    bool     running;
+    uint32_t sample_hz;     // conversions per second, all channels together
+    size_t   channels;
+    uint32_t channel_mask;  // bit i = ADC1 channel i is sampled
+    uint32_t head;          // sequence number of the next block
+    uint32_t pool_ovf;      // driver pool overflows (packing task too slow)
+} adc_stream_status_t;
+
+/**
+ * @brief Configure continuous conversion of ADC1 channels and start sampling
+ *
+ * @param[in] channels  ADC1 channel numbers, converted in this order
+ * @param[in] n         Number of channels (at most ADC_STREAM_MAX_CHANNELS)
+ * @param[in] sample_hz Total conversion rate
+ * @return ESP_OK on success
+ */
+esp_err_t adc_stream_init(const int *channels, size_t n, uint32_t sample_hz);
+
+/**
+ * @brief Sequence number the next block will get
+ */
+uint32_t adc_stream_head(void);
+
+/**
+ * @brief Copy the block at *cursor and advance the cursor
+ *
+ * @param[in,out] cursor  Sequence number of the next block to read
+ * @param[out]    hdr     Block header (lost = blocks skipped before it)
+ * @param[out]    samples Sample buffer, CONFIG_ADC_STREAM_BLOCK_SAMPLES long
+ * @return true if a block was read, false if the reader is up to date
+ */
+bool adc_stream_read(uint32_t *cursor, adc_stream_block_hdr_t *hdr, uint16_t *samples);
+
+/**
+ * @brief Get the sampler status
+ *
+ * @param[out] out Returned status
+ */
+void adc_stream_get_status(adc_stream_status_t *out);
+
+/**
+ * @brief Register the ADC endpoints
+ *
+ * - GET /api/adc reports the sampler status
+ * - GET /api/adc/stream?since=<seq>&blocks=<n>&ms=<t> streams blocks in the
+ *   binary format above (application/octet-stream, chunked). It starts at
+ *   since (default: the oldest block kept) and ends after n blocks, when no
+ *   new block arrived for ms (default 0, i.e. only what is already buffered)
+ *   or after CONFIG_ADC_STREAM_MAX_MS.
+ *   fmt=frames selects the delta-encoded frames (application/x-sample-frames).
+ *   The stream is sent by a worker task (see http_hal_detach()); one runs at
+ *   a time, others get 503.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t adc_stream_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
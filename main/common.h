@@ -41,6 +41,8 @@
 #define DEBUG_ADC 0
 #define DEBUG_GPIO 0
 #define DEBUG_DAC 0
+#define DEBUG_PWM 0
+#define DEBUG_RMT 0
 
 #if DEBUG
 #define LOG(x,...) if(DEBUG){ ESP_LOGI("APP", x, ##__VA_ARGS__);}
@@ -48,6 +50,8 @@
 #define LOG_GPIO(x,...) if(DEBUG_GPIO){ ESP_LOGI("GPIO_HAL", x, ##__VA_ARGS__);}
 #define LOG_BT(x,...) if(DEBUG_BT){ ESP_LOGI("BT_HAL", x, ##__VA_ARGS__);}
 #define LOG_DAC(x,...) if(DEBUG_DAC){ ESP_LOGI("DAC_HAL", x, ##__VA_ARGS__);}
+#define LOG_PWM(x,...) if(DEBUG_PWM){ ESP_LOGI("PWM_HAL", x, ##__VA_ARGS__);}
+#define LOG_RMT(x,...) if(DEBUG_RMT){ ESP_LOGI("RMT_PATTERN", x, ##__VA_ARGS__);}
 
 #endif
 
@@ -0,0 +1,339 @@
+#include "dac_wave.h"
+
+#include <string.h>
+#include <math.h>
+#include "soc/soc_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+
+#if SOC_DAC_SUPPORTED
+#include "driver/dac_cosine.h"
+#include "driver/dac_continuous.h"
+#endif
+
+static const char *TAG = "DAC_WAVE";
+
+#define SAMPLE_HZ           CONFIG_DAC_WAVE_SAMPLE_HZ
+#define MAX_SAMPLES         CONFIG_DAC_WAVE_MAX_SAMPLES
+#define MIN_SAMPLES         4
+#define DMA_BUF_SIZE        2048
+// the ESP32 widens samples to 16 bits in its DMA buffers, keep room for both
+#define DMA_DESC_NUM        (2 * ((MAX_SAMPLES + DMA_BUF_SIZE - 1) / DMA_BUF_SIZE))
+#define COSINE_MIN_HZ       130
+#define COSINE_MAX_HZ       200000
+#define RATE_MIN_HZ         20000
+#define RATE_MAX_HZ         1000000
+#define RECV_CHUNK          256
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// generated or uploaded table, copied into the DMA buffers when played
+static uint8_t s_table[MAX_SAMPLES];
+static int s_channel = -1;
+static dac_wave_status_t s_status;
+
+#if SOC_DAC_SUPPORTED
+static dac_cosine_handle_t s_cos;
+static dac_continuous_handle_t s_cont;
+#endif
+
+/* ====== Backends ====== */
+
+static esp_err_t backend_stop(void)
+{
+#if SOC_DAC_SUPPORTED
+    if (s_cos) {
+        dac_cosine_stop(s_cos);
+        ESP_RETURN_ON_ERROR(dac_cosine_del_channel(s_cos), TAG, "dac_cosine_del_channel failed");
+        s_cos = NULL;
+    }
+    if (s_cont) {
+        dac_continuous_disable(s_cont);
+        ESP_RETURN_ON_ERROR(dac_continuous_del_channels(s_cont), TAG, "dac_continuous_del_channels failed");
+        s_cont = NULL;
+    }
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t backend_cosine(uint32_t freq_hz, int atten, int offset)
+{
+#if SOC_DAC_SUPPORTED
+    static const dac_cosine_atten_t attens[] = {
+        DAC_COSINE_ATTEN_DB_0, DAC_COSINE_ATTEN_DB_6, DAC_COSINE_ATTEN_DB_12, DAC_COSINE_ATTEN_DB_18
+    };
+    dac_cosine_config_t cfg = {
+        .chan_id = (dac_channel_t)s_channel,
+        .freq_hz = freq_hz,
+        .clk_src = DAC_COSINE_CLK_SRC_DEFAULT,
+        .atten = attens[atten],
+        .phase = DAC_COSINE_PHASE_0,
+        .offset = (int8_t)offset,
+        // the frequency is shared by both channels, the last request wins
+        .flags.force_set_freq = true,
+    };
+    ESP_RETURN_ON_ERROR(dac_cosine_new_channel(&cfg, &s_cos), TAG, "dac_cosine_new_channel failed");
+    esp_err_t err = dac_cosine_start(s_cos);
+    if (err != ESP_OK) {
+        dac_cosine_del_channel(s_cos);
+        s_cos = NULL;
+    }
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static esp_err_t backend_table(const uint8_t *samples, size_t n, uint32_t sample_hz)
+{
+#if SOC_DAC_SUPPORTED
+    dac_continuous_config_t cfg = {
+        .chan_mask = s_channel ? DAC_CHANNEL_MASK_CH1 : DAC_CHANNEL_MASK_CH0,
+        .desc_num = DMA_DESC_NUM,
+        .buf_size = DMA_BUF_SIZE,
+        .freq_hz = sample_hz,
+        .offset = 0,
+        .clk_src = DAC_DIGI_CLK_SRC_DEFAULT,
+        .chan_mode = DAC_CHANNEL_MODE_SIMUL,
+    };
+    ESP_RETURN_ON_ERROR(dac_continuous_new_channels(&cfg, &s_cont), TAG, "dac_continuous_new_channels failed");
+
+    // after this call the DMA loops over its descriptors without interrupts
+    size_t loaded = 0;
+    esp_err_t err = dac_continuous_enable(s_cont);
+    if (err == ESP_OK) err = dac_continuous_write_cyclically(s_cont, (uint8_t *)samples, n, &loaded);
+    if (err == ESP_OK && loaded < n) err = ESP_ERR_INVALID_SIZE;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "cyclic playback failed: %s (%u/%u loaded)", esp_err_to_name(err),
+                 (unsigned)loaded, (unsigned)n);
+        backend_stop();
+    }
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/* ====== API ====== */
+
+esp_err_t dac_wave_init(int channel)
+{
+#if SOC_DAC_SUPPORTED
+    ESP_RETURN_ON_FALSE(channel == 0 || channel == 1, ESP_ERR_INVALID_ARG, TAG, "bad channel");
+    s_channel = channel;
+    return ESP_OK;
+#else
+    (void)channel;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t dac_wave_cosine(uint32_t freq_hz, int atten, int offset)
+{
+    ESP_RETURN_ON_FALSE(s_channel >= 0, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(freq_hz >= COSINE_MIN_HZ && freq_hz <= COSINE_MAX_HZ && atten >= 0 && atten <= 3 &&
+                        offset >= -128 && offset <= 127, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    ESP_RETURN_ON_ERROR(dac_wave_stop(), TAG, "stop failed");
+    ESP_RETURN_ON_ERROR(backend_cosine(freq_hz, atten, offset), TAG, "cosine start failed");
+
+    s_status = (dac_wave_status_t){
+        .shape = DAC_WAVE_COSINE,
+        .freq_hz = freq_hz,
+    };
+    LOG_DAC("Cosine %u Hz on DAC channel %d", (unsigned)freq_hz, s_channel);
+    return ESP_OK;
+}
+
+esp_err_t dac_wave_generate(dac_wave_shape_t shape, uint32_t freq_hz, int amplitude, int center)
+{
+    ESP_RETURN_ON_FALSE(shape >= DAC_WAVE_SINE && shape <= DAC_WAVE_SQUARE && amplitude >= 0 && amplitude <= 127 &&
+                        center >= 0 && center <= 255 && freq_hz > 0, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    // one period per table: the table length sets the frequency resolution
+    size_t n = (SAMPLE_HZ + freq_hz / 2) / freq_hz;
+    if (n < MIN_SAMPLES || n > MAX_SAMPLES) return ESP_ERR_INVALID_ARG;
+
+    for (size_t i = 0; i < n; i++) {
+        float ph = (float)i / (float)n;
+        float v;
+        switch (shape) {
+        case DAC_WAVE_SINE:     v = sinf(2.0f * (float)M_PI * ph); break;
+        case DAC_WAVE_TRIANGLE: v = ph < 0.5f ? 4.0f * ph - 1.0f : 3.0f - 4.0f * ph; break;
+        case DAC_WAVE_SAW:      v = 2.0f * ph - 1.0f; break;
+        default:                v = ph < 0.5f ? 1.0f : -1.0f; break;
+        }
+        int code = center + (int)lroundf(v * (float)amplitude);
+        s_table[i] = (uint8_t)(code < 0 ? 0 : code > 255 ? 255 : code);
+    }
+
+    ESP_RETURN_ON_ERROR(dac_wave_play_table(s_table, n, SAMPLE_HZ), TAG, "play failed");
+    s_status.shape = shape;
+    return ESP_OK;
+}
+
+esp_err_t dac_wave_play_table(const uint8_t *samples, size_t n, uint32_t sample_hz)
+{
+    ESP_RETURN_ON_FALSE(s_channel >= 0, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(samples && n >= MIN_SAMPLES && n <= MAX_SAMPLES &&
+                        sample_hz >= RATE_MIN_HZ && sample_hz <= RATE_MAX_HZ, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    ESP_RETURN_ON_ERROR(dac_wave_stop(), TAG, "stop failed");
+    ESP_RETURN_ON_ERROR(backend_table(samples, n, sample_hz), TAG, "table start failed");
+
+    s_status = (dac_wave_status_t){
+        .shape = DAC_WAVE_TABLE,
+        .freq_hz = (sample_hz + n / 2) / n,
+        .sample_hz = sample_hz,
+        .samples = n,
+    };
+    LOG_DAC("Table of %u samples at %u Hz on DAC channel %d", (unsigned)n, (unsigned)sample_hz, s_channel);
+    return ESP_OK;
+}
+
+esp_err_t dac_wave_stop(void)
+{
+    ESP_RETURN_ON_ERROR(backend_stop(), TAG, "stop failed");
+    s_status = (dac_wave_status_t){ .shape = DAC_WAVE_OFF };
+    return ESP_OK;
+}
+
+void dac_wave_get_status(dac_wave_status_t *out)
+{
+    if (!out) return;
+    *out = s_status;
+}
+
+/* ====== Handlers: /api/dac ====== */
+
+static const char *const s_shape_names[] = {
+    [DAC_WAVE_OFF] = "off",
+    [DAC_WAVE_COSINE] = "cos",
+    [DAC_WAVE_SINE] = "sine",
+    [DAC_WAVE_TRIANGLE] = "tri",
+    [DAC_WAVE_SAW] = "saw",
+    [DAC_WAVE_SQUARE] = "square",
+    [DAC_WAVE_TABLE] = "table",
+};
+
+static esp_err_t send_status(httpd_req_t *req)
+{
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"channel\":%d,\"wave\":\"%s\",\"freq\":%u,\"sample_hz\":%u,\"samples\":%u}",
+             s_channel, s_shape_names[s_status.shape], (unsigned)s_status.freq_hz,
+             (unsigned)s_status.sample_hz, (unsigned)s_status.samples);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+static bool query_int(httpd_req_t *req, const char *query, const char *key,
+                      int64_t min, int64_t max, int64_t *out)
+{
+    // missing keys keep the default in *out
+    char *s = http_hal_scratch_query_value(req, query, key);
+    return !s || http_hal_parse_int(s, min, max, out);
+}
+
+static esp_err_t dac_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    if (!query) return send_status(req);
+
+    char *stop = http_hal_scratch_query_value(req, query, "stop");
+    int do_stop = 0;
+    if (stop && http_hal_parse_bool(stop, &do_stop) && do_stop) {
+        if (dac_wave_stop() != ESP_OK) {
+            return http_hal_send_err(req, 500, "DAC stop failed");
+        }
+        return send_status(req);
+    }
+
+    char *wave = http_hal_scratch_query_value(req, query, "wave");
+    if (!wave) return send_status(req);
+
+    int shape = -1;
+    for (int i = DAC_WAVE_COSINE; i <= DAC_WAVE_SQUARE; i++) {
+        if (!strcmp(wave, s_shape_names[i])) shape = i;
+    }
+    if (shape < 0) {
+        return http_hal_send_err(req, 400, "Invalid wave (cos, sine, tri, saw, square)");
+    }
+
+    int64_t freq = 1000, atten = 0, offset = 0, amp = 127, center = 128;
+    if (!query_int(req, query, "freq", 1, COSINE_MAX_HZ, &freq)) {
+        return http_hal_send_err(req, 400, "Invalid freq");
+    }
+
+    esp_err_t err;
+    if (shape == DAC_WAVE_COSINE) {
+        if (!query_int(req, query, "atten", 0, 3, &atten) || !query_int(req, query, "offset", -128, 127, &offset)) {
+            return http_hal_send_err(req, 400, "Invalid atten or offset");
+        }
+        err = dac_wave_cosine((uint32_t)freq, (int)atten, (int)offset);
+    } else {
+        if (!query_int(req, query, "amp", 0, 127, &amp) || !query_int(req, query, "center", 0, 255, &center)) {
+            return http_hal_send_err(req, 400, "Invalid amp or center");
+        }
+        err = dac_wave_generate((dac_wave_shape_t)shape, (uint32_t)freq, (int)amp, (int)center);
+    }
+
+    if (err == ESP_ERR_INVALID_ARG) {
+        return http_hal_send_err(req, 400, "Frequency out of range");
+    }
+    if (err != ESP_OK) {
+        return http_hal_send_err(req, 500, "DAC start failed");
+    }
+    return send_status(req);
+}
+
+static esp_err_t dac_post_handler(httpd_req_t *req)
+{
+    int64_t rate = SAMPLE_HZ;
+    char *query = http_hal_scratch_query(req);
+    if (query && !query_int(req, query, "rate", RATE_MIN_HZ, RATE_MAX_HZ, &rate)) {
+        return http_hal_send_err(req, 400, "Invalid rate");
+    }
+    if (req->content_len < MIN_SAMPLES || req->content_len > MAX_SAMPLES) {
+        return http_hal_send_err(req, 413, "Table size out of range");
+    }
+
+    // the table is copied into the DMA buffers, so it can be overwritten while playing
+    size_t got = 0;
+    while (got < req->content_len) {
+        size_t want = req->content_len - got;
+        int r = http_hal_recv(req, (char *)&s_table[got], want < RECV_CHUNK ? want : RECV_CHUNK);
+        if (r <= 0) return ESP_FAIL;
+        got += (size_t)r;
+    }
+
+    esp_err_t err = dac_wave_play_table(s_table, got, (uint32_t)rate);
+    if (err != ESP_OK) {
+        return http_hal_send_err(req, 500, "DAC start failed");
+    }
+    return send_status(req);
+}
+
+esp_err_t dac_wave_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/dac",
+        .method = HTTP_GET,
+        .handler = dac_get_handler,
+        .user_ctx = NULL
+    };
+    ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &ep), TAG, "register GET failed");
+
+    http_hal_endpoint_t post_ep = {
+        .uri = "/api/dac",
+        .method = HTTP_POST,
+        .handler = dac_post_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &post_ep);
+}
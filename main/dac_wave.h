@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file dac_wave.h
+ * @brief Waveform output on the DAC (ESP32, ESP32-S2)
+ * Two generators are available on the selected DAC channel:
+ * - the hardware cosine generator, which needs no memory and no DMA
+ * - a sample table (generated or uploaded) loaded once into DMA buffers and
+ *   replayed cyclically by the DAC DMA, so no CPU or network work is done per
+ *   sample once playback has started
+ * Table frequencies are realised as sample_rate / table_length, so the
+ * actual frequency is reported back.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DAC_WAVE_OFF,
+    DAC_WAVE_COSINE,        // hardware cosine generator
+    DAC_WAVE_SINE,
+    DAC_WAVE_TRIANGLE,
+    DAC_WAVE_SAW,
+    DAC_WAVE_SQUARE,
+    DAC_WAVE_TABLE,         // uploaded samples
+} dac_wave_shape_t;
+
+/**
+ * @brief Playback status
+ */
+typedef struct {
+    dac_wave_shape_t shape;
+    uint32_t freq_hz;       // actual output frequency (table: one period per table)
+    uint32_t sample_hz;     // DMA sample rate, 0 for the cosine generator
+    size_t   samples;       // table length
+} dac_wave_status_t;
+
+/**
+ * @brief Select the DAC channel (nothing is output until a waveform is started)
+ *
+ * @param[in] channel DAC channel, 0 or 1
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED on targets without DAC
+ */
+esp_err_t dac_wave_init(int channel);
+
+/**
+ * @brief Start the hardware cosine generator
+ *
+ * @param[in] freq_hz Frequency (130 Hz and up)
+ * @param[in] atten   Amplitude step: 0 = full scale, 1..3 = -6/-12/-18 dB
+ * @param[in] offset  DC offset, -128..127
+ * @return ESP_OK on success
+ */
+esp_err_t dac_wave_cosine(uint32_t freq_hz, int atten, int offset);
+
+/**
+ * @brief Generate one period of a waveform and play it through DMA
+ *
+ * @param[in] shape     DAC_WAVE_SINE, TRIANGLE, SAW or SQUARE
+ * @param[in] freq_hz   Requested frequency
+ * @param[in] amplitude Peak amplitude, 0..127
+ * @param[in] center    Mid level, 0..255
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the frequency cannot be
+ *         reached with CONFIG_DAC_WAVE_SAMPLE_HZ and the table size
+ */
+esp_err_t dac_wave_generate(dac_wave_shape_t shape, uint32_t freq_hz, int amplitude, int center);
+
+/**
+ * @brief Play a sample table cyclically through DMA
+ *
+ * The samples are copied into the DMA buffers, the table may be reused.
+ *
+ * @param[in] samples   8-bit DAC codes
+ * @param[in] n         Number of samples (at most CONFIG_DAC_WAVE_MAX_SAMPLES)
+ * @param[in] sample_hz Sample rate
+ * @return ESP_OK on success
+ */
+esp_err_t dac_wave_play_table(const uint8_t *samples, size_t n, uint32_t sample_hz);
+
+/**
+ * @brief Stop the output and release the DAC channel
+ */
+esp_err_t dac_wave_stop(void);
+
+/**
+ * @brief Get the playback status
+ *
+ * @param[out] out Returned status
+ */
+void dac_wave_get_status(dac_wave_status_t *out);
+
+/**
+ * @brief Register the /api/dac endpoints
+ *
+ * - GET  ?wave=cos&freq=<hz>&atten=<0-3>&offset=<n> hardware cosine
+ * - GET  ?wave=sine|tri|saw|square&freq=<hz>&amp=<0-127>&center=<0-255>
+ * - POST ?rate=<hz> plays the body as a table of 8-bit samples
+ * - GET  ?stop=1 stops the output
+ * Without parameters the endpoint reports the status.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t dac_wave_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
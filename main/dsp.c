@@ -0,0 +1,173 @@
+#include "dsp.h"
+
+#include <math.h>
+#include <string.h>
+#include "sdkconfig.h"
+
+/*
+ * esp-dsp is an optional managed component (idf.py add-dependency
+ * espressif/esp-dsp). Its generic entry points dispatch to the SIMD (S3) or
+ * assembly (ESP32) versions for the target.
+ */
+#if !CONFIG_IDF_TARGET_LINUX && defined(__has_include)
+#if __has_include("dsps_dotprod.h") && __has_include("dsps_biquad.h")
+#define DSP_USE_ESP_DSP 1
+#include "dsps_dotprod.h"
+#include "dsps_biquad.h"
+#endif
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const char *dsp_backend(void)
+{
+#if DSP_USE_ESP_DSP
+    return "esp-dsp";
+#else
+    return "c";
+#endif
+}
+
+void dsp_u16_to_f32(const uint16_t *in, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (float)(in[i] & 0x0FFF);
+    }
+}
+
+/* ====== Decimation ====== */
+
+void dsp_decim_init(dsp_decim_t *d, uint32_t factor)
+{
+    d->factor = factor ? factor : 1;
+    d->count = 0;
+    d->acc = 0.0f;
+}
+
+size_t dsp_decim_f32(dsp_decim_t *d, const float *in, float *out, size_t n)
+{
+    // out[j] is written after in[0..j*factor] were read, so in place is safe
+    size_t m = 0;
+    float scale = 1.0f / (float)d->factor;
+    for (size_t i = 0; i < n; i++) {
+        d->acc += in[i];
+        if (++d->count == d->factor) {
+            out[m++] = d->acc * scale;
+            d->acc = 0.0f;
+            d->count = 0;
+        }
+    }
+    return m;
+}
+
+/* ====== Dot product based kernels ====== */
+
+float dsp_dot_f32(const float *a, const float *b, size_t n)
+{
+#if DSP_USE_ESP_DSP
+    float r = 0.0f;
+    dsps_dotprod_f32(a, b, &r, (int)n);
+    return r;
+#else
+    // independent accumulators keep the FPU pipeline (or host SIMD) busy
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+#endif
+}
+
+float dsp_sumsq_f32(const float *x, size_t n)
+{
+    return dsp_dot_f32(x, x, n);
+}
+
+void dsp_fir_init_lowpass(dsp_fir_t *f, uint32_t taps, float fc)
+{
+    memset(f, 0, sizeof(*f));
+    if (taps < 1) taps = 1;
+    if (taps > DSP_FIR_MAX_TAPS) taps = DSP_FIR_MAX_TAPS;
+    f->taps = taps;
+
+    float mid = (float)(taps - 1) / 2.0f;
+    float sum = 0.0f;
+    for (uint32_t k = 0; k < taps; k++) {
+        float t = (float)k - mid;
+        float sinc = t == 0.0f ? 2.0f * fc : sinf(2.0f * (float)M_PI * fc * t) / ((float)M_PI * t);
+        float win = taps > 1 ? 0.54f - 0.46f * cosf(2.0f * (float)M_PI * (float)k / (float)(taps - 1)) : 1.0f;
+        f->coeffs[k] = sinc * win;
+        sum += f->coeffs[k];
+    }
+    // unity gain at DC
+    for (uint32_t k = 0; k < taps; k++) f->coeffs[k] /= sum;
+}
+
+void dsp_fir_f32(dsp_fir_t *f, const float *in, float *out, size_t n)
+{
+    uint32_t taps = f->taps;
+    for (size_t i = 0; i < n; i++) {
+        // each sample is stored twice, so the window starting at pos is never wrapped
+        f->pos = (f->pos ? f->pos : taps) - 1;
+        f->delay[f->pos] = in[i];
+        f->delay[f->pos + taps] = in[i];
+        out[i] = dsp_dot_f32(f->coeffs, &f->delay[f->pos], taps);
+    }
+}
+
+/* ====== Biquad ====== */
+
+void dsp_biquad_init(dsp_biquad_t *b, float fc, int highpass)
+{
+    // RBJ cookbook, Q = 1/sqrt(2)
+    float w0 = 2.0f * (float)M_PI * fc;
+    float c = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * (float)M_SQRT1_2);
+    float a0 = 1.0f + alpha;
+
+    float k = highpass ? (1.0f + c) / 2.0f : (1.0f - c) / 2.0f;
+    b->coef[0] = k / a0;
+    b->coef[1] = (highpass ? -2.0f * k : 2.0f * k) / a0;
+    b->coef[2] = k / a0;
+    b->coef[3] = -2.0f * c / a0;
+    b->coef[4] = (1.0f - alpha) / a0;
+    b->w[0] = b->w[1] = 0.0f;
+}
+
+void dsp_biquad_f32(dsp_biquad_t *b, const float *in, float *out, size_t n)
+{
+#if DSP_USE_ESP_DSP
+    dsps_biquad_f32(in, out, (int)n, b->coef, b->w);
+#else
+    const float *c = b->coef;
+    float w0 = b->w[0], w1 = b->w[1];
+    for (size_t i = 0; i < n; i++) {
+        float d = in[i] - c[3] * w0 - c[4] * w1;
+        out[i] = c[0] * d + c[1] * w0 + c[2] * w1;
+        w1 = w0;
+        w0 = d;
+    }
+    b->w[0] = w0;
+    b->w[1] = w1;
+#endif
+}
+
+/* ====== Reductions ====== */
+
+void dsp_minmax_f32(const float *x, size_t n, float *min, float *max)
+{
+    float lo = *min, hi = *max;
+    for (size_t i = 0; i < n; i++) {
+        lo = x[i] < lo ? x[i] : lo;
+        hi = x[i] > hi ? x[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
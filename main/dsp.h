@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file dsp.h
+ * @brief Signal processing kernels on float sample buffers
+ * Block kernels (decimation, FIR, biquad IIR, sum of squares, min/max) with
+ * their state kept in small structs, so a stream can be processed one block
+ * at a time. The FIR keeps a mirrored delay line, so every output is one
+ * contiguous dot product. When the esp-dsp component is part of the build,
+ * dot products and biquads go through it, which selects the SIMD code of
+ * the ESP32-S3 (and the optimized ESP32 code); otherwise portable C is used,
+ * which also builds on the linux target.
+ * All kernels work in place (out may equal in).
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSP_FIR_MAX_TAPS 32
+
+/**
+ * @brief Box-car decimator: each output is the mean of factor inputs
+ */
+typedef struct {
+    uint32_t factor;
+    uint32_t count;
+    float    acc;
+} dsp_decim_t;
+
+/**
+ * @brief FIR filter state
+ */
+typedef struct {
+    uint32_t taps;
+    uint32_t pos;
+    float    coeffs[DSP_FIR_MAX_TAPS];          // h[0] applies to the newest sample
+    float    delay[2 * DSP_FIR_MAX_TAPS];       // two copies, newest first from pos
+} dsp_fir_t;
+
+/**
+ * @brief Biquad (direct form II, esp-dsp coefficient layout)
+ */
+typedef struct {
+    float coef[5];          // b0, b1, b2, a1, a2 (a0 = 1)
+    float w[2];
+} dsp_biquad_t;
+
+/**
+ * @brief Name of the kernel implementation ("esp-dsp" or "c")
+ */
+const char *dsp_backend(void);
+
+/**
+ * @brief Convert packed 12-bit values to float
+ */
+void dsp_u16_to_f32(const uint16_t *in, float *out, size_t n);
+
+void dsp_decim_init(dsp_decim_t *d, uint32_t factor);
+
+/**
+ * @return Number of outputs written
+ */
+size_t dsp_decim_f32(dsp_decim_t *d, const float *in, float *out, size_t n);
+
+/**
+ * @brief Windowed-sinc (Hamming) low-pass
+ *
+ * @param[out] f    Filter
+ * @param[in]  taps Number of taps, 1..DSP_FIR_MAX_TAPS
+ * @param[in]  fc   Cutoff as a fraction of the sample rate, (0, 0.5)
+ */
+void dsp_fir_init_lowpass(dsp_fir_t *f, uint32_t taps, float fc);
+
+void dsp_fir_f32(dsp_fir_t *f, const float *in, float *out, size_t n);
+
+/**
+ * @brief Second order Butterworth low-pass or high-pass
+ *
+ * @param[out] b        Filter
+ * @param[in]  fc       Cutoff as a fraction of the sample rate, (0, 0.5)
+ * @param[in]  highpass High-pass instead of low-pass
+ */
+void dsp_biquad_init(dsp_biquad_t *b, float fc, int highpass);
+
+void dsp_biquad_f32(dsp_biquad_t *b, const float *in, float *out, size_t n);
+
+/**
+ * @brief Dot product of two buffers
+ */
+float dsp_dot_f32(const float *a, const float *b, size_t n);
+
+/**
+ * @brief Sum of squares (RMS windows)
+ */
+float dsp_sumsq_f32(const float *x, size_t n);
+
+/**
+ * @brief Update running minimum and maximum (peak windows)
+ */
+void dsp_minmax_f32(const float *x, size_t n, float *min, float *max);
+
+#ifdef __cplusplus
+}
+#endif
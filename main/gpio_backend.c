@@ -0,0 +1,164 @@
+#include "gpio_backend.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "common.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+static const char *TAG = "GPIO_BACKEND";
+
+_Static_assert(sizeof(gpio_sim_pin_t) == 32, "gpio_sim_pin_t layout is shared with tools/gpio_sim.py");
+
+#if CONFIG_IDF_TARGET_LINUX
+
+/* ====== Simulated pins (linux) ====== */
+
+static gpio_sim_map_t *s_map;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+esp_err_t gpio_backend_init(void)
+{
+    if (s_map) return ESP_OK;
+
+    int fd = open(CONFIG_GPIO_SIM_PATH, O_RDWR | O_CREAT, 0666);
+    ESP_RETURN_ON_FALSE(fd >= 0, ESP_FAIL, TAG, "cannot open %s", CONFIG_GPIO_SIM_PATH);
+    if (ftruncate(fd, sizeof(gpio_sim_map_t)) != 0) {
+        close(fd);
+        ESP_LOGE(TAG, "cannot size %s", CONFIG_GPIO_SIM_PATH);
+        return ESP_FAIL;
+    }
+
+    void *p = mmap(NULL, sizeof(gpio_sim_map_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    ESP_RETURN_ON_FALSE(p != MAP_FAILED, ESP_FAIL, TAG, "mmap failed");
+    s_map = (gpio_sim_map_t *)p;
+
+    // input levels injected before start are kept, the firmware side is reset
+    if (s_map->magic != GPIO_SIM_MAGIC || s_map->version != GPIO_SIM_VERSION) {
+        memset(s_map, 0, sizeof(*s_map));
+        s_map->version = GPIO_SIM_VERSION;
+        s_map->pins = GPIO_SIM_PINS;
+        atomic_thread_fence(memory_order_release);
+        s_map->magic = GPIO_SIM_MAGIC;
+    }
+    for (size_t i = 0; i < GPIO_SIM_PINS; i++) {
+        if (s_map->pin[i].mode == GPIO_SIM_MODE_OUTPUT) s_map->pin[i].mode = GPIO_SIM_MODE_UNUSED;
+    }
+
+    ESP_LOGI(TAG, "Simulated GPIO mapped at %s", CONFIG_GPIO_SIM_PATH);
+    return ESP_OK;
+}
+
+esp_err_t gpio_backend_config_output(uint64_t pin_mask)
+{
+    ESP_RETURN_ON_FALSE(s_map, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    for (size_t i = 0; i < GPIO_SIM_PINS; i++) {
+        if (pin_mask & (1ULL << i)) s_map->pin[i].mode = GPIO_SIM_MODE_OUTPUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_sim_config_input(uint64_t pin_mask)
+{
+    ESP_RETURN_ON_FALSE(s_map, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    // the level is left alone: it belongs to the test process
+    for (size_t i = 0; i < GPIO_SIM_PINS; i++) {
+        if (pin_mask & (1ULL << i)) s_map->pin[i].mode = GPIO_SIM_MODE_INPUT;
+    }
+    return ESP_OK;
+}
+
+void gpio_sim_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (!s_map || pin < 0 || pin >= GPIO_SIM_PINS) return;
+
+    gpio_sim_pin_t *p = &s_map->pin[pin];
+    _Atomic uint32_t *seq = (_Atomic uint32_t *)&p->changes;
+    level = level ? 1 : 0;
+    if (atomic_load_explicit((_Atomic uint32_t *)&p->level, memory_order_relaxed) == level) return;
+
+    // odd while the pair is written, readers retry until it is even again
+    uint32_t s = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit((_Atomic uint32_t *)&p->level, level, memory_order_relaxed);
+    atomic_store_explicit((_Atomic int64_t *)&p->t_ns, now_ns(), memory_order_relaxed);
+    atomic_store_explicit(seq, s + 2, memory_order_release);
+}
+
+int gpio_sim_get_level(gpio_num_t pin)
+{
+    if (!s_map || pin < 0 || pin >= GPIO_SIM_PINS) return 0;
+    return (int)atomic_load_explicit((_Atomic uint32_t *)&s_map->pin[pin].level, memory_order_acquire);
+}
+
+uint32_t gpio_sim_read(gpio_num_t pin, uint32_t *level, int64_t *t_ns)
+{
+    if (!s_map || pin < 0 || pin >= GPIO_SIM_PINS) {
+        *level = 0;
+        *t_ns = 0;
+        return 0;
+    }
+
+    gpio_sim_pin_t *p = &s_map->pin[pin];
+    _Atomic uint32_t *seq = (_Atomic uint32_t *)&p->changes;
+    for (;;) {
+        uint32_t s = atomic_load_explicit(seq, memory_order_acquire);
+        if (s & 1) continue;
+        *level = atomic_load_explicit((_Atomic uint32_t *)&p->level, memory_order_relaxed);
+        *t_ns = atomic_load_explicit((_Atomic int64_t *)&p->t_ns, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(seq, memory_order_relaxed) == s) return s;
+    }
+}
+
+const char *gpio_backend_name(void)
+{
+    return "sim";
+}
+
+#else
+
+/* ====== GPIO driver (chip) ====== */
+
+esp_err_t gpio_backend_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_backend_config_output(uint64_t pin_mask)
+{
+    gpio_config_t io_conf = {
+        .pin_bit_mask = pin_mask,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = 0,
+        .pull_down_en = 0,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "gpio_config failed");
+    return ESP_OK;
+}
+
+const char *gpio_backend_name(void)
+{
+    return "driver";
+}
+
+#endif
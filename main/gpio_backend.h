@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_backend.h
+ * @brief Pin access backend used by the GPIO modules
+ * On chip targets the backend is the IDF GPIO driver. On the linux target the
+ * driver is a stub, so pins are simulated in a memory-mapped state file
+ * (CONFIG_GPIO_SIM_PATH) that external processes can map to observe output
+ * levels and change timestamps, and to inject input levels that gpio_capture
+ * records as edges.
+ * The backend is selected at compile time; level accessors are inline so the
+ * chip path costs exactly one driver call, as before.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_SIM_MAGIC      0x4F495047u     // "GPIO"
+#define GPIO_SIM_VERSION    2
+#define GPIO_SIM_PINS       64
+
+/**
+ * @brief Pin modes as stored in the simulation file
+ */
+typedef enum {
+    GPIO_SIM_MODE_UNUSED = 0,
+    GPIO_SIM_MODE_INPUT,
+    GPIO_SIM_MODE_OUTPUT
+} gpio_sim_mode_t;
+
+/**
+ * @brief Layout of the simulation file, shared with tools/gpio_sim.py
+ *
+ * All fields are little endian. Each pin has a single writer (the firmware
+ * for outputs, a test process for inputs), which guards level and t_ns with a
+ * sequence counter: changes is made odd before the write and even again
+ * after it. Readers retry while it is odd or moved during their read.
+ */
+typedef struct {
+    uint32_t level;         // current level (outputs: written by firmware, inputs: by testers)
+    uint32_t mode;          // gpio_sim_mode_t
+    uint32_t changes;       // sequence counter, advances by 2 per level change
+    uint32_t reserved;
+    int64_t  t_ns;          // CLOCK_MONOTONIC time of the last change
+    int64_t  reserved2;
+} gpio_sim_pin_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pins;
+    uint32_t reserved;
+    gpio_sim_pin_t pin[GPIO_SIM_PINS];
+} gpio_sim_map_t;
+
+/**
+ * @brief Prepare the backend (maps the simulation file on linux)
+ *
+ * Safe to call more than once.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_backend_init(void);
+
+/**
+ * @brief Configure pins as outputs
+ *
+ * @param[in] pin_mask Bit n selects GPIO n
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_backend_config_output(uint64_t pin_mask);
+
+/**
+ * @brief Backend name, for logs and status endpoints
+ */
+const char *gpio_backend_name(void);
+
+#if CONFIG_IDF_TARGET_LINUX
+
+void gpio_sim_set_level(gpio_num_t pin, uint32_t level);
+int gpio_sim_get_level(gpio_num_t pin);
+
+/**
+ * @brief Mark pins as inputs driven by a test process
+ *
+ * @param[in] pin_mask Bit n selects GPIO n
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_sim_config_input(uint64_t pin_mask);
+
+/**
+ * @brief Read the level and change time of a pin as a consistent pair
+ *
+ * @param[in]  pin   Pin number
+ * @param[out] level Current level
+ * @param[out] t_ns  CLOCK_MONOTONIC time of the last change
+ * @return Sequence counter of the pair, it differs after every change
+ */
+uint32_t gpio_sim_read(gpio_num_t pin, uint32_t *level, int64_t *t_ns);
+
+static inline void gpio_backend_set_level(gpio_num_t pin, uint32_t level)
+{
+    gpio_sim_set_level(pin, level);
+}
+
+static inline int gpio_backend_get_level(gpio_num_t pin)
+{
+    return gpio_sim_get_level(pin);
+}
+
+#else
+
+static inline void gpio_backend_set_level(gpio_num_t pin, uint32_t level)
+{
+    gpio_set_level(pin, level);
+}
+
+static inline int gpio_backend_get_level(gpio_num_t pin)
+{
+    return gpio_get_level(pin);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,308 @@
+#include "gpio_bundle.h"
+
+#include "freertos/FreeRTOS.h"
+#include "soc/soc_caps.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_backend.h"
+
+#if SOC_DEDICATED_GPIO_SUPPORTED
+#include "driver/dedic_gpio.h"
+#include "hal/dedic_gpio_cpu_ll.h"
+#endif
+#if !CONFIG_IDF_TARGET_LINUX
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#endif
+
+static const char *TAG = "GPIO_BUNDLE";
+
+#define BENCH_MAX_ITERS 10000
+
+static gpio_num_t s_pins[GPIO_BUNDLE_MAX_PINS];
+static size_t s_len;
+static uint32_t s_all;
+static uint32_t s_value;
+static gpio_bundle_mode_t s_mode;
+
+#if SOC_DEDICATED_GPIO_SUPPORTED
+static dedic_gpio_bundle_handle_t s_bundle;
+static uint32_t s_offset;
+static int s_core = -1;
+#endif
+
+static portMUX_TYPE s_bench_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ====== Write paths ====== */
+
+#if !CONFIG_IDF_TARGET_LINUX
+static inline void register_write(uint32_t mask, uint32_t value)
+{
+    // set and clear masks are built first so the stores are back to back
+    uint32_t set = 0, clr = 0;
+    for (size_t i = 0; i < s_len; i++) {
+        uint32_t bit = 1u << i;
+        if (!(mask & bit)) continue;
+        if (value & bit) {
+            set |= 1u << s_pins[i];
+        } else {
+            clr |= 1u << s_pins[i];
+        }
+    }
+    REG_WRITE(GPIO_OUT_W1TC_REG, clr);
+    REG_WRITE(GPIO_OUT_W1TS_REG, set);
+}
+#endif
+
+static void driver_write(uint32_t mask, uint32_t value)
+{
+    for (size_t i = 0; i < s_len; i++) {
+        if (mask & (1u << i)) gpio_backend_set_level(s_pins[i], (value >> i) & 1u);
+    }
+}
+
+void gpio_bundle_write(uint32_t mask, uint32_t value)
+{
+    mask &= s_all;
+    s_value = (s_value & ~mask) | (value & mask);
+
+    switch (s_mode) {
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    case GPIO_BUNDLE_MODE_DEDICATED:
+        dedic_gpio_cpu_ll_write_mask(mask << s_offset, value << s_offset);
+        break;
+#endif
+#if !CONFIG_IDF_TARGET_LINUX
+    case GPIO_BUNDLE_MODE_REGISTER:
+        register_write(mask, value);
+        break;
+#endif
+    case GPIO_BUNDLE_MODE_DRIVER:
+        driver_write(mask, value);
+        break;
+    default:
+        break;
+    }
+}
+
+/* ====== API ====== */
+
+esp_err_t gpio_bundle_init(const gpio_num_t *pins, size_t n)
+{
+    ESP_RETURN_ON_FALSE(pins && n > 0 && n <= GPIO_BUNDLE_MAX_PINS, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    ESP_RETURN_ON_FALSE(s_mode == GPIO_BUNDLE_MODE_NONE, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    uint64_t sel = 0;
+    bool low_bank = true;
+    for (size_t i = 0; i < n; i++) {
+        ESP_RETURN_ON_FALSE(pins[i] >= 0 && pins[i] < 64, ESP_ERR_INVALID_ARG, TAG, "bad pin %d", pins[i]);
+        s_pins[i] = pins[i];
+        sel |= 1ULL << pins[i];
+        if (pins[i] >= 32) low_bank = false;
+    }
+
+    ESP_RETURN_ON_ERROR(gpio_backend_init(), TAG, "backend init failed");
+    ESP_RETURN_ON_ERROR(gpio_backend_config_output(sel), TAG, "output config failed");
+    for (size_t i = 0; i < n; i++) {
+        gpio_backend_set_level(pins[i], 0);
+    }
+
+    s_len = n;
+    s_all = (1u << n) - 1;
+    s_value = 0;
+    s_mode = GPIO_BUNDLE_MODE_DRIVER;
+
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    // routes the pins to the CPU dedicated GPIO channels
+    int gpio_array[GPIO_BUNDLE_MAX_PINS];
+    for (size_t i = 0; i < n; i++) gpio_array[i] = pins[i];
+    dedic_gpio_bundle_config_t cfg = {
+        .gpio_array = gpio_array,
+        .array_size = n,
+        .flags.out_en = 1
+    };
+    if (dedic_gpio_new_bundle(&cfg, &s_bundle) == ESP_OK &&
+        dedic_gpio_get_out_offset(s_bundle, &s_offset) == ESP_OK) {
+        s_mode = GPIO_BUNDLE_MODE_DEDICATED;
+        s_core = esp_cpu_get_core_id();
+    } else {
+        ESP_LOGW(TAG, "Dedicated GPIO unavailable, using register writes");
+    }
+#endif
+#if !CONFIG_IDF_TARGET_LINUX
+    if (s_mode == GPIO_BUNDLE_MODE_DRIVER && low_bank) {
+        s_mode = GPIO_BUNDLE_MODE_REGISTER;
+    }
+#else
+    (void)low_bank;
+#endif
+
+    LOG_GPIO("Bundle of %u pins, mode %d", (unsigned)n, s_mode);
+    return ESP_OK;
+}
+
+gpio_bundle_mode_t gpio_bundle_get_mode(void)
+{
+    return s_mode;
+}
+
+int gpio_bundle_core(void)
+{
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    return s_core;
+#else
+    return -1;
+#endif
+}
+
+size_t gpio_bundle_size(void)
+{
+    return s_len;
+}
+
+uint32_t gpio_bundle_read(void)
+{
+    return s_value;
+}
+
+esp_err_t gpio_bundle_bench(uint32_t iters, gpio_bundle_bench_t *out)
+{
+    ESP_RETURN_ON_FALSE(out && iters > 0 && iters <= BENCH_MAX_ITERS, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    ESP_RETURN_ON_FALSE(s_mode != GPIO_BUNDLE_MODE_NONE, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    uint64_t drv = 0, drv_skew = 0, bnd = 0;
+    uint32_t saved = s_value;
+
+    // cost of reading the cycle counter itself, removed from every sample
+    esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+    esp_cpu_cycle_count_t c1 = esp_cpu_get_cycle_count();
+    uint32_t overhead = c1 - c0;
+
+    for (uint32_t it = 0; it < iters; it++) {
+        // the driver clears the pins and the bundle sets them again, so both paths
+        // change every pin on every update; dedicated channels ignore the driver
+        // writes, there the bundle alternates on its own
+        uint32_t v = 0;
+        uint32_t bv = (s_mode == GPIO_BUNDLE_MODE_DEDICATED && (it & 1)) ? 0 : s_all;
+
+        // one update per critical section keeps interrupts off only briefly
+        portENTER_CRITICAL(&s_bench_lock);
+        esp_cpu_cycle_count_t t0 = esp_cpu_get_cycle_count();
+        esp_cpu_cycle_count_t t_last = t0;
+        for (size_t i = 0; i < s_len; i++) {
+            if (i == s_len - 1) t_last = esp_cpu_get_cycle_count();
+            gpio_backend_set_level(s_pins[i], (v >> i) & 1u);
+        }
+        esp_cpu_cycle_count_t t1 = esp_cpu_get_cycle_count();
+
+        esp_cpu_cycle_count_t t2 = esp_cpu_get_cycle_count();
+        gpio_bundle_write(s_all, bv);
+        esp_cpu_cycle_count_t t3 = esp_cpu_get_cycle_count();
+        portEXIT_CRITICAL(&s_bench_lock);
+
+        drv += t1 - t0 - overhead;
+        // the last write lands one call after t_last
+        drv_skew += (s_len > 1) ? (t_last - t0 - overhead) : 0;
+        bnd += t3 - t2 - overhead;
+    }
+
+    gpio_bundle_write(s_all, saved);
+
+    out->iters = iters;
+    out->pins = s_len;
+    out->cpu_mhz = esp_rom_get_cpu_ticks_per_us();
+    out->driver_cycles = (uint32_t)(drv / iters);
+    out->driver_skew_cycles = (uint32_t)(drv_skew / iters);
+    out->bundle_cycles = (uint32_t)(bnd / iters);
+    return ESP_OK;
+}
+
+/* ====== Handlers: /api/gpio/bundle ====== */
+
+static const char *mode_name(gpio_bundle_mode_t mode)
+{
+    switch (mode) {
+    case GPIO_BUNDLE_MODE_DEDICATED: return "dedicated";
+    case GPIO_BUNDLE_MODE_REGISTER:  return "register";
+    case GPIO_BUNDLE_MODE_DRIVER:    return "driver";
+    default:                         return "none";
+    }
+}
+
+static esp_err_t bundle_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *value_str = http_hal_scratch_query_value(req, query, "value");
+        char *mask_str = http_hal_scratch_query_value(req, query, "mask");
+        int64_t value = 0, mask = s_all;
+
+        if (value_str) {
+            if (!http_hal_parse_int(value_str, 0, s_all, &value)) {
+                return http_hal_send_err(req, 400, "Invalid value");
+            }
+            if (mask_str && !http_hal_parse_int(mask_str, 0, s_all, &mask)) {
+                return http_hal_send_err(req, 400, "Invalid mask");
+            }
+            gpio_bundle_write((uint32_t)mask, (uint32_t)value);
+        }
+    }
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"mode\":\"%s\",\"pins\":%u,\"value\":%u}",
+             mode_name(s_mode), (unsigned)s_len, (unsigned)s_value);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+static esp_err_t bench_get_handler(httpd_req_t *req)
+{
+    int64_t iters = 1000;
+    char *query = http_hal_scratch_query(req);
+    char *iters_str = query ? http_hal_scratch_query_value(req, query, "iters") : NULL;
+    if (iters_str && !http_hal_parse_int(iters_str, 1, BENCH_MAX_ITERS, &iters)) {
+        return http_hal_send_err(req, 400, "Invalid iters");
+    }
+
+    gpio_bundle_bench_t b;
+    if (gpio_bundle_bench((uint32_t)iters, &b) != ESP_OK) {
+        return http_hal_send_err(req, 500, "Benchmark failed");
+    }
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"mode\":\"%s\",\"iters\":%u,\"pins\":%u,\"cpu_mhz\":%u,"
+             "\"driver_cycles\":%u,\"driver_skew_cycles\":%u,\"bundle_cycles\":%u}",
+             mode_name(s_mode), (unsigned)b.iters, (unsigned)b.pins, (unsigned)b.cpu_mhz,
+             (unsigned)b.driver_cycles, (unsigned)b.driver_skew_cycles,
+             (unsigned)b.bundle_cycles);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+esp_err_t gpio_bundle_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/gpio/bundle",
+        .method = HTTP_GET,
+        .handler = bundle_get_handler,
+        .user_ctx = NULL
+    };
+    ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &ep), TAG, "register bundle failed");
+
+    http_hal_endpoint_t bench_ep = {
+        .uri = "/api/gpio/bundle/bench",
+        .method = HTTP_GET,
+        .handler = bench_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &bench_ep);
+}
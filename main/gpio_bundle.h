@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_bundle.h
+ * @brief Fast simultaneous writes to a group of output pins
+ * This module groups output pins into a bundle that is updated as a whole.
+ * On targets with dedicated GPIO the bundle is written by a single CPU
+ * instruction; elsewhere it falls back to direct W1TS/W1TC register writes
+ * (one store for all pins going high, one for all pins going low), and to the
+ * GPIO driver only where neither is available.
+ * Bit i of masks and values refers to the i-th pin of the bundle.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_BUNDLE_MAX_PINS 8
+
+/**
+ * @brief Write path used by the bundle
+ */
+typedef enum {
+    GPIO_BUNDLE_MODE_NONE = 0,
+    GPIO_BUNDLE_MODE_DEDICATED,     // dedicated GPIO, one instruction
+    GPIO_BUNDLE_MODE_REGISTER,      // W1TS/W1TC stores
+    GPIO_BUNDLE_MODE_DRIVER         // gpio_set_level() per pin
+} gpio_bundle_mode_t;
+
+/**
+ * @brief Benchmark result, times in CPU cycles averaged over the iterations
+ */
+typedef struct {
+    uint32_t iters;
+    uint32_t pins;
+    uint32_t cpu_mhz;
+    uint32_t driver_cycles;         // update of all pins through gpio_set_level()
+    uint32_t driver_skew_cycles;    // first to last pin write through the driver
+    uint32_t bundle_cycles;         // update of all pins through the bundle
+} gpio_bundle_bench_t;
+
+/**
+ * @brief Create the bundle and configure its pins as outputs (initially low)
+ *
+ * @param[in] pins Pin list, at most GPIO_BUNDLE_MAX_PINS entries
+ * @param[in] n    Number of pins
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_bundle_init(const gpio_num_t *pins, size_t n);
+
+/**
+ * @brief Get the write path selected at init
+ */
+gpio_bundle_mode_t gpio_bundle_get_mode(void);
+
+/**
+ * @brief Number of pins in the bundle (0 if not initialized)
+ */
+size_t gpio_bundle_size(void);
+
+/**
+ * @brief Core that owns the bundle
+ *
+ * Dedicated GPIO channels belong to the CPU that created the bundle, writes must
+ * be issued from that core.
+ *
+ * @return Core id, or -1 if the write path is not core bound
+ */
+int gpio_bundle_core(void);
+
+/**
+ * @brief Update the pins selected by mask to the matching bits of value
+ *
+ * @param[in] mask  Pins to change
+ * @param[in] value New levels
+ */
+void gpio_bundle_write(uint32_t mask, uint32_t value);
+
+/**
+ * @brief Last value written to the bundle
+ */
+uint32_t gpio_bundle_read(void);
+
+/**
+ * @brief Compare driver-call and bundle latency, and the driver pin-to-pin skew
+ *
+ * Bundle writes change all pins with one store (dedicated) or two
+ * (register), so only the driver skew is measured. In dedicated mode the
+ * pins are routed to the CPU and the driver calls only measure their cost.
+ *
+ * The bundle pins toggle during the measurement.
+ *
+ * @param[in]  iters Number of updates per path
+ * @param[out] out   Returned measurements
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_bundle_bench(uint32_t iters, gpio_bundle_bench_t *out);
+
+/**
+ * @brief Register the /api/gpio/bundle endpoints
+ *
+ * - GET /api/gpio/bundle?value=<n>&mask=<n> writes the bundle (mask defaults
+ *   to all pins); without parameters it reports the current value
+ * - GET /api/gpio/bundle/bench?iters=<n> runs gpio_bundle_bench()
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_bundle_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,290 @@
+#include "gpio_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_backend.h"
+#include "stream_codec.h"
+
+static const char *TAG = "GPIO_CAPTURE";
+
+#define RING_LEN    CONFIG_GPIO_CAPTURE_RING_LEN
+#define RING_MASK   (RING_LEN - 1)
+#define READ_BATCH  16
+#define MAX_DEFAULT 64
+#define SIM_POLL_US 1000
+
+_Static_assert((RING_LEN & RING_MASK) == 0, "GPIO_CAPTURE_RING_LEN must be a power of two");
+
+/*
+ * The ISR must stay in IRAM to keep capturing while flash cache is disabled,
+ * which needs the GPIO control functions in IRAM as well.
+ */
+#if CONFIG_GPIO_CTRL_FUNC_IN_IRAM
+#define CAPTURE_INTR_FLAGS  ESP_INTR_FLAG_IRAM
+#define CAPTURE_ATTR        IRAM_ATTR
+#else
+#define CAPTURE_INTR_FLAGS  0
+#define CAPTURE_ATTR
+#endif
+
+// single producer (the GPIO ISR), any number of cursor readers
+static DRAM_ATTR gpio_capture_event_t s_ring[RING_LEN];
+static atomic_uint s_head;
+
+static size_t s_len;
+
+#if CONFIG_IDF_TARGET_LINUX
+static gpio_num_t s_pins[GPIO_CAPTURE_MAX_PINS];
+static uint32_t s_seen[GPIO_CAPTURE_MAX_PINS];
+static esp_timer_handle_t s_poll;
+#endif
+
+/* ====== ISR ====== */
+
+static inline void CAPTURE_ATTR capture_push(int64_t t_us, gpio_num_t pin, int level)
+{
+    uint32_t h = atomic_load_explicit(&s_head, memory_order_relaxed);
+    gpio_capture_event_t *e = &s_ring[h & RING_MASK];
+    e->t_us = t_us;
+    e->pin = (uint8_t)pin;
+    e->level = (uint8_t)level;
+    // publishes the slot: readers never look past head
+    atomic_store_explicit(&s_head, h + 1, memory_order_release);
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+
+// simulated pins raise no interrupt: poll the levels injected by tools/gpio_sim.py
+static void capture_poll(void *arg)
+{
+    (void)arg;
+    for (size_t i = 0; i < s_len; i++) {
+        uint32_t level;
+        int64_t t_ns;
+        uint32_t seq = gpio_sim_read(s_pins[i], &level, &t_ns);
+        if (seq == s_seen[i]) continue;
+        s_seen[i] = seq;
+        // the injection time, same CLOCK_MONOTONIC base as esp_timer on the host
+        capture_push(t_ns / 1000, s_pins[i], (int)level);
+    }
+}
+
+#else
+
+static void CAPTURE_ATTR capture_isr(void *arg)
+{
+    gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
+    capture_push(esp_timer_get_time(), pin, gpio_backend_get_level(pin));
+}
+
+#endif
+
+/* ====== API ====== */
+
+esp_err_t gpio_capture_init(const gpio_num_t *pins, size_t n)
+{
+    ESP_RETURN_ON_FALSE(pins && n > 0 && n <= GPIO_CAPTURE_MAX_PINS, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    ESP_RETURN_ON_FALSE(s_len == 0, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    uint64_t sel = 0;
+    for (size_t i = 0; i < n; i++) {
+        ESP_RETURN_ON_FALSE(pins[i] >= 0 && pins[i] < 64, ESP_ERR_INVALID_ARG, TAG, "bad pin %d", pins[i]);
+        sel |= 1ULL << pins[i];
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    ESP_RETURN_ON_ERROR(gpio_backend_init(), TAG, "backend init failed");
+    ESP_RETURN_ON_ERROR(gpio_sim_config_input(sel), TAG, "input config failed");
+    for (size_t i = 0; i < n; i++) {
+        uint32_t level;
+        int64_t t_ns;
+        // only changes made after start are edges
+        s_pins[i] = pins[i];
+        s_seen[i] = gpio_sim_read(pins[i], &level, &t_ns);
+    }
+    s_len = n;
+
+    const esp_timer_create_args_t args = {
+        .callback = capture_poll,
+        .name = "capture_poll"
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_poll), TAG, "esp_timer_create failed");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(s_poll, SIM_POLL_US), TAG, "esp_timer_start_periodic failed");
+#else
+    gpio_config_t io_conf = {
+        .pin_bit_mask = sel,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = 0,
+        .pull_down_en = 0,
+        .intr_type = GPIO_INTR_ANYEDGE
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "gpio_config failed");
+
+    // another module may already have installed the shared ISR service
+    esp_err_t err = gpio_install_isr_service(CAPTURE_INTR_FLAGS);
+    ESP_RETURN_ON_FALSE(err == ESP_OK || err == ESP_ERR_INVALID_STATE, err, TAG, "gpio_install_isr_service failed");
+
+    for (size_t i = 0; i < n; i++) {
+        ESP_RETURN_ON_ERROR(gpio_isr_handler_add(pins[i], capture_isr, (void *)(intptr_t)pins[i]),
+                            TAG, "gpio_isr_handler_add failed");
+    }
+    s_len = n;
+#endif
+
+    LOG_GPIO("Capturing %u pins, ring of %d events", (unsigned)n, RING_LEN);
+    return ESP_OK;
+}
+
+uint32_t gpio_capture_head(void)
+{
+    return atomic_load_explicit(&s_head, memory_order_acquire);
+}
+
+size_t gpio_capture_read(uint32_t *cursor, gpio_capture_event_t *out, size_t max, uint32_t *lost)
+{
+    uint32_t h = atomic_load_explicit(&s_head, memory_order_acquire);
+    uint32_t seq = *cursor;
+    uint32_t skipped = 0;
+
+    // sequence numbers wrap, so compare distances rather than values
+    if (h - seq > RING_LEN) {
+        skipped = h - RING_LEN - seq;
+        seq = h - RING_LEN;
+    }
+
+    size_t n = h - seq;
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = s_ring[(seq + i) & RING_MASK];
+    }
+
+    // the ISR may have lapped the reader while copying: drop overwritten slots,
+    // including the one a not yet published event may be writing
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t h2 = atomic_load_explicit(&s_head, memory_order_relaxed);
+    if (h2 - seq >= RING_LEN) {
+        uint32_t bad = h2 + 1 - RING_LEN - seq;
+        if (bad > n) bad = n;
+        for (size_t i = bad; i < n; i++) out[i - bad] = out[i];
+        n -= bad;
+        skipped += bad;
+        seq += bad;
+    }
+
+    *cursor = seq + n;
+    if (lost) *lost = skipped;
+    return n;
+}
+
+/* ====== Handler: GET /api/gpio/capture ====== */
+
+/*
+ * One frame per batch: channel 0 = t_us (low 32 bits), 1 = pin, 2 = level.
+ * seq is the sequence number of the first event, so the next cursor is the
+ * seq of the last frame plus its event count.
+ */
+static esp_err_t send_frames(httpd_req_t *req, uint32_t cursor, size_t remaining)
+{
+    gpio_capture_event_t batch[READ_BATCH];
+    uint8_t buf[256];
+    stream_codec_enc_t enc;
+    stream_codec_init(&enc, buf, sizeof(buf), stream_codec_http_flush, req);
+
+    httpd_resp_set_type(req, STREAM_CODEC_MIME);
+    while (remaining > 0 && stream_codec_flush(&enc) == ESP_OK) {
+        uint32_t lost;
+        size_t n = gpio_capture_read(&cursor, batch, remaining < READ_BATCH ? remaining : READ_BATCH, &lost);
+        if (n == 0) break;
+
+        stream_codec_frame(&enc, cursor - n, (uint32_t)batch[0].t_us, 0x7, lost > UINT16_MAX ? UINT16_MAX : lost);
+        stream_codec_channel(&enc, n);
+        for (size_t i = 0; i < n; i++) stream_codec_value(&enc, (uint32_t)batch[i].t_us);
+        stream_codec_channel(&enc, n);
+        for (size_t i = 0; i < n; i++) stream_codec_value(&enc, batch[i].pin);
+        stream_codec_channel(&enc, n);
+        for (size_t i = 0; i < n; i++) stream_codec_value(&enc, batch[i].level);
+        remaining -= n;
+    }
+    esp_err_t err = stream_codec_flush(&enc);
+    if (err != ESP_OK) return err;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t capture_get_handler(httpd_req_t *req)
+{
+    uint32_t head = gpio_capture_head();
+    uint32_t cursor = head > RING_LEN ? head - RING_LEN : 0;
+    int64_t max = MAX_DEFAULT;
+
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        char *max_str = http_hal_scratch_query_value(req, query, "max");
+        char *fmt_str = http_hal_scratch_query_value(req, query, "fmt");
+        int64_t v;
+        if (since_str) {
+            if (!http_hal_parse_int(since_str, 0, UINT32_MAX, &v)) {
+                return http_hal_send_err(req, 400, "Invalid since");
+            }
+            cursor = (uint32_t)v;
+        }
+        if (max_str && !http_hal_parse_int(max_str, 1, RING_LEN, &max)) {
+            return http_hal_send_err(req, 400, "Invalid max");
+        }
+        if (fmt_str) {
+            if (strcmp(fmt_str, "frames") == 0) {
+                return send_frames(req, cursor, (size_t)max);
+            }
+            if (strcmp(fmt_str, "json") != 0) {
+                return http_hal_send_err(req, 400, "Invalid fmt");
+            }
+        }
+    }
+
+    // read in small batches and stream them, the response size is not bounded by the arena
+    gpio_capture_event_t batch[READ_BATCH];
+    char buf[512];
+    uint32_t lost_total = 0, first = cursor;
+    size_t remaining = (size_t)max, sent = 0;
+
+    http_hal_stream_t o;
+    http_hal_stream_begin(&o, req, buf, sizeof(buf), "application/json");
+    http_hal_stream_printf(&o, "{\"ok\":true,\"events\":[");
+    // a dropped client ends the read at the first failed chunk
+    while (remaining > 0 && o.err == ESP_OK) {
+        uint32_t lost;
+        size_t n = gpio_capture_read(&cursor, batch, remaining < READ_BATCH ? remaining : READ_BATCH, &lost);
+        lost_total += lost;
+        if (sent == 0) first = cursor - n;
+        if (n == 0) break;
+
+        for (size_t i = 0; i < n; i++) {
+            http_hal_stream_printf(&o, "%s[%lld,%u,%u]", sent + i ? "," : "", (long long)batch[i].t_us,
+                                   (unsigned)batch[i].pin, (unsigned)batch[i].level);
+        }
+        sent += n;
+        remaining -= n;
+    }
+
+    http_hal_stream_printf(&o, "],\"first\":%u,\"next\":%u,\"head\":%u,\"lost\":%u}",
+                           (unsigned)first, (unsigned)cursor, (unsigned)gpio_capture_head(), (unsigned)lost_total);
+    return http_hal_stream_end(&o);
+}
+
+esp_err_t gpio_capture_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/gpio/capture",
+        .method = HTTP_GET,
+        .handler = capture_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_capture.h
+ * @brief Interrupt-driven edge capture on input pins
+ * Every edge on the capture pins is timestamped in the GPIO ISR and stored in
+ * a lock-free ring written only by the ISR. Each event gets a sequence number;
+ * readers keep their own cursor and fetch the events that followed it, so fast
+ * signals are recorded without polling over the network. When a reader falls
+ * more than the ring length behind, the oldest events are reported as lost.
+ * On the linux target the simulated input pins (gpio_backend.h) are polled
+ * every millisecond instead, and events carry the time the level was injected.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_CAPTURE_MAX_PINS 8
+
+/**
+ * @brief Captured edge
+ */
+typedef struct {
+    int64_t  t_us;      // esp_timer_get_time() at the ISR
+    uint8_t  pin;       // GPIO number
+    uint8_t  level;     // level read right after the edge
+} gpio_capture_event_t;
+
+/**
+ * @brief Configure the pins as inputs and start capturing both edges
+ *
+ * @param[in] pins Pin list, at most GPIO_CAPTURE_MAX_PINS entries
+ * @param[in] n    Number of pins
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_capture_init(const gpio_num_t *pins, size_t n);
+
+/**
+ * @brief Sequence number the next event will get
+ */
+uint32_t gpio_capture_head(void);
+
+/**
+ * @brief Copy the events following a cursor
+ *
+ * @param[in,out] cursor Sequence number of the first wanted event, advanced past
+ *                       the returned events (and any lost ones)
+ * @param[out]    out    Event buffer
+ * @param[in]     max    Buffer capacity
+ * @param[out]    lost   Optional, events overwritten before they could be read
+ * @return Number of events copied
+ */
+size_t gpio_capture_read(uint32_t *cursor, gpio_capture_event_t *out, size_t max, uint32_t *lost);
+
+/**
+ * @brief Register the GET /api/gpio/capture endpoint
+ *
+ * Query parameters:
+ * - since=<seq> cursor returned as "next" by the previous call (default: oldest
+ *   event still in the ring)
+ * - max=<n> maximum number of events to return
+ * - fmt=frames streams the events as stream_codec.h frames instead of JSON:
+ *   one frame per batch, channels 0/1/2 = t_us (low 32 bits), pin, level
+ * Events are returned as [t_us, pin, level] triplets starting at "first".
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_capture_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,548 @@
+#include "gpio_hal.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_backend.h"
+#include "http_hal_rpc.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+#include "soc/gpio_reg.h"
+#endif
+
+static const char *TAG = "GPIO_HAL";
+
+_Static_assert(GPIO_HAL_CHANNEL_COUNT > 0 && GPIO_HAL_CHANNEL_COUNT <= 64,
+               "GPIO_OUT_CHANNELS must define 1..64 channels");
+
+// in DRAM: gpio_hal_set_isr() reads pin and polarity with the cache possibly off
+static const DRAM_ATTR gpio_hal_channel_t s_channels[GPIO_HAL_CHANNEL_COUNT] = {
+    GPIO_HAL_CHANNELS_INIT
+};
+
+#define ALL_MASK (UINT64_MAX >> (64 - GPIO_HAL_CHANNEL_COUNT))
+
+static uint64_t s_state;
+static uint32_t s_version;
+static uint64_t s_claimed;      // channels driven by a peripheral (LEDC, RMT), never written here
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// slots are filled before the count is published, readers never lock
+static struct {
+    gpio_hal_change_cb_t cb;
+    void                *arg;
+} s_change_cbs[GPIO_HAL_CHANGE_CBS];
+static atomic_size_t s_change_cb_count;
+static gpio_hal_transition_cb_t s_transition_cb;
+
+// ISR writes are notified later from the esp_timer task (channels flipped since)
+static uint64_t s_isr_changed;
+static bool s_isr_pending;
+static esp_timer_handle_t s_isr_timer;
+
+static void isr_notify_cb(void *arg);
+
+static inline uint32_t level_of(const gpio_hal_channel_t *ch, bool on)
+{
+    return (on ^ ch->active_low) ? 1 : 0;
+}
+
+/* ====== API ====== */
+
+esp_err_t gpio_hal_init(void)
+{
+    return gpio_hal_init_state(0, 0);
+}
+
+esp_err_t gpio_hal_init_state(uint64_t values, uint64_t valid)
+{
+    uint64_t sel = 0, initial = 0;
+    for (size_t i = 0; i < GPIO_HAL_CHANNEL_COUNT; i++) {
+        sel |= 1ULL << s_channels[i].pin;
+        if (s_channels[i].default_on) initial |= 1ULL << i;
+    }
+    initial = (initial & ~valid) | (values & valid);
+
+    ESP_RETURN_ON_ERROR(gpio_backend_init(), TAG, "backend init failed");
+    if (!s_isr_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = isr_notify_cb,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "gpio_hal_isr"
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_isr_timer), TAG, "esp_timer_create failed");
+    }
+
+    // levels are latched before the pins become outputs, so there is no glitch
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < GPIO_HAL_CHANNEL_COUNT; i++) {
+        gpio_backend_set_level(s_channels[i].pin, level_of(&s_channels[i], (initial >> i) & 1ULL));
+    }
+    s_state = initial & ALL_MASK;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_RETURN_ON_ERROR(gpio_backend_config_output(sel), TAG, "output config failed");
+
+    LOG_GPIO("%d output channels ready (%s backend)", GPIO_HAL_CHANNEL_COUNT, gpio_backend_name());
+    return ESP_OK;
+}
+
+size_t gpio_hal_channel_count(void)
+{
+    return GPIO_HAL_CHANNEL_COUNT;
+}
+
+const gpio_hal_channel_t *gpio_hal_channel(size_t idx)
+{
+    return idx < GPIO_HAL_CHANNEL_COUNT ? &s_channels[idx] : NULL;
+}
+
+int gpio_hal_find(const char *name)
+{
+    if (!name) return -1;
+    for (size_t i = 0; i < GPIO_HAL_CHANNEL_COUNT; i++) {
+        if (!strcmp(s_channels[i].name, name)) return (int)i;
+    }
+    return -1;
+}
+
+esp_err_t gpio_hal_set(size_t idx, bool on)
+{
+    return gpio_hal_set_src(idx, on, NULL);
+}
+
+esp_err_t gpio_hal_set_src(size_t idx, bool on, const gpio_hal_src_t *src)
+{
+    ESP_RETURN_ON_FALSE(idx < GPIO_HAL_CHANNEL_COUNT, ESP_ERR_INVALID_ARG, TAG, "bad channel");
+    if (gpio_hal_is_claimed(idx)) return ESP_ERR_INVALID_STATE;
+
+    gpio_hal_write_mask_src(1ULL << idx, on ? UINT64_MAX : 0, src);
+    return ESP_OK;
+}
+
+bool gpio_hal_get(size_t idx)
+{
+    return (gpio_hal_get_mask() >> idx) & 1ULL;
+}
+
+esp_err_t gpio_hal_claim(size_t idx)
+{
+    ESP_RETURN_ON_FALSE(idx < GPIO_HAL_CHANNEL_COUNT, ESP_ERR_INVALID_ARG, TAG, "bad channel");
+
+    portENTER_CRITICAL(&s_lock);
+    s_claimed |= 1ULL << idx;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_hal_release(size_t idx)
+{
+    ESP_RETURN_ON_FALSE(idx < GPIO_HAL_CHANNEL_COUNT, ESP_ERR_INVALID_ARG, TAG, "bad channel");
+    const gpio_hal_channel_t *ch = &s_channels[idx];
+
+    // the output register gets the channel state before the pin is reconnected to it
+    portENTER_CRITICAL(&s_lock);
+    gpio_backend_set_level(ch->pin, level_of(ch, (s_state >> idx) & 1ULL));
+    portEXIT_CRITICAL(&s_lock);
+    ESP_RETURN_ON_ERROR(gpio_backend_config_output(1ULL << ch->pin), TAG, "output config failed");
+
+    portENTER_CRITICAL(&s_lock);
+    s_claimed &= ~(1ULL << idx);
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+bool gpio_hal_is_claimed(size_t idx)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool claimed = idx < GPIO_HAL_CHANNEL_COUNT && ((s_claimed >> idx) & 1ULL);
+    portEXIT_CRITICAL(&s_lock);
+    return claimed;
+}
+
+uint32_t gpio_hal_get_version(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t v = s_version;
+    portEXIT_CRITICAL(&s_lock);
+    return v;
+}
+
+uint64_t gpio_hal_snapshot(uint32_t *version)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint64_t v = s_state;
+    *version = s_version;
+    portEXIT_CRITICAL(&s_lock);
+    return v;
+}
+
+esp_err_t gpio_hal_add_change_cb(gpio_hal_change_cb_t cb, void *arg)
+{
+    ESP_RETURN_ON_FALSE(cb, ESP_ERR_INVALID_ARG, TAG, "cb null");
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    size_t n = atomic_load_explicit(&s_change_cb_count, memory_order_relaxed);
+    if (n < GPIO_HAL_CHANGE_CBS) {
+        s_change_cbs[n].cb = cb;
+        s_change_cbs[n].arg = arg;
+        atomic_store_explicit(&s_change_cb_count, n + 1, memory_order_release);
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+void gpio_hal_set_transition_cb(gpio_hal_transition_cb_t cb)
+{
+    s_transition_cb = cb;
+}
+
+// called with s_lock held, so transitions are recorded in the order they were applied
+static void record_transition_locked(uint64_t old, uint64_t state, const gpio_hal_src_t *src)
+{
+    static const gpio_hal_src_t local = { GPIO_HAL_SRC_LOCAL, 0 };
+    // rewriting the current state is not a change: no callbacks, no version bump
+    if (old == state) return;
+    gpio_hal_transition_cb_t tcb = s_transition_cb;
+    if (tcb) tcb(old ^ state, state, src ? src : &local);
+}
+
+static void notify_change(uint64_t old, uint64_t state)
+{
+    if (old == state) return;
+    size_t n = atomic_load_explicit(&s_change_cb_count, memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+        s_change_cbs[i].cb(s_change_cbs[i].arg);
+    }
+}
+
+static void isr_notify_cb(void *arg)
+{
+    (void)arg;
+    static const gpio_hal_src_t src = { GPIO_HAL_SRC_SCHED, 0 };
+
+    portENTER_CRITICAL(&s_lock);
+    uint64_t changed = s_isr_changed;
+    uint64_t state = s_state;
+    s_isr_changed = 0;
+    s_isr_pending = false;
+    record_transition_locked(state ^ changed, state, &src);
+    portEXIT_CRITICAL(&s_lock);
+    notify_change(state ^ changed, state);
+}
+
+bool IRAM_ATTR gpio_hal_set_isr(size_t idx, bool on)
+{
+    if (idx >= GPIO_HAL_CHANNEL_COUNT) return false;
+    uint64_t bit = 1ULL << idx;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    if (s_claimed & bit) {
+        portEXIT_CRITICAL_SAFE(&s_lock);
+        return false;
+    }
+    gpio_backend_set_level(s_channels[idx].pin, level_of(&s_channels[idx], on));
+    uint64_t old = s_state;
+    s_state = on ? (old | bit) : (old & ~bit);
+    if (s_state != old) {
+        s_version++;
+        s_isr_changed ^= bit;
+        if (!s_isr_pending) {
+            s_isr_pending = true;
+            esp_timer_start_once(s_isr_timer, 0);
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+    return true;
+}
+
+uint64_t gpio_hal_get_mask(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint64_t v = s_state;
+    portEXIT_CRITICAL(&s_lock);
+    return v;
+}
+
+void gpio_hal_write_mask(uint64_t mask, uint64_t values)
+{
+    gpio_hal_write_mask_src(mask, values, NULL);
+}
+
+void gpio_hal_write_mask_src(uint64_t mask, uint64_t values, const gpio_hal_src_t *src)
+{
+    mask &= ALL_MASK;
+
+    // pin writes and the shadow state change together
+    portENTER_CRITICAL(&s_lock);
+    mask &= ~s_claimed;
+    for (size_t i = 0; i < GPIO_HAL_CHANNEL_COUNT; i++) {
+        if (!((mask >> i) & 1ULL)) continue;
+        gpio_backend_set_level(s_channels[i].pin, level_of(&s_channels[i], (values >> i) & 1ULL));
+    }
+    uint64_t old = s_state;
+    s_state = (s_state & ~mask) | (values & mask);
+    uint64_t state = s_state;
+    if (state != old) s_version++;
+    record_transition_locked(old, state, src);
+    portEXIT_CRITICAL(&s_lock);
+    notify_change(old, state);
+}
+
+void gpio_hal_compile(uint64_t mask, uint64_t values, gpio_hal_compiled_t *out)
+{
+    mask &= ALL_MASK;
+    memset(out, 0, sizeof(*out));
+    out->mask = mask;
+    out->values = values & mask;
+
+    for (size_t i = 0; i < GPIO_HAL_CHANNEL_COUNT; i++) {
+        if (!((mask >> i) & 1ULL)) continue;
+        const gpio_hal_channel_t *ch = &s_channels[i];
+        uint32_t bit = 1u << (ch->pin & 31);
+        if (level_of(ch, (values >> i) & 1ULL)) {
+            out->set[ch->pin >> 5] |= bit;
+        } else {
+            out->clr[ch->pin >> 5] |= bit;
+        }
+    }
+}
+
+void gpio_hal_apply(const gpio_hal_compiled_t *c)
+{
+    gpio_hal_apply_src(c, NULL);
+}
+
+void gpio_hal_apply_src(const gpio_hal_compiled_t *c, const gpio_hal_src_t *src)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    gpio_hal_write_mask_src(c->mask, c->values, src);
+#else
+    portENTER_CRITICAL(&s_lock);
+    if (c->mask & s_claimed) {
+        // precompiled masks cannot drop claimed pins, the per-pin path skips them
+        portEXIT_CRITICAL(&s_lock);
+        gpio_hal_write_mask_src(c->mask, c->values, src);
+        return;
+    }
+    REG_WRITE(GPIO_OUT_W1TC_REG, c->clr[0]);
+    REG_WRITE(GPIO_OUT_W1TS_REG, c->set[0]);
+#if SOC_GPIO_PIN_COUNT > 32
+    if (c->clr[1] | c->set[1]) {
+        REG_WRITE(GPIO_OUT1_W1TC_REG, c->clr[1]);
+        REG_WRITE(GPIO_OUT1_W1TS_REG, c->set[1]);
+    }
+#endif
+    uint64_t old = s_state;
+    s_state = (s_state & ~c->mask) | c->values;
+    uint64_t state = s_state;
+    if (state != old) s_version++;
+    record_transition_locked(old, state, src);
+    portEXIT_CRITICAL(&s_lock);
+    notify_change(old, state);
+#endif
+}
+
+/* ====== Handlers: /api/out ====== */
+
+static bool parse_hex_mask(const char *s, uint64_t *out)
+{
+    // strtoull alone would accept leading blanks and a sign, and saturates on overflow
+    if (!s || !isxdigit((unsigned char)*s)) return false;
+
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 16);
+    if (*end != '\0' || errno == ERANGE) return false;
+    *out = v;
+    return true;
+}
+
+static esp_err_t channel_get_handler(httpd_req_t *req)
+{
+    const gpio_hal_channel_t *ch = (const gpio_hal_channel_t *)req->user_ctx;
+    size_t idx = (size_t)(ch - s_channels);
+
+    char *query = http_hal_scratch_query(req);
+    char *state_str = query ? http_hal_scratch_query_value(req, query, "state") : NULL;
+    if (!state_str && http_hal_etag_check(req, gpio_hal_get_version())) {
+        return http_hal_send_not_modified(req);
+    }
+    if (state_str) {
+        int on;
+        if (!http_hal_parse_bool(state_str, &on)) {
+            return http_hal_send_err(req, 400, "Invalid state (use on/off/true/false)");
+        }
+        gpio_hal_src_t src = { GPIO_HAL_SRC_OUT, http_hal_peer_ipv4(req) };
+        if (gpio_hal_set_src(idx, on, &src) == ESP_ERR_INVALID_STATE) {
+            return http_hal_send_err(req, 409, "Channel driven by PWM or RMT");
+        }
+    }
+
+    bool on = gpio_hal_get(idx);
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"name\":\"%s\",\"bit\":%u,\"on\":%s,\"gpio_level\":%u}",
+             ch->name, (unsigned)idx, on ? "true" : "false", (unsigned)level_of(ch, on));
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+static esp_err_t mask_reply(httpd_req_t *req)
+{
+    // mask and version read together, so a long-poll client never resumes from a stale pair
+    uint32_t version;
+    uint64_t mask = gpio_hal_snapshot(&version);
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"count\":%d,\"mask\":\"%llx\",\"version\":%lu}",
+             GPIO_HAL_CHANNEL_COUNT, (unsigned long long)mask, (unsigned long)version);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+static esp_err_t mask_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    if (!query && http_hal_etag_check(req, gpio_hal_get_version())) {
+        return http_hal_send_not_modified(req);
+    }
+
+    // long poll: ?wait=<ms>&since=<version> replies once the state moves past since (read only)
+    char *wait_str = query ? http_hal_scratch_query_value(req, query, "wait") : NULL;
+    if (wait_str) {
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        int64_t wait_ms, since = gpio_hal_get_version();
+        if (!http_hal_parse_int(wait_str, 0, HTTP_HAL_LONGPOLL_MAX_MS, &wait_ms)) {
+            return http_hal_send_err(req, 400, "Invalid wait (ms)");
+        }
+        if (since_str && !http_hal_parse_int(since_str, 0, UINT32_MAX, &since)) {
+            return http_hal_send_err(req, 400, "Invalid since");
+        }
+        return http_hal_longpoll(req, (uint32_t)since, (uint32_t)wait_ms, gpio_hal_get_version, mask_reply);
+    }
+
+    if (query) {
+        char *set_str = http_hal_scratch_query_value(req, query, "set");
+        char *clear_str = http_hal_scratch_query_value(req, query, "clear");
+        uint64_t set = 0, clear = 0;
+
+        if (set_str && !parse_hex_mask(set_str, &set)) {
+            return http_hal_send_err(req, 400, "Invalid set mask (hex)");
+        }
+        if (clear_str && !parse_hex_mask(clear_str, &clear)) {
+            return http_hal_send_err(req, 400, "Invalid clear mask (hex)");
+        }
+        if ((set | clear) & ~ALL_MASK) {
+            return http_hal_send_err(req, 400, "Mask selects unknown channels");
+        }
+        // clear first, so a bit in both masks ends up set
+        gpio_hal_compiled_t c;
+        gpio_hal_src_t src = { GPIO_HAL_SRC_OUT, http_hal_peer_ipv4(req) };
+        gpio_hal_compile(clear | set, set, &c);
+        gpio_hal_apply_src(&c, &src);
+    }
+    return mask_reply(req);
+}
+
+/* ====== JSON-RPC methods ====== */
+
+static esp_err_t mask_result(http_hal_rpc_call_t *call)
+{
+    uint32_t version;
+    uint64_t state = gpio_hal_snapshot(&version);
+    return http_hal_rpc_result(call, "{\"count\":%d,\"mask\":\"%llx\",\"version\":%lu}",
+                               GPIO_HAL_CHANNEL_COUNT, (unsigned long long)state, (unsigned long)version);
+}
+
+// out.get {name?}: one channel, or all of them as a mask
+static esp_err_t rpc_out_get(http_hal_rpc_call_t *call, void *ctx)
+{
+    if (!http_hal_rpc_has_param(call, "name")) {
+        return mask_result(call);
+    }
+    int idx = gpio_hal_find(http_hal_rpc_param_str(call, "name"));
+    if (idx < 0) {
+        return http_hal_rpc_error(call, HTTP_HAL_RPC_INVALID_PARAMS, "Unknown channel");
+    }
+    uint32_t version;
+    uint64_t state = gpio_hal_snapshot(&version);
+    return http_hal_rpc_result(call, "{\"name\":\"%s\",\"on\":%s,\"version\":%lu}", s_channels[idx].name,
+                               ((state >> idx) & 1ULL) ? "true" : "false", (unsigned long)version);
+}
+
+// out.set {name, on} or {set, clear} (hex masks, as /api/out)
+static esp_err_t rpc_out_set(http_hal_rpc_call_t *call, void *ctx)
+{
+    uint64_t set = 0, clear = 0;
+
+    if (http_hal_rpc_has_param(call, "name")) {
+        int idx = gpio_hal_find(http_hal_rpc_param_str(call, "name"));
+        int on;
+        if (idx < 0) {
+            return http_hal_rpc_error(call, HTTP_HAL_RPC_INVALID_PARAMS, "Unknown channel");
+        }
+        if (!http_hal_rpc_param_bool(call, "on", &on)) {
+            return http_hal_rpc_error(call, HTTP_HAL_RPC_INVALID_PARAMS, "Invalid on (true/false)");
+        }
+        if (gpio_hal_is_claimed((size_t)idx)) {
+            return http_hal_rpc_error(call, HTTP_HAL_RPC_SERVER_ERROR, "Channel driven by PWM or RMT");
+        }
+        *(on ? &set : &clear) = 1ULL << idx;
+    } else {
+        const char *set_str = http_hal_rpc_param_str(call, "set");
+        const char *clear_str = http_hal_rpc_param_str(call, "clear");
+        if ((set_str && !parse_hex_mask(set_str, &set)) || (clear_str && !parse_hex_mask(clear_str, &clear))) {
+            return http_hal_rpc_error(call, HTTP_HAL_RPC_INVALID_PARAMS, "Invalid mask (hex string)");
+        }
+        if ((set | clear) & ~ALL_MASK) {
+            return http_hal_rpc_error(call, HTTP_HAL_RPC_INVALID_PARAMS, "Mask selects unknown channels");
+        }
+    }
+
+    gpio_hal_compiled_t c;
+    gpio_hal_src_t src = { GPIO_HAL_SRC_RPC, http_hal_peer_ipv4(http_hal_rpc_req(call)) };
+    gpio_hal_compile(clear | set, set, &c);
+    gpio_hal_apply_src(&c, &src);
+    return mask_result(call);
+}
+
+esp_err_t gpio_hal_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/out",
+        .method = HTTP_GET,
+        .handler = mask_get_handler,
+        .user_ctx = NULL
+    };
+    ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &ep), TAG, "register /api/out failed");
+
+    // one route per channel, the descriptor is the handler context
+    for (size_t i = 0; i < GPIO_HAL_CHANNEL_COUNT; i++) {
+        http_hal_endpoint_t ch_ep = {
+            .uri = s_channels[i].uri,
+            .method = HTTP_GET,
+            .handler = channel_get_handler,
+            .user_ctx = (void *)&s_channels[i]
+        };
+        ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &ch_ep), TAG, "register %s failed", s_channels[i].uri);
+    }
+
+    ESP_RETURN_ON_ERROR(http_hal_rpc_register_method(h, "out.get", rpc_out_get, NULL), TAG, "register out.get failed");
+    return http_hal_rpc_register_method(h, "out.set", rpc_out_set, NULL);
+}
@@ -0,0 +1,301 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_hal.h
+ * @brief Output channel registry
+ * Output channels (name, pin, polarity, default state) are configured at build
+ * time with CONFIG_GPIO_OUT_CHANNELS and compiled into a const table
+ * (gpio_hal_channels.h, generated by gpio_hal_channels.cmake). Channels are
+ * addressed by index or name and their logical states are kept in a bitmask,
+ * bit i being channel i, so all of them can be read or written at once.
+ * Channel 0 is the LED driven by /api/led.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "http_hal.h"
+#include "gpio_hal_channels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Output channel descriptor
+ */
+typedef struct {
+    const char *name;
+    const char *uri;        // "/api/out/<name>"
+    gpio_num_t  pin;
+    bool        active_low;
+    bool        default_on; // logical state applied by gpio_hal_init()
+} gpio_hal_channel_t;
+
+#define GPIO_HAL_CHANGE_CBS 4
+
+/**
+ * @brief Called after every change of the channel state (outside any lock)
+ */
+typedef void (*gpio_hal_change_cb_t)(void *arg);
+
+/**
+ * @brief Origin of a write, recorded by the transition hook
+ */
+typedef enum {
+    GPIO_HAL_SRC_LOCAL,     // firmware, no client request
+    GPIO_HAL_SRC_LED,       // /api/led
+    GPIO_HAL_SRC_OUT,       // /api/out and /api/out/<name>
+    GPIO_HAL_SRC_SCENE,     // scene applied
+    GPIO_HAL_SRC_RPC,       // JSON-RPC out.set
+    GPIO_HAL_SRC_SCHED,     // scheduled command (gpio_sched)
+} gpio_hal_src_kind_t;
+
+typedef struct {
+    gpio_hal_src_kind_t kind;
+    uint32_t            peer;   // IPv4 address of the HTTP client (network order), 0 if none
+} gpio_hal_src_t;
+
+/**
+ * @brief Called for a write that changed at least one channel
+ *
+ * Runs inside the gpio_hal critical section, so transitions are seen in the
+ * order they were applied: keep it short, it must not block or call gpio_hal.
+ *
+ * @param[in] changed Channels whose state flipped
+ * @param[in] state   State of all channels after the write
+ * @param[in] src     Origin of the write, never NULL
+ */
+typedef void (*gpio_hal_transition_cb_t)(uint64_t changed, uint64_t state, const gpio_hal_src_t *src);
+
+/**
+ * @brief Configure all channels as outputs and apply their default state
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_hal_init(void);
+
+/**
+ * @brief Like gpio_hal_init(), with an initial state overriding the defaults
+ *
+ * Used to restore a saved state at boot. Levels are set before the pins are
+ * switched to output.
+ *
+ * @param[in] values Logical states
+ * @param[in] valid  Channels taken from values, the others use their default
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_hal_init_state(uint64_t values, uint64_t valid);
+
+/**
+ * @brief Number of channels in the registry
+ */
+size_t gpio_hal_channel_count(void);
+
+/**
+ * @brief Get a channel descriptor
+ *
+ * @param[in] idx Channel index
+ * @return Descriptor, or NULL if idx is out of range
+ */
+const gpio_hal_channel_t *gpio_hal_channel(size_t idx);
+
+/**
+ * @brief Look up a channel by name
+ *
+ * @param[in] name Channel name
+ * @return Channel index, or -1 if not found
+ */
+int gpio_hal_find(const char *name);
+
+/**
+ * @brief Masked write precomputed in the pin domain (see gpio_hal_compile())
+ */
+typedef struct {
+    uint64_t mask;          // channels changed
+    uint64_t values;        // their logical states
+    uint32_t set[2];        // pins driven high, GPIO 0..31 and 32..63
+    uint32_t clr[2];        // pins driven low
+} gpio_hal_compiled_t;
+
+/**
+ * @brief Set the logical state of a channel (polarity is applied)
+ *
+ * @param[in] idx Channel index
+ * @param[in] on  Logical state
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if idx is out of range,
+ *         ESP_ERR_INVALID_STATE if the channel is claimed (gpio_hal_claim())
+ */
+esp_err_t gpio_hal_set(size_t idx, bool on);
+
+/**
+ * @brief Like gpio_hal_set(), recording the origin of the write
+ *
+ * @param[in] src Origin, NULL for GPIO_HAL_SRC_LOCAL
+ */
+esp_err_t gpio_hal_set_src(size_t idx, bool on, const gpio_hal_src_t *src);
+
+/**
+ * @brief Hand a channel's pin to a peripheral (LEDC, RMT)
+ *
+ * Until gpio_hal_release() writes to the channel are refused:
+ * gpio_hal_set() returns ESP_ERR_INVALID_STATE, mask writes leave it out.
+ * Its state keeps the last value written through gpio_hal.
+ *
+ * @param[in] idx Channel index
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_hal_claim(size_t idx);
+
+/**
+ * @brief Take a claimed pin back as plain output at the channel state
+ *
+ * Call after the peripheral has let go of the pin.
+ *
+ * @param[in] idx Channel index
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_hal_release(size_t idx);
+
+/**
+ * @brief Whether a channel is claimed by a peripheral
+ */
+bool gpio_hal_is_claimed(size_t idx);
+
+/**
+ * @brief Set one channel from an ISR or a critical section
+ *
+ * Pin, state and version change together as with gpio_hal_set(). The change
+ * and transition callbacks cannot run here: they are called shortly after
+ * from the esp_timer task, with source GPIO_HAL_SRC_SCHED. Placed in IRAM.
+ *
+ * @param[in] idx Channel index (ignored if out of range)
+ * @param[in] on  Logical state
+ * @return false if the channel is out of range or claimed, so nothing was written
+ */
+bool gpio_hal_set_isr(size_t idx, bool on);
+
+/**
+ * @brief Get the logical state of a channel
+ */
+bool gpio_hal_get(size_t idx);
+
+/**
+ * @brief Get the logical state of all channels, bit i = channel i
+ */
+uint64_t gpio_hal_get_mask(void);
+
+/**
+ * @brief State version, incremented on every write through gpio_hal that
+ *        changes the state
+ */
+uint32_t gpio_hal_get_version(void);
+
+/**
+ * @brief Get the logical state of all channels and its version atomically
+ *
+ * @param[out] version Version matching the returned state
+ * @return Bit i = channel i
+ */
+uint64_t gpio_hal_snapshot(uint32_t *version);
+
+/**
+ * @brief Add a state change callback (at most GPIO_HAL_CHANGE_CBS, never removed)
+ *
+ * @param[in] cb  Callback, must not block
+ * @param[in] arg Callback argument
+ * @return ESP_OK on success, ESP_ERR_NO_MEM when all slots are taken
+ */
+esp_err_t gpio_hal_add_change_cb(gpio_hal_change_cb_t cb, void *arg);
+
+/**
+ * @brief Install the transition hook (one per system, NULL removes it)
+ *
+ * @param[in] cb Hook, called in a critical section (see gpio_hal_transition_cb_t)
+ */
+void gpio_hal_set_transition_cb(gpio_hal_transition_cb_t cb);
+
+/**
+ * @brief Update the channels selected by mask to the matching bits of values
+ *
+ * @param[in] mask   Channels to change
+ * @param[in] values Logical states
+ */
+void gpio_hal_write_mask(uint64_t mask, uint64_t values);
+
+/**
+ * @brief Like gpio_hal_write_mask(), recording the origin of the write
+ *
+ * @param[in] src Origin, NULL for GPIO_HAL_SRC_LOCAL
+ */
+void gpio_hal_write_mask_src(uint64_t mask, uint64_t values, const gpio_hal_src_t *src);
+
+/**
+ * @brief Precompute a masked write
+ *
+ * Polarity and channel-to-pin mapping are resolved once, so applying the
+ * result is a pair of register stores per GPIO bank.
+ *
+ * @param[in]  mask   Channels to change
+ * @param[in]  values Logical states
+ * @param[out] out    Compiled write
+ */
+void gpio_hal_compile(uint64_t mask, uint64_t values, gpio_hal_compiled_t *out);
+
+/**
+ * @brief Apply a write prepared by gpio_hal_compile()
+ *
+ * On chip targets all affected pins are written with W1TC/W1TS stores; the
+ * simulated backend falls back to per-pin writes.
+ *
+ * @param[in] c Compiled write
+ */
+void gpio_hal_apply(const gpio_hal_compiled_t *c);
+
+/**
+ * @brief Like gpio_hal_apply(), recording the origin of the write
+ *
+ * @param[in] src Origin, NULL for GPIO_HAL_SRC_LOCAL
+ */
+void gpio_hal_apply_src(const gpio_hal_compiled_t *c, const gpio_hal_src_t *src);
+
+/**
+ * @brief Register the output channel endpoints
+ *
+ * - GET /api/out/<name>?state=on/off/true/false for each channel; without
+ *   parameters it reports the channel state
+ * - GET /api/out?set=<hex>&clear=<hex> sets/clears channels by bitmask and
+ *   returns the state of all channels as a hex mask
+ * - GET /api/out?wait=<ms>&since=<version> long poll: replies once the state
+ *   version moves past since (default: current) or after wait ms
+ * - JSON-RPC methods out.get {name?} and out.set {name, on} or
+ *   {set: "<hex>", clear: "<hex>"}
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_hal_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
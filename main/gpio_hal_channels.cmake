@@ -0,0 +1,77 @@
+# Generates gpio_hal_channels.h from CONFIG_GPIO_OUT_CHANNELS.
+#
+# The option is a comma separated list of name:pin:polarity:default entries,
+# e.g. "led:18:high:off,relay1:19:low:off". An empty list falls back to a
+# single "led" channel on CONFIG_GPIO_OUT_PIN.
+function(gpio_hal_generate_channels out_file)
+    set(spec "${CONFIG_GPIO_OUT_CHANNELS}")
+    if(spec STREQUAL "")
+        set(spec "led:${CONFIG_GPIO_OUT_PIN}:high:off")
+    endif()
+
+    string(REPLACE "," ";" entries "${spec}")
+    set(count 0)
+    set(names "")
+    set(body "")
+    foreach(entry IN LISTS entries)
+        string(STRIP "${entry}" entry)
+        string(REPLACE ":" ";" fields "${entry}")
+        list(LENGTH fields nfields)
+        if(NOT nfields EQUAL 4)
+            message(FATAL_ERROR "GPIO_OUT_CHANNELS: '${entry}' is not name:pin:polarity:default")
+        endif()
+        list(GET fields 0 name)
+        list(GET fields 1 pin)
+        list(GET fields 2 polarity)
+        list(GET fields 3 default)
+
+        if(NOT name MATCHES "^[a-z0-9_]+$")
+            message(FATAL_ERROR "GPIO_OUT_CHANNELS: bad name '${name}' (use a-z, 0-9, _)")
+        endif()
+        if(name IN_LIST names)
+            message(FATAL_ERROR "GPIO_OUT_CHANNELS: duplicate name '${name}'")
+        endif()
+        if(NOT pin MATCHES "^[0-9]+$" OR pin GREATER 63)
+            message(FATAL_ERROR "GPIO_OUT_CHANNELS: bad pin '${pin}' for '${name}'")
+        endif()
+        if(polarity STREQUAL "low")
+            set(active_low true)
+        elseif(polarity STREQUAL "high")
+            set(active_low false)
+        else()
+            message(FATAL_ERROR "GPIO_OUT_CHANNELS: polarity of '${name}' must be low or high")
+        endif()
+        if(default STREQUAL "on")
+            set(default_on true)
+        elseif(default STREQUAL "off")
+            set(default_on false)
+        else()
+            message(FATAL_ERROR "GPIO_OUT_CHANNELS: default of '${name}' must be on or off")
+        endif()
+
+        if(count EQUAL 0)
+            set(first_pin ${pin})
+            set(first_low ${active_low})
+        endif()
+        list(APPEND names ${name})
+        string(APPEND body "    { .name = \"${name}\", .uri = \"/api/out/${name}\", .pin = ${pin}, "
+                           ".active_low = ${active_low}, .default_on = ${default_on} }, \\\n")
+        math(EXPR count "${count} + 1")
+    endforeach()
+
+    if(count GREATER 64)
+        message(FATAL_ERROR "GPIO_OUT_CHANNELS: at most 64 channels")
+    endif()
+
+    set(content "/* Generated from CONFIG_GPIO_OUT_CHANNELS by gpio_hal_channels.cmake, do not edit */\n"
+                "#pragma once\n\n"
+                "#define GPIO_HAL_CHANNEL_COUNT ${count}\n"
+                "#define GPIO_HAL_CH0_PIN ${first_pin}\n"
+                "#define GPIO_HAL_CH0_ACTIVE_LOW ${first_low}\n\n"
+                "#define GPIO_HAL_CHANNELS_INIT \\\n${body}\n")
+    string(JOIN "" content ${content})
+
+    # only touch the header when the table changes, so rebuilds stay incremental
+    file(WRITE "${out_file}.tmp" "${content}")
+    configure_file("${out_file}.tmp" "${out_file}" COPYONLY)
+endfunction()
@@ -0,0 +1,278 @@
+#include "gpio_sched.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_hal.h"
+
+static const char *TAG = "GPIO_SCHED";
+
+#define QUEUE_LEN   CONFIG_GPIO_SCHED_QUEUE_LEN
+#define SPIN_US     CONFIG_GPIO_SCHED_SPIN_US
+
+/*
+ * The timer callback runs in ISR context when the target supports it, which
+ * removes the esp_timer task scheduling jitter. That requires the GPIO control
+ * functions in IRAM. Writes go through gpio_hal_set_isr(), so the output state,
+ * its version and the change hooks follow scheduled commands too.
+ */
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_GPIO_CTRL_FUNC_IN_IRAM
+#define SCHED_DISPATCH  ESP_TIMER_ISR
+#define SCHED_ATTR      IRAM_ATTR
+#else
+#define SCHED_DISPATCH  ESP_TIMER_TASK
+#define SCHED_ATTR
+#endif
+
+typedef struct {
+    int64_t     at_us;
+    uint32_t    id;
+    uint8_t     channel;
+    uint8_t     on;
+} sched_cmd_t;
+
+// binary min-heap ordered by at_us
+static DRAM_ATTR sched_cmd_t s_heap[QUEUE_LEN];
+static size_t s_heap_len;
+static uint32_t s_next_id = 1;
+static gpio_sched_stats_t s_stats;
+
+static esp_timer_handle_t s_timer;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// endpoint configuration
+static size_t s_ep_channel;
+
+/* ====== Heap ====== */
+
+static SCHED_ATTR void heap_swap(size_t a, size_t b)
+{
+    sched_cmd_t t = s_heap[a];
+    s_heap[a] = s_heap[b];
+    s_heap[b] = t;
+}
+
+static void heap_push(const sched_cmd_t *c)
+{
+    size_t i = s_heap_len++;
+    s_heap[i] = *c;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (s_heap[parent].at_us <= s_heap[i].at_us) break;
+        heap_swap(parent, i);
+        i = parent;
+    }
+}
+
+static SCHED_ATTR void heap_pop(void)
+{
+    s_heap[0] = s_heap[--s_heap_len];
+    size_t i = 0;
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < s_heap_len && s_heap[l].at_us < s_heap[m].at_us) m = l;
+        if (r < s_heap_len && s_heap[r].at_us < s_heap[m].at_us) m = r;
+        if (m == i) break;
+        heap_swap(i, m);
+        i = m;
+    }
+}
+
+/* ====== Timer ====== */
+
+static SCHED_ATTR void arm_locked(int64_t now)
+{
+    // wake up a little early and spin the remaining microseconds
+    esp_timer_stop(s_timer);
+    if (s_heap_len == 0) return;
+
+    int64_t delta = s_heap[0].at_us - now - SPIN_US;
+    esp_timer_start_once(s_timer, delta > 0 ? (uint64_t)delta : 0);
+}
+
+static SCHED_ATTR void sched_timer_cb(void *arg)
+{
+    (void)arg;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    int64_t now = esp_timer_get_time();
+    bool due = s_heap_len > 0 && s_heap[0].at_us <= now + SPIN_US;
+    int64_t at = due ? s_heap[0].at_us : 0;
+    if (!due) arm_locked(now);
+    portEXIT_CRITICAL_SAFE(&s_lock);
+    if (!due) return;
+
+    // spin outside the lock so interrupts stay enabled
+    while (esp_timer_get_time() < at) {
+    }
+
+    // one command per wake-up: the next one re-arms the timer, at once if it is due
+    portENTER_CRITICAL_SAFE(&s_lock);
+    now = esp_timer_get_time();
+    // an enqueue or clear may have changed the head meanwhile, fire it only if due
+    if (s_heap_len > 0 && s_heap[0].at_us <= now) {
+        sched_cmd_t c = s_heap[0];
+        heap_pop();
+        if (gpio_hal_set_isr(c.channel, c.on)) {
+            int64_t late = now - c.at_us;
+            if (late > s_stats.max_late_us) s_stats.max_late_us = late;
+            s_stats.fired++;
+        } else {
+            s_stats.skipped++;
+        }
+    }
+    arm_locked(now);
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+/* ====== API ====== */
+
+esp_err_t gpio_sched_init(void)
+{
+    if (s_timer) return ESP_OK;
+
+    const esp_timer_create_args_t args = {
+        .callback = sched_timer_cb,
+        .arg = NULL,
+        .dispatch_method = SCHED_DISPATCH,
+        .name = "gpio_sched",
+        .skip_unhandled_events = false
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "esp_timer_create failed");
+
+    LOG_GPIO("Scheduler ready: %d slots, %s dispatch", QUEUE_LEN,
+             SCHED_DISPATCH == ESP_TIMER_ISR ? "ISR" : "task");
+    return ESP_OK;
+}
+
+esp_err_t gpio_sched_enqueue(int64_t at_us, size_t channel, bool on, uint32_t *out_id)
+{
+    ESP_RETURN_ON_FALSE(s_timer, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(channel < gpio_hal_channel_count(), ESP_ERR_INVALID_ARG, TAG, "bad channel");
+
+    esp_err_t err = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    if (s_heap_len >= QUEUE_LEN) {
+        s_stats.dropped++;
+        err = ESP_ERR_NO_MEM;
+    } else {
+        sched_cmd_t c = {
+            .at_us = at_us,
+            .id = s_next_id++,
+            .channel = (uint8_t)channel,
+            .on = on ? 1 : 0
+        };
+        heap_push(&c);
+        if (out_id) *out_id = c.id;
+        // only a new earliest command changes the timer deadline
+        if (s_heap[0].id == c.id) arm_locked(esp_timer_get_time());
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+void gpio_sched_clear(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_heap_len = 0;
+    esp_timer_stop(s_timer);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void gpio_sched_get_stats(gpio_sched_stats_t *out)
+{
+    if (!out) return;
+
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->pending = s_heap_len;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* ====== Handler: GET /api/led/schedule ====== */
+
+static esp_err_t schedule_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    int64_t now = esp_timer_get_time();
+    uint32_t id = 0;
+    int64_t at = 0;
+
+    if (query) {
+        char *clear = http_hal_scratch_query_value(req, query, "clear");
+        int do_clear = 0;
+        if (clear && http_hal_parse_bool(clear, &do_clear) && do_clear) {
+            gpio_sched_clear();
+        }
+
+        // as on /api/led: level is the pin level, state the logical one
+        int on = -1;
+        char *level_str = http_hal_scratch_query_value(req, query, "level");
+        char *state_str = http_hal_scratch_query_value(req, query, "state");
+        if (level_str) {
+            if (!http_hal_parse_bool(level_str, &on)) {
+                return http_hal_send_err(req, 400, "Invalid level (use 0 or 1)");
+            }
+            if (gpio_hal_channel(s_ep_channel)->active_low) on = !on;
+        } else if (state_str) {
+            if (!http_hal_parse_bool(state_str, &on)) {
+                return http_hal_send_err(req, 400, "Invalid state (use on/off/true/false)");
+            }
+        }
+
+        if (on >= 0) {
+            char *at_str = http_hal_scratch_query_value(req, query, "at");
+            char *in_str = http_hal_scratch_query_value(req, query, "in");
+            int64_t v;
+            if (at_str) {
+                if (!http_hal_parse_int(at_str, 0, INT64_MAX, &v)) {
+                    return http_hal_send_err(req, 400, "Invalid at (microseconds)");
+                }
+                at = v;
+            } else if (in_str) {
+                if (!http_hal_parse_int(in_str, 0, INT32_MAX, &v)) {
+                    return http_hal_send_err(req, 400, "Invalid in (microseconds)");
+                }
+                at = now + v;
+            } else {
+                return http_hal_send_err(req, 400, "Missing at or in");
+            }
+
+            if (gpio_sched_enqueue(at, s_ep_channel, on, &id) != ESP_OK) {
+                return http_hal_send_err(req, 503, "Schedule queue full");
+            }
+        }
+    }
+
+    gpio_sched_stats_t st;
+    gpio_sched_get_stats(&st);
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"id\":%u,\"at_us\":%lld,\"now_us\":%lld,\"pending\":%u,"
+             "\"fired\":%u,\"skipped\":%u,\"dropped\":%u,\"max_late_us\":%lld}",
+             (unsigned)id, (long long)at, (long long)now, (unsigned)st.pending,
+             (unsigned)st.fired, (unsigned)st.skipped, (unsigned)st.dropped, (long long)st.max_late_us);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+esp_err_t gpio_sched_register_endpoints(http_hal_t *h, size_t channel)
+{
+    ESP_RETURN_ON_FALSE(gpio_hal_channel(channel), ESP_ERR_INVALID_ARG, TAG, "bad channel");
+    s_ep_channel = channel;
+
+    http_hal_endpoint_t ep = {
+        .uri = "/api/led/schedule",
+        .method = HTTP_GET,
+        .handler = schedule_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file gpio_sched.h
+ * @brief Timer-driven GPIO command queue
+ * This module lets clients pre-load GPIO level changes with a target timestamp.
+ * Commands are kept in a time-ordered queue and applied by an esp_timer callback,
+ * so output timing no longer depends on network latency.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Scheduler statistics
+ */
+typedef struct {
+    size_t   pending;       // commands waiting in the queue
+    uint32_t fired;         // commands applied since init
+    uint32_t skipped;       // commands not applied because PWM or RMT held the channel
+    uint32_t dropped;       // commands rejected because the queue was full
+    int64_t  max_late_us;   // worst delay between target time and pin write
+} gpio_sched_stats_t;
+
+/**
+ * @brief Initialize the scheduler (creates the esp_timer)
+ *
+ * Timestamps use the esp_timer_get_time() time base (microseconds since boot).
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_sched_init(void);
+
+/**
+ * @brief Queue a state change of a gpio_hal output channel
+ *
+ * The change is applied with gpio_hal_set_isr(), so it updates the output
+ * state and version like any other write. Commands whose target time is
+ * already in the past are applied as soon as possible.
+ *
+ * @param[in]  at_us   Target time in microseconds (esp_timer_get_time() base)
+ * @param[in]  channel gpio_hal channel index
+ * @param[in]  on      Logical state
+ * @param[out] out_id  Optional command id
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t gpio_sched_enqueue(int64_t at_us, size_t channel, bool on, uint32_t *out_id);
+
+/**
+ * @brief Drop all pending commands
+ */
+void gpio_sched_clear(void);
+
+/**
+ * @brief Get scheduler statistics
+ *
+ * @param[out] out Returned statistics
+ */
+void gpio_sched_get_stats(gpio_sched_stats_t *out);
+
+/**
+ * @brief Register the GET /api/led/schedule endpoint
+ *
+ * Query parameters:
+ * - state=on/off/true/false (logical) or level=0|1 (pin level), as on /api/led
+ * - at=<us> absolute target time, or in=<us> relative to now
+ * - clear=1 drops all pending commands
+ * Without a level/state the endpoint only reports the device clock and queue
+ * state, which clients use to align their timestamps.
+ *
+ * @param[in] h       HAL instance
+ * @param[in] channel gpio_hal channel driven by the endpoint
+ * @return ESP_OK on success
+ */
+esp_err_t gpio_sched_register_endpoints(http_hal_t *h, size_t channel);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,11 +2,116 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+#include <errno.h>
+#include "esp_attr.h"
+#endif
 
 static const char *TAG = "HTTP_HAL";
 
+#define SCRATCH_ALIGN 8
+#define READER_SLOTS        8
+#define LONGPOLL_MAX        CONFIG_HTTP_HAL_LONGPOLL_MAX
+#define LONGPOLL_PRIO       5
+#define LONGPOLL_STACK      3072    // only runs respond handlers, no httpd call chain below them
+#define LONGPOLL_STOP_MS    1000
+#define DETACH_STOP_MS      1000
+
+// methods served by the catch-all dispatcher registered in esp_http_server
+static const httpd_method_t s_dispatch_methods[] = {
+    HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_DELETE, HTTP_PATCH
+};
+#define DISPATCH_METHODS (sizeof(s_dispatch_methods) / sizeof(s_dispatch_methods[0]))
+
+/**
+ * Per-connection session context taken from the pool.
+ * The scratch arena is a bump-pointer allocator reset after every request.
+ */
+typedef struct http_hal_session_s {
+    http_hal_t                  *owner;
+    struct http_hal_session_s   *next_free;
+    uint8_t                     *arena;
+    size_t                       arena_used;
+    size_t                       arena_peak;
+    bool                         detached;      // request handed to another task, which resets the arena
+} http_hal_session_t;
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+#define ALLOC_SLOTS CONFIG_HTTP_HAL_ALLOC_SLOTS
+
+/**
+ * Allocation counters of one (uri, method), kept outside the route snapshots:
+ * snapshots are immutable and may be retired while a request still counts.
+ * Slots are claimed under write_lock and never released.
+ */
+typedef struct {
+    const char     *uri;
+    httpd_method_t  method;
+    atomic_uint     requests;
+    atomic_uint     alloc_requests;
+    atomic_uint     allocs;
+    atomic_uint     frees;
+    atomic_uint     bytes;
+    atomic_uint     last_allocs;
+    atomic_uint     last_bytes;
+} http_hal_alloc_slot_t;
+#endif
+
+/**
+ * Registered endpoint. The user handler is invoked through dispatch_handler().
+ */
+typedef struct {
+    const char         *uri;
+    httpd_method_t      method;
+    http_hal_handler_t  handler;
+    void               *user_ctx;
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    http_hal_alloc_slot_t *alloc;   // NULL if the slot table was full
+#endif
+} http_hal_route_t;
+
+/**
+ * Immutable route table snapshot.
+ * A new snapshot is built and published on every change; readers never lock.
+ */
+typedef struct http_hal_table_s {
+    http_hal_t                 *owner;
+    struct http_hal_table_s    *next_retired;
+    uint32_t                    retired_epoch;
+    size_t                      len;
+    http_hal_route_t           *routes;
+} http_hal_table_t;
+
+/**
+ * Parked long-poll request. The parker fills a FREE slot it reserved and
+ * publishes it as PARKED; only the long-poll task frees it again.
+ */
+typedef enum { WAITER_FREE, WAITER_RESERVED, WAITER_PARKED } http_hal_waiter_state_t;
+
+typedef struct {
+    http_hal_waiter_state_t state;
+    httpd_req_t            *req;            // async copy owned by the slot
+    http_hal_version_fn_t   version;
+    http_hal_handler_t      respond;
+    uint32_t                since;
+    int64_t                 deadline_us;
+} http_hal_waiter_t;
+
 /**
  * Internal structure of the HTTP HAL instance.
  */
@@ -14,38 +119,236 @@ struct http_hal_s {
     httpd_handle_t      server;
     http_hal_config_t   cfg;
 
-    // Endpoints registered before server start are stored here and registered during startup.
-    httpd_uri_t        *uris;
-    size_t              uris_len;
-    size_t              uris_cap;
+    // Current route table, swapped atomically. Esp_http_server only knows the
+    // catch-all dispatchers, so routes can change while serving.
+    _Atomic(http_hal_table_t *) table;
+    // Replaced snapshots, tagged with the epoch they were retired in and freed
+    // once no reader that entered at or before that epoch is left (write_lock).
+    http_hal_table_t   *retired;
+    atomic_bool         has_retired;
+    atomic_uint         epoch;
+    // epoch each active reader entered in, 0 for a free slot
+    atomic_uint         reader_epoch[READER_SLOTS];
+    SemaphoreHandle_t   write_lock;
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    StaticSemaphore_t   write_lock_buf;
+#endif
+
+    // Session context pool, one slot per socket, each with its own scratch arena.
+    http_hal_session_t *sessions;
+    uint8_t            *arenas;
+    size_t              sessions_len;
+    http_hal_session_t *free_sessions;
+
+    // Connection/request accounting used by the graceful drain.
+    atomic_bool         draining;
+    atomic_int          open_sockets;
+    atomic_int          in_flight;
+    atomic_uint         drained;
+    atomic_uint         idle_closed;
+    atomic_uint         requests;
+
+    // Requests handed to a module's worker with http_hal_detach(), ended before httpd stops.
+    atomic_int          detached;
+    atomic_bool         stopping;
+
+    // drawn at init and part of every ETag, so tags from a previous boot never match
+    uint32_t            etag_epoch;
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    http_hal_alloc_slot_t alloc_slots[ALLOC_SLOTS];
+    atomic_size_t       alloc_slots_len;
+#endif
+
+#if LONGPOLL_MAX > 0
+    // Long-poll requests detached from the httpd task, answered by lp_task.
+    http_hal_waiter_t   waiters[LONGPOLL_MAX];
+    portMUX_TYPE        lp_lock;
+    TaskHandle_t        lp_task;
+    atomic_bool         lp_stopping;
+#endif
 };
 
-static esp_err_t ensure_capacity(http_hal_t *h, size_t need)
+#if CONFIG_HTTP_HAL_STATIC_POOL
+/*
+ * Static-pool mode: instances, route tables, session contexts and scratch arenas are
+ * reserved at link time so the HAL never touches the heap.
+ */
+#define POOL_INSTANCES  CONFIG_HTTP_HAL_POOL_INSTANCES
+#define POOL_ROUTES     CONFIG_HTTP_HAL_POOL_ROUTES
+#define POOL_SESSIONS   CONFIG_HTTP_HAL_POOL_SESSIONS
+#define POOL_SCRATCH    ((CONFIG_HTTP_HAL_SCRATCH_SIZE + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1))
+// current snapshot, one being built and one retired but still held by a lookup
+// (readers only hold a snapshot while matching the URI, never while a handler runs)
+#define POOL_TABLES     3
+#define TABLE_WAIT_MS   1000
+
+static http_hal_t          s_hal_pool[POOL_INSTANCES];
+static bool                s_hal_used[POOL_INSTANCES];
+static http_hal_table_t    s_table_pool[POOL_INSTANCES][POOL_TABLES];
+static atomic_bool         s_table_used[POOL_INSTANCES][POOL_TABLES];
+static http_hal_route_t    s_route_pool[POOL_INSTANCES][POOL_TABLES][POOL_ROUTES];
+static http_hal_session_t  s_session_pool[POOL_INSTANCES][POOL_SESSIONS];
+static uint8_t             s_arena_pool[POOL_INSTANCES][POOL_SESSIONS * POOL_SCRATCH] __attribute__((aligned(SCRATCH_ALIGN)));
+#endif
+
+/* ====== Route table ====== */
+
+static http_hal_table_t *table_alloc(http_hal_t *h, size_t len)
+{
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    if (len > POOL_ROUTES) {
+        ESP_LOGE(TAG, "Route pool exhausted (%d routes)", POOL_ROUTES);
+        return NULL;
+    }
+    size_t idx = (size_t)(h - s_hal_pool);
+    for (size_t i = 0; i < POOL_TABLES; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&s_table_used[idx][i], &expected, true)) {
+            http_hal_table_t *t = &s_table_pool[idx][i];
+            t->routes = s_route_pool[idx][i];
+            return t;
+        }
+    }
+    return NULL;
+#else
+    http_hal_table_t *t = (http_hal_table_t*)malloc(sizeof(http_hal_table_t) + len * sizeof(http_hal_route_t));
+    if (t) t->routes = (http_hal_route_t*)(t + 1);
+    return t;
+#endif
+}
+
+static void table_free(http_hal_table_t *t)
 {
-    if (h->uris_cap >= need) return ESP_OK;
+    if (!t) return;
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    size_t idx = (size_t)(t->owner - s_hal_pool);
+    atomic_store(&s_table_used[idx][t - s_table_pool[idx]], false);
+#else
+    free(t);
+#endif
+}
 
-    size_t new_cap = (h->uris_cap == 0) ? 4 : h->uris_cap * 2;
-    while (new_cap < need) new_cap *= 2;
+/*
+ * Readers record the epoch they entered in before loading the table. A table
+ * retired in epoch R was current when every reader that can hold it loaded it,
+ * so such a reader entered in an epoch <= R; once no slot holds such an epoch
+ * the table is unreachable. Writers never wait for readers.
+ */
+static int reader_enter(http_hal_t *h)
+{
+    for (;;) {
+        for (int i = 0; i < READER_SLOTS; i++) {
+            unsigned free_slot = 0;
+            unsigned e = atomic_load(&h->epoch);
+            if (atomic_compare_exchange_strong(&h->reader_epoch[i], &free_slot, e)) return i;
+        }
+        // more concurrent lookups than slots, each one is short
+        taskYIELD();
+    }
+}
 
-    httpd_uri_t *p = (httpd_uri_t*)realloc(h->uris, new_cap * sizeof(httpd_uri_t));
-    if (!p) return ESP_ERR_NO_MEM;
+// must be called with write_lock held
+static void table_reclaim(http_hal_t *h)
+{
+    unsigned oldest = UINT32_MAX;
+    for (int i = 0; i < READER_SLOTS; i++) {
+        unsigned e = atomic_load(&h->reader_epoch[i]);
+        if (e && e < oldest) oldest = e;
+    }
 
-    h->uris = p;
-    h->uris_cap = new_cap;
-    return ESP_OK;
+    http_hal_table_t **pp = &h->retired;
+    while (*pp) {
+        http_hal_table_t *t = *pp;
+        if (t->retired_epoch < oldest) {
+            *pp = t->next_retired;
+            table_free(t);
+        } else {
+            pp = &t->next_retired;
+        }
+    }
+    atomic_store(&h->has_retired, h->retired != NULL);
 }
 
-esp_err_t http_hal_init(http_hal_t **out, const http_hal_config_t *cfg)
+static void reader_exit(http_hal_t *h, int slot)
 {
-    ESP_RETURN_ON_FALSE(out && cfg, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    atomic_store(&h->reader_epoch[slot], 0);
 
-    http_hal_t *h = (http_hal_t*)calloc(1, sizeof(http_hal_t));
-    ESP_RETURN_ON_FALSE(h, ESP_ERR_NO_MEM, TAG, "calloc failed");
+    // reclaim here too, otherwise a snapshot retired while we read would wait for the next update
+    if (atomic_load(&h->has_retired) && xSemaphoreTake(h->write_lock, 0) == pdTRUE) {
+        table_reclaim(h);
+        xSemaphoreGive(h->write_lock);
+    }
+}
 
-    h->server = NULL;
-    h->cfg = *cfg;
+// must be called with write_lock held, after the replacement was published
+static void table_retire(http_hal_t *h, http_hal_table_t *old)
+{
+    if (!old) return;
 
-    *out = h;
+    // readers entering from the next epoch on can only load the new table
+    old->retired_epoch = atomic_fetch_add(&h->epoch, 1);
+    old->next_retired = h->retired;
+    h->retired = old;
+    table_reclaim(h);
+}
+
+static bool route_match(const http_hal_route_t *r, const char *uri, httpd_method_t method)
+{
+    return r->method == method && !strcmp(r->uri, uri);
+}
+
+/**
+ * Build a new snapshot from the current one, optionally replacing/adding `add`
+ * and/or removing the route matching (del_uri, del_method), then publish it.
+ * Must be called with write_lock held.
+ */
+static esp_err_t table_update(http_hal_t *h, const http_hal_route_t *add, const char *del_uri, httpd_method_t del_method)
+{
+    http_hal_table_t *cur = atomic_load(&h->table);
+    size_t cur_len = cur ? cur->len : 0;
+
+    size_t need = cur_len + (add ? 1 : 0);
+    http_hal_table_t *t = table_alloc(h, need);
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    // all snapshot slots busy: a retired one is still held by a route lookup
+    for (int waited = 0; !t && need <= POOL_ROUTES && waited < TABLE_WAIT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        table_reclaim(h);
+        t = table_alloc(h, need);
+    }
+#endif
+    if (!t) return ESP_ERR_NO_MEM;
+
+    t->owner = h;
+    t->next_retired = NULL;
+    t->len = 0;
+
+    bool found = false;
+    for (size_t i = 0; i < cur_len; i++) {
+        const http_hal_route_t *r = &cur->routes[i];
+        if (add && route_match(r, add->uri, add->method)) {
+            // replaced in place, keeping the route order
+            t->routes[t->len++] = *add;
+            found = true;
+            continue;
+        }
+        if (del_uri && route_match(r, del_uri, del_method)) {
+            found = true;
+            continue;
+        }
+        t->routes[t->len++] = *r;
+    }
+
+    if (add && !found) {
+        t->routes[t->len++] = *add;
+    } else if (!add && !found) {
+        table_free(t);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    atomic_store(&h->table, t);
+    table_retire(h, cur);
     return ESP_OK;
 }
 
@@ -58,6 +361,642 @@ static void fill_httpd_config(const http_hal_config_t *in, httpd_config_t *out)
     out->lru_purge_enable = in->lru_purge_enable;
 
     if (in->max_uri_handlers > 0) out->max_uri_handlers = in->max_uri_handlers;
+    if (out->max_uri_handlers < DISPATCH_METHODS) out->max_uri_handlers = DISPATCH_METHODS;
+    if (in->max_open_sockets > 0) out->max_open_sockets = in->max_open_sockets;
+    if (in->stack_size > 0) out->stack_size = in->stack_size;
+    if (in->pin_core) out->core_id = in->core_id;
+}
+
+/* ====== Session pool ====== */
+
+static esp_err_t session_pool_init(http_hal_t *h)
+{
+    httpd_config_t cfg;
+    fill_httpd_config(&h->cfg, &cfg);
+
+    h->sessions_len = cfg.max_open_sockets;
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    size_t idx = (size_t)(h - s_hal_pool);
+    if (h->sessions_len > POOL_SESSIONS) {
+        ESP_LOGW(TAG, "max_open_sockets %u clamped to session pool size %d",
+                 (unsigned)h->sessions_len, POOL_SESSIONS);
+        h->sessions_len = POOL_SESSIONS;
+    }
+    if (h->cfg.scratch_size > POOL_SCRATCH) {
+        ESP_LOGW(TAG, "scratch_size %u clamped to pool arena size %d",
+                 (unsigned)h->cfg.scratch_size, POOL_SCRATCH);
+        h->cfg.scratch_size = POOL_SCRATCH;
+    }
+    h->sessions = s_session_pool[idx];
+    h->arenas = s_arena_pool[idx];
+    memset(h->sessions, 0, POOL_SESSIONS * sizeof(http_hal_session_t));
+#else
+    h->sessions = (http_hal_session_t*)calloc(h->sessions_len, sizeof(http_hal_session_t));
+    h->arenas = (uint8_t*)malloc(h->sessions_len * h->cfg.scratch_size);
+    if (!h->sessions || !h->arenas) return ESP_ERR_NO_MEM;
+#endif
+    // httpd must never open more sockets than there are session contexts
+    h->cfg.max_open_sockets = (int)h->sessions_len;
+
+    h->free_sessions = NULL;
+    for (size_t i = h->sessions_len; i > 0; i--) {
+        http_hal_session_t *s = &h->sessions[i - 1];
+        s->owner = h;
+        s->arena = h->arenas + (i - 1) * h->cfg.scratch_size;
+        s->next_free = h->free_sessions;
+        h->free_sessions = s;
+    }
+    return ESP_OK;
+}
+
+static http_hal_session_t *session_acquire(http_hal_t *h)
+{
+    // only called from the httpd task, no locking needed
+    http_hal_session_t *s = h->free_sessions;
+    if (!s) return NULL;
+
+    h->free_sessions = s->next_free;
+    s->next_free = NULL;
+    s->arena_used = 0;
+    return s;
+}
+
+static void session_release(void *ctx)
+{
+    // called by httpd when the socket is closed
+    http_hal_session_t *s = (http_hal_session_t*)ctx;
+    if (!s) return;
+
+    ESP_LOGD(TAG, "Session released, scratch peak %u/%u bytes",
+             (unsigned)s->arena_peak, (unsigned)s->owner->cfg.scratch_size);
+    s->next_free = s->owner->free_sessions;
+    s->owner->free_sessions = s;
+}
+
+static void global_ctx_noop_free(void *ctx)
+{
+    // the HAL instance is owned by the caller of http_hal_init()
+    (void)ctx;
+}
+
+/* ====== Allocation tracking ====== */
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+/*
+ * Heap calls are counted only while a wrapped handler runs on the httpd task.
+ * Socket sends are excluded (see traced_send()) since lwIP buffers are not
+ * allocations made by the handler.
+ */
+typedef struct {
+    volatile uint32_t allocs;
+    volatile uint32_t frees;
+    volatile uint32_t bytes;
+} alloc_trace_t;
+
+static alloc_trace_t s_trace;
+
+#if CONFIG_IDF_TARGET_LINUX
+static __thread bool s_trace_active;
+
+static inline bool trace_enabled(void)
+{
+    return s_trace_active;
+}
+
+static inline void trace_set_active(bool on)
+{
+    s_trace_active = on;
+}
+
+// malloc/free are redirected here with -Wl,--wrap (see main/CMakeLists.txt)
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    if (trace_enabled()) { s_trace.allocs++; s_trace.bytes += size; }
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    if (trace_enabled()) { s_trace.allocs++; s_trace.bytes += n * size; }
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (trace_enabled()) { s_trace.allocs++; s_trace.bytes += size; }
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (trace_enabled() && ptr) s_trace.frees++;
+    __real_free(ptr);
+}
+#else
+static volatile TaskHandle_t s_trace_task;
+
+static inline bool trace_enabled(void)
+{
+    return s_trace_task && xTaskGetCurrentTaskHandle() == s_trace_task;
+}
+
+static inline void trace_set_active(bool on)
+{
+    s_trace_task = on ? xTaskGetCurrentTaskHandle() : NULL;
+}
+
+// heap hooks (CONFIG_HEAP_USE_HOOKS), called by heap_caps for every allocation
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    if (ptr && trace_enabled()) { s_trace.allocs++; s_trace.bytes += size; }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    if (ptr && trace_enabled()) s_trace.frees++;
+}
+#endif
+
+static int traced_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    (void)hd;
+    bool active = trace_enabled();
+    trace_set_active(false);
+    int ret = send(sockfd, buf, buf_len, flags);
+    trace_set_active(active);
+
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return HTTPD_SOCK_ERR_TIMEOUT;
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    return ret;
+}
+
+static void alloc_trace_begin(httpd_req_t *req)
+{
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), traced_send);
+    s_trace.allocs = 0;
+    s_trace.frees = 0;
+    s_trace.bytes = 0;
+    trace_set_active(true);
+}
+
+static void alloc_trace_end(const http_hal_route_t *r)
+{
+    trace_set_active(false);
+
+    http_hal_alloc_slot_t *st = r->alloc;
+    if (!st) return;
+    uint32_t requests = atomic_fetch_add_explicit(&st->requests, 1, memory_order_relaxed) + 1;
+    atomic_fetch_add_explicit(&st->allocs, s_trace.allocs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->frees, s_trace.frees, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->bytes, s_trace.bytes, memory_order_relaxed);
+    atomic_store_explicit(&st->last_allocs, s_trace.allocs, memory_order_relaxed);
+    atomic_store_explicit(&st->last_bytes, s_trace.bytes, memory_order_relaxed);
+    if (s_trace.allocs == 0) return;
+
+    atomic_fetch_add_explicit(&st->alloc_requests, 1, memory_order_relaxed);
+    if (requests > CONFIG_HTTP_HAL_ALLOC_WARMUP) {
+        ESP_LOGW(TAG, "%s (method %d) allocated %u times (%u bytes) in steady state",
+                 r->uri, (int)r->method, (unsigned)s_trace.allocs, (unsigned)s_trace.bytes);
+#if CONFIG_HTTP_HAL_ALLOC_ASSERT
+        ESP_LOGE(TAG, "Heap use on the request hot path, aborting");
+        abort();
+#endif
+    }
+}
+#endif
+
+/* ====== Connection tracking ====== */
+
+static esp_err_t session_open(httpd_handle_t hd, int sockfd)
+{
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(hd);
+
+    // counted even when refused: httpd calls close_fn for refused sockets too
+    atomic_fetch_add(&h->open_sockets, 1);
+    if (atomic_load(&h->draining)) {
+        ESP_LOGD(TAG, "Draining, refusing fd %d", sockfd);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void session_close(httpd_handle_t hd, int sockfd)
+{
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(hd);
+
+    atomic_fetch_sub(&h->open_sockets, 1);
+    close(sockfd);
+}
+
+static void close_idle_work(void *arg)
+{
+    // runs on the httpd task between requests, so no session is mid-request here
+    http_hal_t *h = (http_hal_t*)arg;
+
+    int fds[CONFIG_LWIP_MAX_SOCKETS];
+    size_t n = sizeof(fds) / sizeof(fds[0]);
+    if (httpd_get_client_list(h->server, &n, fds) != ESP_OK) return;
+
+    for (size_t i = 0; i < n; i++) {
+        if (httpd_sess_trigger_close(h->server, fds[i]) == ESP_OK) {
+            atomic_fetch_add(&h->idle_closed, 1);
+        }
+    }
+}
+
+/* ====== Dispatcher ====== */
+
+// the scratch arena only lives for the duration of the request
+static void scratch_reset(httpd_req_t *req)
+{
+    http_hal_session_t *s = (http_hal_session_t*)req->sess_ctx;
+    if (!s) return;
+    if (s->arena_used > s->arena_peak) s->arena_peak = s->arena_used;
+    s->arena_used = 0;
+}
+
+// called on the httpd task before the detached copy is handed over
+static void scratch_hand_over(httpd_req_t *req)
+{
+    http_hal_session_t *s = (http_hal_session_t*)req->sess_ctx;
+    if (s) s->detached = true;
+}
+
+static esp_err_t dispatch_route(http_hal_t *h, httpd_req_t *req, const http_hal_route_t *r)
+{
+    if (!req->sess_ctx) {
+        http_hal_session_t *s = session_acquire(h);
+        if (!s) {
+            return http_hal_send_err(req, 503, "No free session");
+        }
+        req->sess_ctx = s;
+        req->free_ctx = session_release;
+    }
+
+    req->user_ctx = r->user_ctx;
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    alloc_trace_begin(req);
+#endif
+    esp_err_t err = r->handler(req);
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    alloc_trace_end(r);
+#endif
+
+    // a detached request may still be using the arena on another task
+    http_hal_session_t *s = (http_hal_session_t*)req->sess_ctx;
+    if (s->detached) {
+        s->detached = false;
+    } else {
+        scratch_reset(req);
+    }
+    return err;
+}
+
+static esp_err_t dispatch_handler(httpd_req_t *req)
+{
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(req->handle);
+    if (!h) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No HAL instance");
+    }
+
+    // readers only announce themselves, the snapshot they load stays valid until they leave;
+    // the route is copied out so a long-running handler (streams) does not hold the snapshot
+    int slot = reader_enter(h);
+    http_hal_table_t *t = atomic_load(&h->table);
+
+    size_t path_len = strcspn(req->uri, "?");
+    http_hal_route_t route;
+    bool found = false, uri_known = false;
+    for (size_t i = 0; t && i < t->len; i++) {
+        const http_hal_route_t *r = &t->routes[i];
+        if (!httpd_uri_match_wildcard(r->uri, req->uri, path_len)) continue;
+        uri_known = true;
+        if (r->method == req->method) {
+            route = *r;
+            found = true;
+            break;
+        }
+    }
+    reader_exit(h, slot);
+
+    // while draining, every response is the last one on its connection
+    bool draining = atomic_load(&h->draining);
+    if (draining) {
+        httpd_resp_set_hdr(req, "Connection", "close");
+    }
+    atomic_fetch_add(&h->in_flight, 1);
+    atomic_fetch_add_explicit(&h->requests, 1, memory_order_relaxed);
+
+    esp_err_t err;
+    if (found) {
+        err = dispatch_route(h, req, &route);
+    } else if (uri_known) {
+        err = httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+    } else {
+        err = httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+    }
+
+    atomic_fetch_sub(&h->in_flight, 1);
+    if (draining || atomic_load(&h->draining)) {
+        atomic_fetch_add(&h->drained, 1);
+        httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+    }
+    return err;
+}
+
+/* ====== Instance allocation ====== */
+
+static http_hal_t *instance_alloc(void)
+{
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    for (size_t i = 0; i < POOL_INSTANCES; i++) {
+        if (!s_hal_used[i]) {
+            s_hal_used[i] = true;
+            http_hal_t *h = &s_hal_pool[i];
+            memset(h, 0, sizeof(*h));
+            h->write_lock = xSemaphoreCreateMutexStatic(&h->write_lock_buf);
+            return h;
+        }
+    }
+    return NULL;
+#else
+    http_hal_t *h = (http_hal_t*)calloc(1, sizeof(http_hal_t));
+    if (!h) return NULL;
+    h->write_lock = xSemaphoreCreateMutex();
+    if (!h->write_lock) {
+        free(h);
+        return NULL;
+    }
+    return h;
+#endif
+}
+
+static void instance_free(http_hal_t *h)
+{
+    // server is stopped, no reader can hold a snapshot
+    for (http_hal_table_t *t = h->retired, *next; t; t = next) {
+        next = t->next_retired;
+        table_free(t);
+    }
+    h->retired = NULL;
+    table_free(atomic_exchange(&h->table, NULL));
+    vSemaphoreDelete(h->write_lock);
+
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    s_hal_used[h - s_hal_pool] = false;
+#else
+    free(h->sessions);
+    free(h->arenas);
+    free(h);
+#endif
+}
+
+static void log_pool_report(const http_hal_t *h)
+{
+    size_t sessions_bytes = h->sessions_len * sizeof(http_hal_session_t);
+    size_t arena_bytes = h->sessions_len * h->cfg.scratch_size;
+
+#if CONFIG_HTTP_HAL_STATIC_POOL
+    ESP_LOGI(TAG, "Static pools: %d instance(s) x %u bytes, total reserved %u bytes",
+             POOL_INSTANCES, (unsigned)sizeof(http_hal_t),
+             (unsigned)(sizeof(s_hal_pool) + sizeof(s_table_pool) + sizeof(s_route_pool) +
+                        sizeof(s_session_pool) + sizeof(s_arena_pool)));
+    ESP_LOGI(TAG, "Routes: %d slots x %d snapshots (%u bytes)",
+             POOL_ROUTES, POOL_TABLES, (unsigned)sizeof(s_route_pool[0]));
+#endif
+    ESP_LOGI(TAG, "Sessions: %u x %u bytes scratch (%u bytes)",
+             (unsigned)h->sessions_len, (unsigned)h->cfg.scratch_size, (unsigned)(sessions_bytes + arena_bytes));
+}
+
+/* ====== Detached requests ====== */
+
+// the detached copy is malloc'ed by esp_http_server and cannot be supplied by the
+// caller: it is the one heap use per detached request, exempt from tracing and the pools
+static esp_err_t async_begin(httpd_req_t *req, httpd_req_t **out)
+{
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    bool traced = trace_enabled();
+    trace_set_active(false);
+#endif
+    esp_err_t err = httpd_req_async_handler_begin(req, out);
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    trace_set_active(traced);
+#endif
+    return err;
+}
+
+esp_err_t http_hal_detach(httpd_req_t *req, httpd_req_t **out)
+{
+    ESP_RETURN_ON_FALSE(req && out, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(req->handle);
+    if (!h || atomic_load(&h->stopping) || atomic_load(&h->draining)) return ESP_ERR_INVALID_STATE;
+
+    // counted first so http_hal_stop() never misses a request being detached
+    atomic_fetch_add(&h->detached, 1);
+    esp_err_t err = async_begin(req, out);
+    if (err != ESP_OK) {
+        atomic_fetch_sub(&h->detached, 1);
+        return err;
+    }
+    scratch_hand_over(req);
+    return ESP_OK;
+}
+
+esp_err_t http_hal_detach_end(httpd_req_t *req, esp_err_t result)
+{
+    ESP_RETURN_ON_FALSE(req, ESP_ERR_INVALID_ARG, TAG, "req null");
+
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(req->handle);
+    // a failed response leaves the connection unusable, as httpd does for a failed handler
+    if (result != ESP_OK) httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+    scratch_reset(req);
+    esp_err_t err = httpd_req_async_handler_complete(req);
+    if (h) atomic_fetch_sub(&h->detached, 1);
+    return err;
+}
+
+bool http_hal_ending(httpd_req_t *req)
+{
+    http_hal_t *h = req ? (http_hal_t*)httpd_get_global_user_ctx(req->handle) : NULL;
+    return !h || atomic_load(&h->stopping) || atomic_load(&h->draining);
+}
+
+// gives detached requests the chance to end (see http_hal_ending()) before httpd goes away
+static void detach_flush(http_hal_t *h)
+{
+    atomic_store(&h->stopping, true);
+    for (int ms = 0; ms < DETACH_STOP_MS; ms += 10) {
+        if (atomic_load(&h->detached) == 0) return;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    ESP_LOGW(TAG, "Detached requests still running at stop");
+}
+
+/* ====== Long polling ====== */
+
+#if LONGPOLL_MAX > 0
+static bool waiter_done(const http_hal_waiter_t *w, int64_t now, bool stopping)
+{
+    return stopping || now >= w->deadline_us || w->version() != w->since;
+}
+
+static void longpoll_task(void *arg)
+{
+    http_hal_t *h = (http_hal_t*)arg;
+    for (;;) {
+        bool stopping = atomic_load(&h->lp_stopping);
+        int64_t now = esp_timer_get_time();
+        int64_t next = INT64_MAX;
+
+        for (size_t i = 0; i < LONGPOLL_MAX; i++) {
+            http_hal_waiter_t *w = &h->waiters[i];
+            portENTER_CRITICAL(&h->lp_lock);
+            bool parked = w->state == WAITER_PARKED;
+            portEXIT_CRITICAL(&h->lp_lock);
+            if (!parked) continue;
+
+            if (!waiter_done(w, now, stopping)) {
+                if (w->deadline_us < next) next = w->deadline_us;
+                continue;
+            }
+            // the async copy keeps the session context, so the handler can use the scratch arena
+            w->respond(w->req);
+            scratch_reset(w->req);
+            httpd_req_async_handler_complete(w->req);
+
+            portENTER_CRITICAL(&h->lp_lock);
+            w->req = NULL;
+            w->state = WAITER_FREE;
+            portEXIT_CRITICAL(&h->lp_lock);
+        }
+
+        TickType_t wait = portMAX_DELAY;
+        if (next != INT64_MAX) {
+            wait = pdMS_TO_TICKS((next - now + 999) / 1000) + 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+// answers every parked request with its current state before httpd goes away
+static void longpoll_flush(http_hal_t *h)
+{
+    if (!h->lp_task) return;
+    atomic_store(&h->lp_stopping, true);
+    xTaskNotifyGive(h->lp_task);
+
+    for (int ms = 0; ms < LONGPOLL_STOP_MS; ms += 10) {
+        bool busy = false;
+        portENTER_CRITICAL(&h->lp_lock);
+        for (size_t i = 0; i < LONGPOLL_MAX; i++) {
+            if (h->waiters[i].state != WAITER_FREE) busy = true;
+        }
+        portEXIT_CRITICAL(&h->lp_lock);
+        if (!busy) return;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    ESP_LOGW(TAG, "Long-poll requests still pending at stop");
+}
+#endif
+
+esp_err_t http_hal_longpoll(httpd_req_t *req, uint32_t since, uint32_t timeout_ms,
+                            http_hal_version_fn_t version, http_hal_handler_t respond)
+{
+    ESP_RETURN_ON_FALSE(req && version && respond, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    if (timeout_ms == 0 || version() != since) return respond(req);
+
+#if LONGPOLL_MAX > 0
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(req->handle);
+    if (!h || !h->lp_task || atomic_load(&h->lp_stopping) || atomic_load(&h->draining)) {
+        return respond(req);
+    }
+
+    http_hal_waiter_t *w = NULL;
+    portENTER_CRITICAL(&h->lp_lock);
+    for (size_t i = 0; i < LONGPOLL_MAX && !w; i++) {
+        if (h->waiters[i].state == WAITER_FREE) {
+            w = &h->waiters[i];
+            w->state = WAITER_RESERVED;
+        }
+    }
+    portEXIT_CRITICAL(&h->lp_lock);
+    // all slots taken: answer now, the client simply polls again
+    if (!w) return respond(req);
+
+    httpd_req_t *copy = NULL;
+    esp_err_t err = async_begin(req, &copy);
+    if (err != ESP_OK) {
+        portENTER_CRITICAL(&h->lp_lock);
+        w->state = WAITER_FREE;
+        portEXIT_CRITICAL(&h->lp_lock);
+        return respond(req);
+    }
+    w->req = copy;
+    w->version = version;
+    w->respond = respond;
+    w->since = since;
+    w->deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    scratch_hand_over(req);
+
+    portENTER_CRITICAL(&h->lp_lock);
+    w->state = WAITER_PARKED;
+    portEXIT_CRITICAL(&h->lp_lock);
+
+    // also covers a change that happened between the version check and parking
+    xTaskNotifyGive(h->lp_task);
+    return ESP_OK;
+#else
+    return respond(req);
+#endif
+}
+
+void http_hal_longpoll_wake(http_hal_t *h)
+{
+#if LONGPOLL_MAX > 0
+    if (h && h->lp_task) xTaskNotifyGive(h->lp_task);
+#else
+    (void)h;
+#endif
+}
+
+/* ====== Lifecycle ====== */
+
+esp_err_t http_hal_init(http_hal_t **out, const http_hal_config_t *cfg)
+{
+    ESP_RETURN_ON_FALSE(out && cfg, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    http_hal_t *h = instance_alloc();
+    ESP_RETURN_ON_FALSE(h, ESP_ERR_NO_MEM, TAG, "instance alloc failed");
+
+    h->server = NULL;
+    h->cfg = *cfg;
+    h->etag_epoch = esp_random();
+    atomic_store(&h->epoch, 1);
+#if LONGPOLL_MAX > 0
+    h->lp_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+#endif
+    if (h->cfg.scratch_size == 0) h->cfg.scratch_size = CONFIG_HTTP_HAL_SCRATCH_SIZE;
+    h->cfg.scratch_size = (h->cfg.scratch_size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+
+    if (session_pool_init(h) != ESP_OK) {
+        ESP_LOGE(TAG, "session pool alloc failed");
+        http_hal_deinit(h);
+        return ESP_ERR_NO_MEM;
+    }
+    log_pool_report(h);
+
+    *out = h;
+    return ESP_OK;
 }
 
 esp_err_t http_hal_start(http_hal_t *h)
@@ -67,6 +1006,11 @@ esp_err_t http_hal_start(http_hal_t *h)
 
     httpd_config_t cfg;
     fill_httpd_config(&h->cfg, &cfg);
+    cfg.global_user_ctx = h;
+    cfg.global_user_ctx_free_fn = global_ctx_noop_free;
+    cfg.uri_match_fn = httpd_uri_match_wildcard;
+    cfg.open_fn = session_open;
+    cfg.close_fn = session_close;
 
 #if CONFIG_IDF_TARGET_LINUX
     // if user didn't specify a port, use 8080 instead of default 80 to avoid permission issues on Linux
@@ -74,15 +1018,36 @@ esp_err_t http_hal_start(http_hal_t *h)
 
     ESP_LOGI(TAG, "Starting server on port: %d", cfg.server_port);
 
+    atomic_store(&h->draining, false);
+    atomic_store(&h->stopping, false);
+    atomic_store(&h->open_sockets, 0);
+    atomic_store(&h->in_flight, 0);
+
     esp_err_t err = httpd_start(&h->server, &cfg);
     ESP_RETURN_ON_ERROR(err, TAG, "httpd_start failed");
 
-    // endpoints registered before start
-    for (size_t i = 0; i < h->uris_len; i++) {
-        err = httpd_register_uri_handler(h->server, &h->uris[i]);
+#if LONGPOLL_MAX > 0
+    atomic_store(&h->lp_stopping, false);
+    if (!h->lp_task &&
+        xTaskCreate(longpoll_task, "http_lp", LONGPOLL_STACK, h, LONGPOLL_PRIO, &h->lp_task) != pdPASS) {
+        // not fatal: long-poll requests are then answered at once
+        h->lp_task = NULL;
+        ESP_LOGW(TAG, "No long-poll task, wait= requests answered immediately");
+    }
+#endif
+
+    // esp_http_server only sees one catch-all per method, routes are resolved from the table snapshot
+    for (size_t i = 0; i < DISPATCH_METHODS; i++) {
+        httpd_uri_t u = {
+            .uri      = "/*",
+            .method   = s_dispatch_methods[i],
+            .handler  = dispatch_handler,
+            .user_ctx = NULL
+        };
+        err = httpd_register_uri_handler(h->server, &u);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed registering URI %s (method %d): %s",
-                     h->uris[i].uri, (int)h->uris[i].method, esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed registering dispatcher (method %d): %s",
+                     (int)u.method, esp_err_to_name(err));
         }
     }
 
@@ -95,59 +1060,127 @@ esp_err_t http_hal_stop(http_hal_t *h)
     if (!h->server) return ESP_OK;
 
     ESP_LOGI(TAG, "Stopping server");
+#if LONGPOLL_MAX > 0
+    longpoll_flush(h);
+#endif
+    detach_flush(h);
     esp_err_t err = httpd_stop(h->server);
     if (err == ESP_OK) {
         h->server = NULL;
+        xSemaphoreTake(h->write_lock, portMAX_DELAY);
+        table_reclaim(h);
+        xSemaphoreGive(h->write_lock);
     }
     return err;
 }
 
+esp_err_t http_hal_stop_graceful(http_hal_t *h, uint32_t timeout_ms, http_hal_drain_report_t *report)
+{
+    ESP_RETURN_ON_FALSE(h, ESP_ERR_INVALID_ARG, TAG, "h null");
+    if (report) memset(report, 0, sizeof(*report));
+    if (!h->server) return ESP_OK;
+
+    ESP_LOGI(TAG, "Draining server (timeout %u ms)", (unsigned)timeout_ms);
+    atomic_store(&h->drained, 0);
+    atomic_store(&h->idle_closed, 0);
+    atomic_store(&h->draining, true);
+
+    // give keep-alive clients a short window to send a request already in the pipe,
+    // then close whatever is idle; active connections are closed after their response
+    TickType_t start = xTaskGetTickCount();
+    TickType_t deadline = pdMS_TO_TICKS(timeout_ms);
+    TickType_t idle_grace = pdMS_TO_TICKS(CONFIG_HTTP_HAL_DRAIN_IDLE_MS);
+    bool idle_closed = false;
+    while (atomic_load(&h->open_sockets) > 0) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= deadline) break;
+        if (!idle_closed && elapsed >= idle_grace && atomic_load(&h->in_flight) == 0) {
+            idle_closed = httpd_queue_work(h->server, close_idle_work, h) == ESP_OK;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    http_hal_drain_report_t r = {
+        .drained     = atomic_load(&h->drained),
+        .idle_closed = atomic_load(&h->idle_closed),
+        .aborted     = (uint32_t)atomic_load(&h->open_sockets),
+    };
+    ESP_LOGI(TAG, "Drain done: %u drained, %u idle closed, %u aborted",
+             (unsigned)r.drained, (unsigned)r.idle_closed, (unsigned)r.aborted);
+    if (report) *report = r;
+
+    esp_err_t err = http_hal_stop(h);
+    atomic_store(&h->draining, false);
+    return err;
+}
+
 void http_hal_deinit(http_hal_t *h)
 {
     if (!h) return;
 
     (void)http_hal_stop(h);
 
-    free(h->uris);
-    free(h);
+#if LONGPOLL_MAX > 0
+    // no waiter left after the stop, so the task is blocked in its notification wait
+    if (h->lp_task) vTaskDelete(h->lp_task);
+#endif
+    instance_free(h);
+}
+
+/* ====== Endpoints ====== */
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+// must be called with write_lock held
+static http_hal_alloc_slot_t *alloc_slot_get(http_hal_t *h, const char *uri, httpd_method_t method)
+{
+    size_t n = atomic_load_explicit(&h->alloc_slots_len, memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+        http_hal_alloc_slot_t *st = &h->alloc_slots[i];
+        if (st->method == method && !strcmp(st->uri, uri)) return st;
+    }
+    if (n == ALLOC_SLOTS) {
+        ESP_LOGW(TAG, "Alloc slot table full, %s not traced", uri);
+        return NULL;
+    }
+    http_hal_alloc_slot_t *st = &h->alloc_slots[n];
+    st->uri = uri;
+    st->method = method;
+    atomic_store_explicit(&h->alloc_slots_len, n + 1, memory_order_release);
+    return st;
 }
+#endif
 
 esp_err_t http_hal_register_endpoint(http_hal_t *h, const http_hal_endpoint_t *ep)
 {
     ESP_RETURN_ON_FALSE(h && ep && ep->uri && ep->handler, ESP_ERR_INVALID_ARG, TAG, "bad args");
 
-    ESP_RETURN_ON_ERROR(ensure_capacity(h, h->uris_len + 1), TAG, "ensure capacity failed");
-
-    httpd_uri_t u = {
+    http_hal_route_t r = {
         .uri      = ep->uri,
         .method   = ep->method,
         .handler  = ep->handler,
         .user_ctx = ep->user_ctx
     };
 
-    h->uris[h->uris_len++] = u;
+    xSemaphoreTake(h->write_lock, portMAX_DELAY);
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    r.alloc = alloc_slot_get(h, ep->uri, ep->method);
+#endif
+    esp_err_t err = table_update(h, &r, NULL, 0);
+    xSemaphoreGive(h->write_lock);
 
-    // if server already started, register immediately
-    if (h->server) {
-        esp_err_t err = httpd_register_uri_handler(h->server, &h->uris[h->uris_len - 1]);
-        ESP_RETURN_ON_ERROR(err, TAG, "register uri failed");
-    }
+    ESP_RETURN_ON_ERROR(err, TAG, "register %s failed", ep->uri);
     return ESP_OK;
 }
 
 esp_err_t http_hal_unregister_endpoint(http_hal_t *h, const char *uri, httpd_method_t method)
 {
     ESP_RETURN_ON_FALSE(h && uri, ESP_ERR_INVALID_ARG, TAG, "bad args");
-    ESP_RETURN_ON_FALSE(h->server, ESP_ERR_INVALID_STATE, TAG, "server not started");
 
-    // For compatibility with older IDF versions, use httpd_unregister_uri if method is HTTP_ANY
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-    return httpd_unregister_uri_handler(h->server, uri, method);
-#else
-    (void)method;
-    httpd_unregister_uri(h->server, uri);
-    return ESP_OK;
-#endif
+    xSemaphoreTake(h->write_lock, portMAX_DELAY);
+    esp_err_t err = table_update(h, NULL, uri, method);
+    xSemaphoreGive(h->write_lock);
+
+    return err;
 }
 
 httpd_handle_t http_hal_native_handle(http_hal_t *h)
@@ -155,6 +1188,68 @@ httpd_handle_t http_hal_native_handle(http_hal_t *h)
     return h ? h->server : NULL;
 }
 
+uint32_t http_hal_peer_ipv4(httpd_req_t *req)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (!req || getpeername(httpd_req_to_sockfd(req), (struct sockaddr *)&addr, &len) != 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET) {
+        return ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    }
+#ifdef AF_INET6
+    // httpd listens on IPv6 when enabled, IPv4 clients show up as ::ffff:a.b.c.d
+    if (addr.ss_family == AF_INET6) {
+        const uint8_t *a = (const uint8_t *)&((struct sockaddr_in6 *)&addr)->sin6_addr;
+        static const uint8_t mapped[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+        if (memcmp(a, mapped, sizeof(mapped)) == 0) {
+            uint32_t v4;
+            memcpy(&v4, a + 12, sizeof(v4));
+            return v4;
+        }
+    }
+#endif
+    return 0;
+}
+
+uint32_t http_hal_request_count(http_hal_t *h)
+{
+    return h ? atomic_load_explicit(&h->requests, memory_order_relaxed) : 0;
+}
+
+esp_err_t http_hal_get_stats(http_hal_t *h, http_hal_stats_t *out)
+{
+    ESP_RETURN_ON_FALSE(h && out, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    memset(out, 0, sizeof(*out));
+
+    out->requests = atomic_load_explicit(&h->requests, memory_order_relaxed);
+    out->open_sockets = (uint32_t)atomic_load(&h->open_sockets);
+    out->in_flight = (uint32_t)atomic_load(&h->in_flight);
+    out->sessions = (uint32_t)h->sessions_len;
+    out->scratch_size = (uint32_t)h->cfg.scratch_size;
+    for (size_t i = 0; i < h->sessions_len; i++) {
+        if (h->sessions[i].arena_peak > out->scratch_peak) out->scratch_peak = (uint32_t)h->sessions[i].arena_peak;
+    }
+
+    // same reader protocol as the dispatcher, the snapshot stays valid until reader_exit()
+    int slot = reader_enter(h);
+    http_hal_table_t *t = atomic_load(&h->table);
+    out->routes = t ? (uint32_t)t->len : 0;
+    reader_exit(h, slot);
+
+#if LONGPOLL_MAX > 0
+    portENTER_CRITICAL(&h->lp_lock);
+    for (size_t i = 0; i < LONGPOLL_MAX; i++) {
+        if (h->waiters[i].state == WAITER_PARKED) out->parked++;
+    }
+    portEXIT_CRITICAL(&h->lp_lock);
+#endif
+    return ESP_OK;
+}
+
+/* ====== Responses ====== */
+
 esp_err_t http_hal_send_json(httpd_req_t *req, int status_code, const char *json)
 {
     ESP_RETURN_ON_FALSE(req && json, ESP_ERR_INVALID_ARG, TAG, "bad args");
@@ -185,3 +1280,311 @@ esp_err_t http_hal_send_err(httpd_req_t *req, int status_code, const char *msg)
     snprintf(buf, sizeof(buf), "{\"error\":\"%s\"}", msg);
     return http_hal_send_json(req, status_code, buf);
 }
+
+/* ====== Chunked writer ====== */
+
+void http_hal_stream_begin(http_hal_stream_t *s, httpd_req_t *req, char *buf, size_t cap, const char *type)
+{
+    s->req = req;
+    s->buf = buf;
+    s->cap = cap;
+    s->len = 0;
+    s->err = ESP_OK;
+    httpd_resp_set_type(req, type);
+}
+
+static void stream_flush(http_hal_stream_t *s)
+{
+    if (s->len > 0 && s->err == ESP_OK) {
+        s->err = httpd_resp_send_chunk(s->req, s->buf, s->len);
+    }
+    s->len = 0;
+}
+
+void http_hal_stream_printf(http_hal_stream_t *s, const char *fmt, ...)
+{
+    // flushing before a fragment that might not fit keeps every fragment whole
+    if (s->cap - s->len < HTTP_HAL_STREAM_FRAGMENT) stream_flush(s);
+    if (s->err != ESP_OK) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(s->buf + s->len, s->cap - s->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        s->len += (size_t)n < s->cap - s->len ? (size_t)n : s->cap - s->len - 1;
+    }
+}
+
+void http_hal_stream_write(http_hal_stream_t *s, const char *data, size_t len)
+{
+    if (len > s->cap - s->len) stream_flush(s);
+    if (s->err != ESP_OK) return;
+
+    if (len >= s->cap) {
+        s->err = httpd_resp_send_chunk(s->req, data, len);
+        return;
+    }
+    memcpy(s->buf + s->len, data, len);
+    s->len += len;
+}
+
+esp_err_t http_hal_stream_end(http_hal_stream_t *s)
+{
+    stream_flush(s);
+    if (s->err != ESP_OK) return s->err;
+    return httpd_resp_send_chunk(s->req, NULL, 0);
+}
+
+/* ====== Conditional GET ====== */
+
+// true if the If-None-Match list contains tag (weak tags compare equal, "*" matches anything)
+static bool etag_listed(const char *list, const char *tag)
+{
+    size_t tag_len = strlen(tag);
+    const char *p = list;
+    while (*p) {
+        p += strspn(p, " \t,");
+        if (!*p) break;
+        if (*p == '*') return true;
+        if (!strncmp(p, "W/", 2)) p += 2;
+        size_t len = strcspn(p, " \t,");
+        if (len == tag_len && !strncmp(p, tag, len)) return true;
+        p += len;
+    }
+    return false;
+}
+
+bool http_hal_etag_check(httpd_req_t *req, uint32_t version)
+{
+    http_hal_t *h = req ? (http_hal_t*)httpd_get_global_user_ctx(req->handle) : NULL;
+    if (!h) return false;
+
+    // httpd keeps a pointer to the header value until the response is sent
+    char *tag = http_hal_scratch_printf(req, "\"%08lx-%lx\"",
+                                        (unsigned long)h->etag_epoch, (unsigned long)version);
+    if (!tag) return false;
+    httpd_resp_set_hdr(req, "ETag", tag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (len == 0 || len > HTTP_HAL_ETAG_HDR_MAX) return false;
+    char *inm = http_hal_scratch_alloc(req, len + 1);
+    if (!inm || httpd_req_get_hdr_value_str(req, "If-None-Match", inm, len + 1) != ESP_OK) {
+        return false;
+    }
+    return etag_listed(inm, tag);
+}
+
+esp_err_t http_hal_send_not_modified(httpd_req_t *req)
+{
+    ESP_RETURN_ON_FALSE(req, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* ====== Scratch arena ====== */
+
+void *http_hal_scratch_alloc(httpd_req_t *req, size_t size)
+{
+    if (!req || !req->sess_ctx) return NULL;
+
+    http_hal_session_t *s = (http_hal_session_t*)req->sess_ctx;
+    size_t cap = s->owner->cfg.scratch_size;
+    size_t need = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+    if (need < size || need > cap - s->arena_used) {
+        ESP_LOGW(TAG, "Scratch arena exhausted (%u + %u > %u)",
+                 (unsigned)s->arena_used, (unsigned)size, (unsigned)cap);
+        return NULL;
+    }
+
+    void *p = s->arena + s->arena_used;
+    s->arena_used += need;
+    return p;
+}
+
+size_t http_hal_scratch_mark(httpd_req_t *req)
+{
+    http_hal_session_t *s = req ? (http_hal_session_t*)req->sess_ctx : NULL;
+    return s ? s->arena_used : 0;
+}
+
+size_t http_hal_scratch_avail(httpd_req_t *req)
+{
+    http_hal_session_t *s = req ? (http_hal_session_t*)req->sess_ctx : NULL;
+    return s ? s->owner->cfg.scratch_size - s->arena_used : 0;
+}
+
+void http_hal_scratch_release(httpd_req_t *req, size_t mark)
+{
+    http_hal_session_t *s = req ? (http_hal_session_t*)req->sess_ctx : NULL;
+    if (!s || mark > s->arena_used) return;
+    if (s->arena_used > s->arena_peak) s->arena_peak = s->arena_used;
+    s->arena_used = mark;
+}
+
+char *http_hal_scratch_printf(httpd_req_t *req, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0) return NULL;
+
+    char *buf = (char*)http_hal_scratch_alloc(req, (size_t)n + 1);
+    if (!buf) return NULL;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    return buf;
+}
+
+char *http_hal_scratch_query(httpd_req_t *req)
+{
+    size_t len = httpd_req_get_url_query_len(req);
+    if (len == 0) return NULL;
+
+    char *buf = (char*)http_hal_scratch_alloc(req, len + 1);
+    if (!buf) return NULL;
+
+    if (httpd_req_get_url_query_str(req, buf, len + 1) != ESP_OK) return NULL;
+    return buf;
+}
+
+char *http_hal_scratch_query_value(httpd_req_t *req, const char *query, const char *key)
+{
+    if (!query || !key) return NULL;
+
+    // find the value length first so the buffer is sized exactly
+    size_t key_len = strlen(key);
+    const char *p = query;
+    while (*p) {
+        const char *end = strchr(p, '&');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > key_len && !strncmp(p, key, key_len) && p[key_len] == '=') {
+            size_t val_len = len - key_len - 1;
+            char *buf = (char*)http_hal_scratch_alloc(req, val_len + 1);
+            if (!buf) return NULL;
+            if (httpd_query_key_value(query, key, buf, val_len + 1) != ESP_OK) return NULL;
+            return buf;
+        }
+        if (len == key_len && !strncmp(p, key, key_len)) {
+            // key present without '=': empty value
+            char *buf = (char*)http_hal_scratch_alloc(req, 1);
+            if (buf) buf[0] = '\0';
+            return buf;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return NULL;
+}
+
+int http_hal_recv(httpd_req_t *req, char *buf, size_t len)
+{
+    for (int tries = 0; ; tries++) {
+        int r = httpd_req_recv(req, buf, len);
+        if (r != HTTPD_SOCK_ERR_TIMEOUT || tries >= HTTP_HAL_RECV_RETRIES) return r;
+        ESP_LOGD(TAG, "Body receive timeout, retrying");
+    }
+}
+
+char *http_hal_scratch_body(httpd_req_t *req, size_t max_len)
+{
+    if (!req || req->content_len == 0 || req->content_len > max_len) return NULL;
+
+    size_t len = req->content_len;
+    char *buf = (char*)http_hal_scratch_alloc(req, len + 1);
+    if (!buf) return NULL;
+
+    size_t got = 0;
+    while (got < len) {
+        int r = http_hal_recv(req, buf + got, len - got);
+        if (r <= 0) return NULL;
+        got += (size_t)r;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+/* ====== Query parsing ====== */
+
+bool http_hal_parse_bool(const char *s, int *out)
+{
+    if (!s || !out) return false;
+
+    if (!strcasecmp(s, "1") || !strcasecmp(s, "on") || !strcasecmp(s, "true"))  { *out = 1; return true; }
+    if (!strcasecmp(s, "0") || !strcasecmp(s, "off") || !strcasecmp(s, "false")) { *out = 0; return true; }
+    return false;
+}
+
+bool http_hal_parse_int(const char *s, int64_t min, int64_t max, int64_t *out)
+{
+    if (!s || !*s || !out) return false;
+
+    char *end = NULL;
+    long long v = strtoll(s, &end, 10);
+    if (*end != '\0' || v < min || v > max) return false;
+
+    *out = v;
+    return true;
+}
+
+/* ====== Allocation stats ====== */
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+static void alloc_slot_read(const http_hal_alloc_slot_t *st, http_hal_alloc_stats_t *out)
+{
+    out->requests = atomic_load_explicit(&st->requests, memory_order_relaxed);
+    out->alloc_requests = atomic_load_explicit(&st->alloc_requests, memory_order_relaxed);
+    out->allocs = atomic_load_explicit(&st->allocs, memory_order_relaxed);
+    out->frees = atomic_load_explicit(&st->frees, memory_order_relaxed);
+    out->bytes = atomic_load_explicit(&st->bytes, memory_order_relaxed);
+    out->last_allocs = atomic_load_explicit(&st->last_allocs, memory_order_relaxed);
+    out->last_bytes = atomic_load_explicit(&st->last_bytes, memory_order_relaxed);
+}
+
+esp_err_t http_hal_get_alloc_stats(http_hal_t *h, const char *uri, httpd_method_t method, http_hal_alloc_stats_t *out)
+{
+    ESP_RETURN_ON_FALSE(h && uri && out, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    // slots are never released, a published one can be read without locking
+    size_t n = atomic_load_explicit(&h->alloc_slots_len, memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+        const http_hal_alloc_slot_t *st = &h->alloc_slots[i];
+        if (st->method == method && !strcmp(st->uri, uri)) {
+            alloc_slot_read(st, out);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t http_hal_alloc_stats_handler(httpd_req_t *req)
+{
+    http_hal_t *h = (http_hal_t*)httpd_get_global_user_ctx(req->handle);
+    ESP_RETURN_ON_FALSE(h, ESP_ERR_INVALID_STATE, TAG, "no hal instance");
+
+    // streamed one slot at a time so the response size doesn't depend on the route count
+    char line[160];
+    size_t n = atomic_load_explicit(&h->alloc_slots_len, memory_order_acquire);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"ok\":true,\"endpoints\":[");
+    for (size_t i = 0; i < n; i++) {
+        const http_hal_alloc_slot_t *st = &h->alloc_slots[i];
+        http_hal_alloc_stats_t a;
+        alloc_slot_read(st, &a);
+        snprintf(line, sizeof(line),
+                 "%s{\"uri\":\"%s\",\"method\":%d,\"requests\":%u,\"alloc_requests\":%u,"
+                 "\"allocs\":%u,\"frees\":%u,\"bytes\":%u}",
+                 i ? "," : "", st->uri, (int)st->method,
+                 (unsigned)a.requests, (unsigned)a.alloc_requests,
+                 (unsigned)a.allocs, (unsigned)a.frees, (unsigned)a.bytes);
+        httpd_resp_sendstr_chunk(req, line);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
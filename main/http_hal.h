@@ -26,8 +26,10 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 #include "esp_http_server.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,20 +53,106 @@ typedef struct http_hal_s http_hal_t;
  */
 typedef esp_err_t (*http_hal_handler_t)(httpd_req_t *req);
 
+/**
+ * @brief State version getter used by long polling
+ */
+typedef uint32_t (*http_hal_version_fn_t)(void);
+
 /**
  * @brief HTTP HAL configuration
  *
  * User-modifiable knobs:
  * - port: Listening port for the HTTP server (0 uses HTTPD_DEFAULT_CONFIG)
  * - lru_purge_enable: Enable LRU purge to free least recently used sessions
- * - max_uri_handlers: Max number of URI handlers (0 uses default)
+ * - max_uri_handlers: Max number of URI handlers in esp_http_server (0 uses
+ *   default). Routes live in the HAL table, httpd only holds one catch-all
+ *   dispatcher per method.
+ * - max_open_sockets: Max number of concurrent connections, which is also the
+ *   size of the session context pool (0 uses default)
+ * - scratch_size: Bytes of scratch arena per session (0 uses
+ *   CONFIG_HTTP_HAL_SCRATCH_SIZE)
+ * - stack_size: Stack size of the httpd task (0 uses default)
+ * - pin_core: Pin the httpd task to core_id (false keeps the default, no
+ *   affinity, so a zeroed config never pins to core 0). Handlers using
+ *   per-core resources such as dedicated GPIO bundles must run on the core
+ *   that created them.
+ * - core_id: Core the httpd task is pinned to when pin_core is set
  */
 typedef struct {
-    int  port;
-    bool lru_purge_enable;
-    int  max_uri_handlers;
+    int    port;
+    bool   lru_purge_enable;
+    int    max_uri_handlers;
+    int    max_open_sockets;
+    size_t scratch_size;
+    size_t stack_size;
+    bool   pin_core;
+    int    core_id;
 } http_hal_config_t;
 
+/**
+ * @brief Per-endpoint heap allocation statistics
+ *
+ * Only available with CONFIG_HTTP_HAL_ALLOC_TRACE. Counters cover heap calls
+ * made by the httpd task while the endpoint handler runs, excluding socket
+ * sends.
+ */
+typedef struct {
+    uint32_t requests;          // requests served
+    uint32_t alloc_requests;    // requests that allocated at least once
+    uint32_t allocs;            // malloc/calloc/realloc calls
+    uint32_t frees;             // free calls
+    uint32_t bytes;             // bytes requested
+    uint32_t last_allocs;       // allocations made by the last request
+    uint32_t last_bytes;        // bytes requested by the last request
+} http_hal_alloc_stats_t;
+
+/**
+ * @brief Result of a graceful drain (see http_hal_stop_graceful())
+ */
+typedef struct {
+    uint32_t drained;       // requests completed during the drain, answered with Connection: close
+    uint32_t idle_closed;   // idle keep-alive connections closed without a pending request
+    uint32_t aborted;       // connections still open at the deadline, cut by the stop
+} http_hal_drain_report_t;
+
+/**
+ * @brief Server statistics (see http_hal_get_stats())
+ */
+typedef struct {
+    uint32_t requests;      // requests dispatched since init
+    uint32_t open_sockets;
+    uint32_t in_flight;     // requests inside a handler
+    uint32_t parked;        // long-poll requests waiting for a change
+    uint32_t routes;
+    uint32_t sessions;      // session contexts (= max open sockets)
+    uint32_t scratch_size;  // scratch arena per session
+    uint32_t scratch_peak;  // highest arena use seen on any session
+} http_hal_stats_t;
+
+/**
+ * @brief Chunked response writer with a caller-provided buffer
+ *
+ * Formatted text is collected in buf and sent as one chunk whenever the next
+ * fragment might not fit, so large responses need only a small fixed buffer.
+ */
+typedef struct {
+    httpd_req_t *req;
+    char        *buf;
+    size_t       cap;
+    size_t       len;
+    esp_err_t    err;       // first send error, later output is dropped
+} http_hal_stream_t;
+
+/**
+ * @brief Socket timeouts tolerated by http_hal_recv() before giving up
+ */
+#define HTTP_HAL_RECV_RETRIES 1
+
+/**
+ * @brief Longest fragment a single http_hal_stream_printf() call may produce
+ */
+#define HTTP_HAL_STREAM_FRAGMENT 96
+
 /**
  * @brief HTTP endpoint descriptor
  *
@@ -119,6 +207,24 @@ esp_err_t http_hal_start(http_hal_t *h);
  */
 esp_err_t http_hal_stop(http_hal_t *h);
 
+/**
+ * @brief Drain in-flight requests, then stop the HTTP server
+ *
+ * New connections are refused immediately. Requests being served (and requests
+ * arriving on already open keep-alive connections) complete normally, with
+ * Connection: close on their response. Idle connections are closed after
+ * CONFIG_HTTP_HAL_DRAIN_IDLE_MS. Whatever is still open at the deadline is cut
+ * by the stop and reported as aborted.
+ *
+ * Must not be called from an endpoint handler (the httpd task).
+ *
+ * @param[in]  h          HAL instance
+ * @param[in]  timeout_ms Drain deadline in milliseconds
+ * @param[out] report     Optional drain statistics (can be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t http_hal_stop_graceful(http_hal_t *h, uint32_t timeout_ms, http_hal_drain_report_t *report);
+
 /**
  * @brief Deinitialize the HTTP HAL instance
  *
@@ -131,13 +237,17 @@ void http_hal_deinit(http_hal_t *h);
 /**
  * @brief Register an HTTP endpoint (URI handler)
  *
- * This function can be called before or after http_hal_start().
- * - If called before start: the endpoint is stored and registered on start.
- * - If called after start: the endpoint is registered immediately.
+ * This function can be called before or after http_hal_start() and from any
+ * task. Routes are kept in an immutable table snapshot: every change builds a
+ * new snapshot and publishes it atomically, so requests being served are never
+ * paused and never see a partially updated table. Registering an existing
+ * uri/method pair replaces its handler.
  *
  * Notes:
  * - ep->uri must remain valid for the lifetime of the server (static string
  *   literal recommended).
+ * - ep->uri may contain wildcards as understood by httpd_uri_match_wildcard()
+ *   (e.g. a trailing "*" to match a prefix).
  *
  * @param[in] h  HAL instance
  * @param[in] ep Endpoint descriptor
@@ -148,12 +258,15 @@ esp_err_t http_hal_register_endpoint(http_hal_t *h, const http_hal_endpoint_t *e
 /**
  * @brief Unregister an HTTP endpoint
  *
- * This function requires the server to be running.
+ * The endpoint is removed from the route table, so it stays removed across
+ * stop/start cycles. Can be called whether or not the server is running.
  *
  * @param[in] h      HAL instance
  * @param[in] uri    Endpoint URI to unregister
  * @param[in] method HTTP method of the endpoint
- * @return ESP_OK on success
+ * Counters are kept per (uri, method) and survive unregistering the endpoint.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the endpoint was never registered
  */
 esp_err_t http_hal_unregister_endpoint(http_hal_t *h, const char *uri, httpd_method_t method);
 
@@ -167,6 +280,38 @@ esp_err_t http_hal_unregister_endpoint(http_hal_t *h, const char *uri, httpd_met
  */
 httpd_handle_t http_hal_native_handle(http_hal_t *h);
 
+/**
+ * @brief Number of requests dispatched since init, including 404/405 answers
+ *
+ * The counter wraps; rates are obtained from the difference of two readings.
+ *
+ * @param[in] h HAL instance
+ * @return Request count, 0 if h is NULL
+ */
+uint32_t http_hal_request_count(http_hal_t *h);
+
+/**
+ * @brief Get server statistics
+ *
+ * Counters are read without stopping the server, each one is consistent on
+ * its own.
+ *
+ * @param[in]  h   HAL instance
+ * @param[out] out Returned statistics
+ * @return ESP_OK on success
+ */
+esp_err_t http_hal_get_stats(http_hal_t *h, http_hal_stats_t *out);
+
+/**
+ * @brief IPv4 address of the client of a request
+ *
+ * IPv4-mapped IPv6 peers are converted; native IPv6 peers give 0.
+ *
+ * @param[in] req Request
+ * @return Address in network byte order, 0 if unknown
+ */
+uint32_t http_hal_peer_ipv4(httpd_req_t *req);
+
 /**
  * @brief Send a JSON response with a specific HTTP status code
  *
@@ -194,6 +339,295 @@ esp_err_t http_hal_send_json(httpd_req_t *req, int status_code, const char *json
  */
 esp_err_t http_hal_send_err(httpd_req_t *req, int status_code, const char *msg);
 
+/**
+ * @brief Longest wait accepted by the long-poll endpoints
+ */
+#define HTTP_HAL_LONGPOLL_MAX_MS 60000
+
+/**
+ * @brief Answer a request when a state version moves past since
+ *
+ * If version() already differs from since, or timeout_ms is 0, respond is
+ * called right away. Otherwise the request is detached from the httpd task
+ * (httpd_req_async_handler_begin()) and parked, so the server keeps serving
+ * other clients; respond is later called from the long-poll task with the
+ * detached request, as soon as the version changes (see
+ * http_hal_longpoll_wake()) or the timeout elapses. respond must build the
+ * reply from the current state only, it may use the scratch arena.
+ * When CONFIG_HTTP_HAL_LONGPOLL_MAX requests are already parked the request
+ * is answered at once.
+ *
+ * Parking allocates the detached request copy from the heap (esp_http_server
+ * gives no way to provide it), also with CONFIG_HTTP_HAL_STATIC_POOL. It is
+ * freed when the reply is sent and is not counted by CONFIG_HTTP_HAL_ALLOC_TRACE.
+ *
+ * @param[in] req        Incoming HTTP request
+ * @param[in] since      Version the client already has
+ * @param[in] timeout_ms Longest wait
+ * @param[in] version    Current version getter, must not block
+ * @param[in] respond    Handler sending the reply
+ * @return ESP_OK if parked, otherwise the result of respond
+ */
+esp_err_t http_hal_longpoll(httpd_req_t *req, uint32_t since, uint32_t timeout_ms,
+                            http_hal_version_fn_t version, http_hal_handler_t respond);
+
+/**
+ * @brief Make parked long-poll requests re-check their version
+ *
+ * Cheap and non-blocking: call it from state change hooks.
+ *
+ * @param[in] h HAL instance
+ */
+void http_hal_longpoll_wake(http_hal_t *h);
+
+/**
+ * @brief Detach a request so it can be answered from another task
+ *
+ * For long-running responses (streams): the handler validates the request,
+ * detaches it and hands *out to its own worker task, then returns ESP_OK so
+ * the httpd task keeps serving other clients. The worker answers through
+ * *out and must call http_hal_detach_end() when done. The scratch arena
+ * stays with the request: allocations made before detaching remain valid and
+ * the worker may allocate more; http_hal_detach_end() resets it.
+ *
+ * Like parking a long-poll request, this allocates the detached copy from
+ * the heap, outside CONFIG_HTTP_HAL_STATIC_POOL and CONFIG_HTTP_HAL_ALLOC_TRACE.
+ *
+ * @param[in]  req Incoming HTTP request
+ * @param[out] out Detached copy, owned by the caller until http_hal_detach_end()
+ * @return ESP_OK, ESP_ERR_INVALID_STATE while draining or stopping (answer
+ *         on the httpd task then), or the error of httpd_req_async_handler_begin()
+ */
+esp_err_t http_hal_detach(httpd_req_t *req, httpd_req_t **out);
+
+/**
+ * @brief Release a request detached with http_hal_detach()
+ *
+ * @param[in] req    Detached copy
+ * @param[in] result Result of the response, the connection is closed unless ESP_OK
+ * @return ESP_OK on success
+ */
+esp_err_t http_hal_detach_end(httpd_req_t *req, esp_err_t result);
+
+/**
+ * @brief Whether the server is draining or stopping
+ *
+ * Long-running responses check it between chunks and end early, so
+ * http_hal_stop() does not have to wait for them.
+ *
+ * @param[in] req HTTP request, detached or not
+ * @return true if the response should end now
+ */
+bool http_hal_ending(httpd_req_t *req);
+
+/**
+ * @brief Start a chunked response
+ *
+ * @param[out] s    Writer
+ * @param[in]  req  Incoming HTTP request
+ * @param[in]  buf  Buffer, larger than HTTP_HAL_STREAM_FRAGMENT
+ * @param[in]  cap  Buffer size
+ * @param[in]  type Content type
+ */
+void http_hal_stream_begin(http_hal_stream_t *s, httpd_req_t *req, char *buf, size_t cap, const char *type);
+
+/**
+ * @brief Append formatted text (at most HTTP_HAL_STREAM_FRAGMENT bytes per call)
+ */
+void http_hal_stream_printf(http_hal_stream_t *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Append raw bytes of any length
+ */
+void http_hal_stream_write(http_hal_stream_t *s, const char *data, size_t len);
+
+/**
+ * @brief Send what is buffered and terminate the chunked response
+ *
+ * @return ESP_OK, or the first send error
+ */
+esp_err_t http_hal_stream_end(http_hal_stream_t *s);
+
+/**
+ * @brief Longest If-None-Match header compared by http_hal_etag_check()
+ */
+#define HTTP_HAL_ETAG_HDR_MAX 128
+
+/**
+ * @brief Conditional GET against a state version
+ *
+ * Sets the response ETag to a tag derived from version and a value drawn at
+ * init (so tags of a previous boot never match), with Cache-Control:
+ * no-cache, then compares it with the If-None-Match request header. Read the
+ * version before the state it covers: a stale tag only costs a full reply.
+ *
+ * @param[in] req     Incoming HTTP request
+ * @param[in] version State version, changed on every state change
+ * @return true if the client already holds this version and the handler
+ *         should answer with http_hal_send_not_modified()
+ */
+bool http_hal_etag_check(httpd_req_t *req, uint32_t version);
+
+/**
+ * @brief Send a bodiless 304 Not Modified response
+ *
+ * @param[in] req Incoming HTTP request
+ * @return ESP_OK on success
+ */
+esp_err_t http_hal_send_not_modified(httpd_req_t *req);
+
+/**
+ * @brief Allocate memory from the request-scoped scratch arena
+ *
+ * Every connection is bound to a session context taken from a pool that is
+ * preallocated by http_hal_init(). Each session owns a bump-pointer arena which
+ * is reset after every request, so memory returned here is valid only until
+ * the handler returns and must never be freed.
+ *
+ * Notes:
+ * - Only valid inside handlers registered through http_hal_register_endpoint().
+ * - req->sess_ctx is owned by the HAL and must not be replaced by handlers.
+ *
+ * @param[in] req  Incoming HTTP request
+ * @param[in] size Number of bytes to allocate
+ * @return Pointer to 8-byte aligned memory, or NULL if the arena is exhausted
+ */
+void *http_hal_scratch_alloc(httpd_req_t *req, size_t size);
+
+/**
+ * @brief Current fill level of the scratch arena
+ *
+ * Pass the value to http_hal_scratch_release() to free everything allocated
+ * after this call, e.g. per item of a loop within one request.
+ *
+ * @param[in] req Incoming HTTP request
+ * @return Opaque mark
+ */
+size_t http_hal_scratch_mark(httpd_req_t *req);
+
+/**
+ * @brief Bytes still free in the scratch arena
+ *
+ * Lets a handler refuse a request (e.g. with 413) before reading a body that
+ * would not fit.
+ *
+ * @param[in] req Incoming HTTP request
+ * @return Largest size http_hal_scratch_alloc() can currently return
+ */
+size_t http_hal_scratch_avail(httpd_req_t *req);
+
+/**
+ * @brief Free scratch allocations made since http_hal_scratch_mark()
+ *
+ * @param[in] req  Incoming HTTP request
+ * @param[in] mark Value returned by http_hal_scratch_mark()
+ */
+void http_hal_scratch_release(httpd_req_t *req, size_t mark);
+
+/**
+ * @brief Format a string into the request-scoped scratch arena
+ *
+ * The buffer is sized exactly for the formatted output.
+ *
+ * @param[in] req Incoming HTTP request
+ * @param[in] fmt printf-style format string
+ * @return Null-terminated string, or NULL if the arena is exhausted
+ */
+char *http_hal_scratch_printf(httpd_req_t *req, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Copy the URL query string into the scratch arena
+ *
+ * @param[in] req Incoming HTTP request
+ * @return Null-terminated query string, or NULL if the URL has no query or the
+ *         arena is exhausted
+ */
+char *http_hal_scratch_query(httpd_req_t *req);
+
+/**
+ * @brief Extract a query parameter value into the scratch arena
+ *
+ * The buffer is sized exactly for the value found in the query string.
+ *
+ * @param[in] req   Incoming HTTP request
+ * @param[in] query Query string (e.g. from http_hal_scratch_query())
+ * @param[in] key   Parameter name
+ * @return Null-terminated value, or NULL if the key is missing or the arena is
+ *         exhausted
+ */
+char *http_hal_scratch_query_value(httpd_req_t *req, const char *query, const char *key);
+
+/**
+ * @brief Receive part of the request body, tolerating a bounded stall
+ *
+ * Like httpd_req_recv(), but a socket timeout (recv_wait_timeout) is retried
+ * at most HTTP_HAL_RECV_RETRIES times, so a client that stops sending cannot
+ * hold the httpd task.
+ *
+ * @param[in]  req Incoming HTTP request
+ * @param[out] buf Destination
+ * @param[in]  len Bytes wanted
+ * @return Bytes received (> 0), or <= 0 on error, closed socket or stall
+ */
+int http_hal_recv(httpd_req_t *req, char *buf, size_t len);
+
+/**
+ * @brief Read the whole request body into the scratch arena
+ *
+ * @param[in] req     Incoming HTTP request
+ * @param[in] max_len Largest accepted body
+ * @return Null-terminated body, or NULL if it is empty, longer than max_len,
+ *         the arena is exhausted or the socket fails
+ */
+char *http_hal_scratch_body(httpd_req_t *req, size_t max_len);
+
+/**
+ * @brief Parse a boolean query value
+ *
+ * Accepts 1/on/true and 0/off/false (case-insensitive).
+ *
+ * @param[in]  s   Value string
+ * @param[out] out 1 or 0
+ * @return true if the value was recognised
+ */
+bool http_hal_parse_bool(const char *s, int *out);
+
+/**
+ * @brief Parse a decimal integer query value with range check
+ *
+ * @param[in]  s   Value string
+ * @param[in]  min Minimum accepted value
+ * @param[in]  max Maximum accepted value
+ * @param[out] out Parsed value
+ * @return true if the whole string is a number within [min, max]
+ */
+bool http_hal_parse_int(const char *s, int64_t min, int64_t max, int64_t *out);
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+/**
+ * @brief Get heap allocation statistics of an endpoint
+ *
+ * @param[in]  h      HAL instance
+ * @param[in]  uri    Endpoint URI
+ * @param[in]  method HTTP method of the endpoint
+ * @param[out] out    Returned statistics
+ * Counters are kept per (uri, method) and survive unregistering the endpoint.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the endpoint was never registered
+ */
+esp_err_t http_hal_get_alloc_stats(http_hal_t *h, const char *uri, httpd_method_t method, http_hal_alloc_stats_t *out);
+
+/**
+ * @brief Ready-made handler reporting allocation statistics of every endpoint as JSON
+ *
+ * Register it like any other endpoint (e.g. GET /api/hal/alloc).
+ *
+ * @param[in] req Incoming HTTP request
+ * @return ESP_OK on success
+ */
+esp_err_t http_hal_alloc_stats_handler(httpd_req_t *req);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,520 @@
+#include "http_hal_rpc.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "HTTP_HAL_RPC";
+
+#define RPC_METHODS   CONFIG_HTTP_HAL_RPC_METHODS
+#define RPC_TOKENS    CONFIG_HTTP_HAL_RPC_TOKENS
+#define RPC_BODY_MAX  CONFIG_HTTP_HAL_RPC_BODY_MAX
+#define RPC_DEPTH     8
+#define OUT_BUF       192
+#define NUM_MAX       24
+
+#define PARSE_SYNTAX  (-1)
+#define PARSE_FULL    (-2)
+
+_Static_assert(RPC_BODY_MAX < UINT16_MAX, "token offsets are 16 bit");
+
+typedef enum { TOK_OBJ, TOK_ARR, TOK_STR, TOK_PRIM } tok_type_t;
+typedef enum { WANT_VALUE, WANT_KEY, WANT_COLON, WANT_NEXT } want_t;
+
+// offsets into the body; strings exclude their quotes
+typedef struct {
+    uint8_t  type;
+    uint16_t start;
+    uint16_t end;
+    uint16_t next;      // token after this value and all its children
+} rpc_tok_t;
+
+typedef struct {
+    http_hal_t        *h;
+    const char        *name;
+    http_hal_rpc_fn_t  fn;
+    void              *ctx;
+} rpc_method_t;
+
+struct http_hal_rpc_call {
+    httpd_req_t     *req;
+    const char      *js;
+    const rpc_tok_t *toks;
+    int              params;    // token of the params object, -1 if absent
+    const char      *result;
+    int              err_code;
+    const char      *err_msg;
+};
+
+typedef struct {
+    http_hal_t        *h;
+    httpd_req_t       *req;
+    const char        *body;
+    size_t             len;
+    bool               batch;
+    size_t             replies;
+    http_hal_stream_t  out;
+    rpc_tok_t          toks[RPC_TOKENS];
+    char               buf[OUT_BUF];
+} rpc_batch_t;
+
+static rpc_method_t s_methods[RPC_METHODS];
+static atomic_size_t s_method_count;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ====== Tokenizer ====== */
+
+static size_t skip_ws(const char *js, size_t len, size_t p)
+{
+    while (p < len && (js[p] == ' ' || js[p] == '\t' || js[p] == '\r' || js[p] == '\n')) p++;
+    return p;
+}
+
+// p is on the opening quote; returns the closing quote, or 0 if malformed
+static size_t scan_string(const char *js, size_t len, size_t p)
+{
+    for (p++; p < len; p++) {
+        unsigned char c = (unsigned char)js[p];
+        if (c == '"') return p;
+        if (c < 0x20) return 0;
+        if (c != '\\') continue;
+        if (++p >= len || js[p] == '\0' || !strchr("\"\\/bfnrtu", js[p])) return 0;
+        if (js[p] == 'u') {
+            for (int i = 0; i < 4; i++) {
+                if (++p >= len || !isxdigit((unsigned char)js[p])) return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+static bool valid_number(const char *s, size_t n)
+{
+    size_t i = 0;
+    if (i < n && s[i] == '-') i++;
+    if (i >= n || !isdigit((unsigned char)s[i])) return false;
+    if (s[i] == '0') i++;
+    else while (i < n && isdigit((unsigned char)s[i])) i++;
+    if (i < n && s[i] == '.') {
+        if (++i >= n || !isdigit((unsigned char)s[i])) return false;
+        while (i < n && isdigit((unsigned char)s[i])) i++;
+    }
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        if (++i < n && (s[i] == '+' || s[i] == '-')) i++;
+        if (i >= n || !isdigit((unsigned char)s[i])) return false;
+        while (i < n && isdigit((unsigned char)s[i])) i++;
+    }
+    return i == n;
+}
+
+// returns the end of a number, true, false or null at p, or 0
+static size_t scan_primitive(const char *js, size_t len, size_t p)
+{
+    size_t q = p;
+    while (q < len && (isalnum((unsigned char)js[q]) || js[q] == '-' || js[q] == '+' || js[q] == '.')) q++;
+    size_t n = q - p;
+    if (n == 4 && (!memcmp(js + p, "true", 4) || !memcmp(js + p, "null", 4))) return q;
+    if (n == 5 && !memcmp(js + p, "false", 5)) return q;
+    return valid_number(js + p, n) ? q : 0;
+}
+
+static int tok_push(rpc_tok_t *toks, int max, int n, tok_type_t type, size_t start, size_t end)
+{
+    if (!toks) return n + 1;
+    if (n >= max) return PARSE_FULL;
+    toks[n] = (rpc_tok_t){ .type = type, .start = (uint16_t)start, .end = (uint16_t)end, .next = (uint16_t)(n + 1) };
+    return n + 1;
+}
+
+/*
+ * Tokenize the JSON value starting at js[*pos] and move *pos past it.
+ * Without toks the syntax is only checked, so a whole batch can be validated
+ * before anything runs. Returns the token count, PARSE_SYNTAX or PARSE_FULL.
+ */
+static int tokenize(const char *js, size_t len, size_t *pos, rpc_tok_t *toks, int max)
+{
+    int open[RPC_DEPTH];
+    uint8_t kind[RPC_DEPTH];
+    int depth = 0, n = 0;
+    want_t want = WANT_VALUE;
+    bool may_close = false;     // right after '{' or '['
+    size_t p = *pos;
+
+    for (;;) {
+        p = skip_ws(js, len, p);
+        if (p >= len) return PARSE_SYNTAX;
+        char c = js[p];
+
+        if ((c == '}' || c == ']') && (want == WANT_NEXT || may_close)) {
+            if (depth == 0 || (c == '}') != (kind[depth - 1] == TOK_OBJ)) return PARSE_SYNTAX;
+            int o = open[--depth];
+            if (toks) {
+                toks[o].end = (uint16_t)(p + 1);
+                toks[o].next = (uint16_t)n;
+            }
+            p++;
+        } else if (want == WANT_NEXT) {
+            if (c != ',') return PARSE_SYNTAX;
+            want = kind[depth - 1] == TOK_OBJ ? WANT_KEY : WANT_VALUE;
+            p++;
+            continue;
+        } else if (want == WANT_COLON) {
+            if (c != ':') return PARSE_SYNTAX;
+            want = WANT_VALUE;
+            p++;
+            continue;
+        } else if (want == WANT_KEY) {
+            size_t q = c == '"' ? scan_string(js, len, p) : 0;
+            if (!q) return PARSE_SYNTAX;
+            if ((n = tok_push(toks, max, n, TOK_STR, p + 1, q)) < 0) return n;
+            want = WANT_COLON;
+            may_close = false;
+            p = q + 1;
+            continue;
+        } else if (c == '{' || c == '[') {
+            if (depth == RPC_DEPTH) return PARSE_SYNTAX;
+            kind[depth] = c == '{' ? TOK_OBJ : TOK_ARR;
+            open[depth] = n;
+            if ((n = tok_push(toks, max, n, kind[depth], p, p)) < 0) return n;
+            depth++;
+            want = c == '{' ? WANT_KEY : WANT_VALUE;
+            may_close = true;
+            p++;
+            continue;
+        } else if (c == '"') {
+            size_t q = scan_string(js, len, p);
+            if (!q) return PARSE_SYNTAX;
+            if ((n = tok_push(toks, max, n, TOK_STR, p + 1, q)) < 0) return n;
+            p = q + 1;
+        } else {
+            size_t q = scan_primitive(js, len, p);
+            if (!q) return PARSE_SYNTAX;
+            if ((n = tok_push(toks, max, n, TOK_PRIM, p, q)) < 0) return n;
+            p = q;
+        }
+
+        // a complete value
+        may_close = false;
+        if (depth == 0) {
+            *pos = p;
+            return n;
+        }
+        want = WANT_NEXT;
+    }
+}
+
+static bool tok_eq(const char *js, const rpc_tok_t *t, const char *s)
+{
+    size_t n = strlen(s);
+    return (size_t)(t->end - t->start) == n && !memcmp(js + t->start, s, n);
+}
+
+// value token of key in object obj, or -1
+static int obj_get(const char *js, const rpc_tok_t *toks, int obj, const char *key)
+{
+    if (obj < 0 || toks[obj].type != TOK_OBJ) return -1;
+    for (int i = obj + 1; i < toks[obj].next; i = toks[i + 1].next) {
+        if (tok_eq(js, &toks[i], key)) return i + 1;
+    }
+    return -1;
+}
+
+/* ====== Method registry ====== */
+
+esp_err_t http_hal_rpc_register_method(http_hal_t *h, const char *name, http_hal_rpc_fn_t fn, void *ctx)
+{
+    ESP_RETURN_ON_FALSE(h && name && fn, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    size_t n = atomic_load_explicit(&s_method_count, memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+        if (s_methods[i].h == h && !strcmp(s_methods[i].name, name)) {
+            err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+    }
+    if (err == ESP_ERR_NO_MEM && n < RPC_METHODS) {
+        s_methods[n] = (rpc_method_t){ .h = h, .name = name, .fn = fn, .ctx = ctx };
+        atomic_store_explicit(&s_method_count, n + 1, memory_order_release);
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_RETURN_ON_ERROR(err, TAG, "cannot register method %s", name);
+    ESP_LOGD(TAG, "Method %s registered", name);
+    return ESP_OK;
+}
+
+static const rpc_method_t *find_method(http_hal_t *h, const char *js, const rpc_tok_t *name)
+{
+    size_t n = atomic_load_explicit(&s_method_count, memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+        if (s_methods[i].h == h && tok_eq(js, name, s_methods[i].name)) return &s_methods[i];
+    }
+    return NULL;
+}
+
+/* ====== Call API ====== */
+
+httpd_req_t *http_hal_rpc_req(http_hal_rpc_call_t *call)
+{
+    return call->req;
+}
+
+bool http_hal_rpc_has_param(http_hal_rpc_call_t *call, const char *key)
+{
+    return obj_get(call->js, call->toks, call->params, key) >= 0;
+}
+
+const char *http_hal_rpc_param_str(http_hal_rpc_call_t *call, const char *key)
+{
+    int v = obj_get(call->js, call->toks, call->params, key);
+    if (v < 0 || call->toks[v].type != TOK_STR) return NULL;
+
+    // unescaping never makes a string longer
+    const char *s = call->js + call->toks[v].start;
+    size_t n = call->toks[v].end - call->toks[v].start;
+    char *out = (char *)http_hal_scratch_alloc(call->req, n + 1);
+    if (!out) return NULL;
+
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] != '\\') {
+            out[o++] = s[i];
+            continue;
+        }
+        char e = s[++i];
+        switch (e) {
+        case 'b': out[o++] = '\b'; break;
+        case 'f': out[o++] = '\f'; break;
+        case 'n': out[o++] = '\n'; break;
+        case 'r': out[o++] = '\r'; break;
+        case 't': out[o++] = '\t'; break;
+        case 'u': {
+            // only ASCII is kept, the tokenizer checked the 4 hex digits
+            char hex[5] = { s[i + 1], s[i + 2], s[i + 3], s[i + 4], '\0' };
+            unsigned long cp = strtoul(hex, NULL, 16);
+            out[o++] = cp > 0 && cp < 0x80 ? (char)cp : '?';
+            i += 4;
+            break;
+        }
+        default: out[o++] = e; break;
+        }
+    }
+    out[o] = '\0';
+    return out;
+}
+
+// copy a primitive into buf, false if missing, not a primitive or too long
+static bool param_prim(http_hal_rpc_call_t *call, const char *key, char *buf, size_t cap)
+{
+    int v = obj_get(call->js, call->toks, call->params, key);
+    if (v < 0 || call->toks[v].type != TOK_PRIM) return false;
+
+    size_t n = call->toks[v].end - call->toks[v].start;
+    if (n >= cap) return false;
+    memcpy(buf, call->js + call->toks[v].start, n);
+    buf[n] = '\0';
+    return true;
+}
+
+bool http_hal_rpc_param_int(http_hal_rpc_call_t *call, const char *key, int64_t min, int64_t max, int64_t *out)
+{
+    char buf[NUM_MAX];
+    return param_prim(call, key, buf, sizeof(buf)) && http_hal_parse_int(buf, min, max, out);
+}
+
+bool http_hal_rpc_param_bool(http_hal_rpc_call_t *call, const char *key, int *out)
+{
+    char buf[NUM_MAX];
+    if (!param_prim(call, key, buf, sizeof(buf)) || !strcmp(buf, "null")) return false;
+    return http_hal_parse_bool(buf, out);
+}
+
+esp_err_t http_hal_rpc_result(http_hal_rpc_call_t *call, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0) return ESP_ERR_INVALID_ARG;
+
+    char *buf = (char *)http_hal_scratch_alloc(call->req, (size_t)n + 1);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    call->result = buf;
+    return ESP_OK;
+}
+
+esp_err_t http_hal_rpc_error(http_hal_rpc_call_t *call, int code, const char *msg)
+{
+    call->err_code = code;
+    call->err_msg = msg;
+    return ESP_FAIL;
+}
+
+/* ====== Handler ====== */
+
+static void stream_str(http_hal_stream_t *o, const char *s)
+{
+    http_hal_stream_write(o, s, strlen(s));
+}
+
+// one response object; id is raw JSON (NULL: null)
+static void reply(rpc_batch_t *b, const char *id, size_t id_len, const http_hal_rpc_call_t *call)
+{
+    http_hal_stream_t *o = &b->out;
+    if (b->batch) stream_str(o, b->replies ? "," : "[");
+    b->replies++;
+
+    stream_str(o, "{\"jsonrpc\":\"2.0\",\"id\":");
+    if (id) http_hal_stream_write(o, id, id_len);
+    else stream_str(o, "null");
+
+    if (call->err_code) {
+        http_hal_stream_printf(o, ",\"error\":{\"code\":%d,\"message\":\"", call->err_code);
+        stream_str(o, call->err_msg ? call->err_msg : "");
+        stream_str(o, "\"}}");
+    } else {
+        stream_str(o, ",\"result\":");
+        stream_str(o, call->result ? call->result : "null");
+        stream_str(o, "}");
+    }
+}
+
+static void reply_error(rpc_batch_t *b, const char *id, size_t id_len, int code, const char *msg)
+{
+    http_hal_rpc_call_t call = { .err_code = code, .err_msg = msg };
+    reply(b, id, id_len, &call);
+}
+
+// run the call at *pos and move past it
+static void run_call(rpc_batch_t *b, size_t *pos)
+{
+    const char *js = b->body;
+    rpc_tok_t *t = b->toks;
+    size_t p = *pos;
+
+    int n = tokenize(js, b->len, &p, t, RPC_TOKENS);
+    if (n == PARSE_FULL) {
+        // the body was validated already, only the token array is too small
+        tokenize(js, b->len, pos, NULL, 0);
+        reply_error(b, NULL, 0, HTTP_HAL_RPC_INVALID_REQUEST, "Call too large (HTTP_HAL_RPC_TOKENS)");
+        return;
+    }
+    *pos = p;
+    if (n < 0 || t[0].type != TOK_OBJ) {
+        reply_error(b, NULL, 0, HTTP_HAL_RPC_INVALID_REQUEST, "Invalid Request");
+        return;
+    }
+
+    // the id is echoed as written: a string with its quotes, a number or null
+    int id = obj_get(js, t, 0, "id");
+    const char *id_str = NULL;
+    size_t id_len = 0;
+    if (id >= 0) {
+        bool quoted = t[id].type == TOK_STR;
+        if (!quoted && (t[id].type != TOK_PRIM || js[t[id].start] == 't' || js[t[id].start] == 'f')) {
+            reply_error(b, NULL, 0, HTTP_HAL_RPC_INVALID_REQUEST, "Invalid id");
+            return;
+        }
+        id_str = js + t[id].start - quoted;
+        id_len = t[id].end - t[id].start + 2 * quoted;
+    }
+
+    int ver = obj_get(js, t, 0, "jsonrpc");
+    int method = obj_get(js, t, 0, "method");
+    int params = obj_get(js, t, 0, "params");
+    if (ver < 0 || t[ver].type != TOK_STR || !tok_eq(js, &t[ver], "2.0") ||
+        method < 0 || t[method].type != TOK_STR) {
+        reply_error(b, id_str, id_len, HTTP_HAL_RPC_INVALID_REQUEST, "Invalid Request");
+        return;
+    }
+
+    http_hal_rpc_call_t call = { .req = b->req, .js = js, .toks = t, .params = params };
+    const rpc_method_t *m = find_method(b->h, js, &t[method]);
+    if (!m) {
+        http_hal_rpc_error(&call, HTTP_HAL_RPC_METHOD_NOT_FOUND, "Method not found");
+    } else if (params >= 0 && t[params].type != TOK_OBJ) {
+        http_hal_rpc_error(&call, HTTP_HAL_RPC_INVALID_PARAMS, "Only named params are supported");
+    } else {
+        // everything the method puts in the arena is dropped once its reply is out
+        size_t mark = http_hal_scratch_mark(b->req);
+        esp_err_t err = m->fn(&call, m->ctx);
+        if (err != ESP_OK && !call.err_code) {
+            http_hal_rpc_error(&call, HTTP_HAL_RPC_SERVER_ERROR, esp_err_to_name(err));
+        }
+        // notifications (no id) get no reply
+        if (id >= 0) reply(b, id_str, id_len, &call);
+        http_hal_scratch_release(b->req, mark);
+        return;
+    }
+    if (id >= 0) reply(b, id_str, id_len, &call);
+}
+
+esp_err_t http_hal_rpc_handler(httpd_req_t *req)
+{
+    if (req->content_len == 0) {
+        return http_hal_send_err(req, 400, "Missing body");
+    }
+    if (req->content_len > RPC_BODY_MAX) {
+        return http_hal_send_err(req, 413, "Body too long (HTTP_HAL_RPC_BODY_MAX)");
+    }
+    // the body is parsed in place: it needs its own size plus a terminator in the arena
+    if (req->content_len >= http_hal_scratch_avail(req)) {
+        return http_hal_send_err(req, 413, "Body too long (HTTP_HAL_SCRATCH_SIZE)");
+    }
+    char *body = http_hal_scratch_body(req, RPC_BODY_MAX);
+    if (!body) {
+        return http_hal_send_err(req, 500, "Cannot read body");
+    }
+
+    // RPC_TOKENS * 8 + OUT_BUF bytes of stack, the arena is left to the body and the methods
+    rpc_batch_t batch = {
+        .h = (http_hal_t *)req->user_ctx,
+        .req = req,
+        .body = body,
+        .len = req->content_len,
+    };
+    rpc_batch_t *b = &batch;
+    http_hal_stream_begin(&b->out, req, b->buf, sizeof(b->buf), "application/json");
+
+    // a batch with a syntax error anywhere runs nothing
+    size_t pos = skip_ws(body, b->len, 0);
+    size_t end = pos;
+    if (tokenize(body, b->len, &end, NULL, 0) < 0 || skip_ws(body, b->len, end) != b->len) {
+        reply_error(b, NULL, 0, HTTP_HAL_RPC_PARSE_ERROR, "Parse error");
+        return http_hal_stream_end(&b->out);
+    }
+
+    if (body[pos] != '[') {
+        run_call(b, &pos);
+    } else if (body[skip_ws(body, b->len, pos + 1)] == ']') {
+        reply_error(b, NULL, 0, HTTP_HAL_RPC_INVALID_REQUEST, "Empty batch");
+    } else {
+        b->batch = true;
+        pos++;
+        do {
+            run_call(b, &pos);
+            pos = skip_ws(body, b->len, pos);
+        } while (body[pos++] == ',');
+        if (b->replies) stream_str(&b->out, "]");
+    }
+
+    if (b->replies == 0) {
+        httpd_resp_set_status(req, "204 No Content");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    return http_hal_stream_end(&b->out);
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file http_hal_rpc.h
+ * @brief JSON-RPC 2.0 methods on top of http_hal
+ * Modules register named methods; one POST carrying a single call or a batch
+ * (array) of calls runs them all and returns one response, so a client that
+ * sets several outputs and applies a scene needs one round trip instead of
+ * one per operation. The body is read into the scratch arena, checked once
+ * and tokenized in place call by call (no copies, no heap); parameters are
+ * looked up by name in the tokens of the current call and method results are
+ * formatted into the scratch arena, which is rewound after every call.
+ * Only named parameters (params object) are supported.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* JSON-RPC 2.0 error codes */
+#define HTTP_HAL_RPC_PARSE_ERROR      (-32700)
+#define HTTP_HAL_RPC_INVALID_REQUEST  (-32600)
+#define HTTP_HAL_RPC_METHOD_NOT_FOUND (-32601)
+#define HTTP_HAL_RPC_INVALID_PARAMS   (-32602)
+#define HTTP_HAL_RPC_INTERNAL_ERROR   (-32603)
+#define HTTP_HAL_RPC_SERVER_ERROR     (-32000)
+
+/**
+ * @brief One call being executed (valid only inside the method)
+ */
+typedef struct http_hal_rpc_call http_hal_rpc_call_t;
+
+/**
+ * @brief Method implementation
+ *
+ * Set the result with http_hal_rpc_result() (no result: null) or fail with
+ * http_hal_rpc_error(). Any other error code is reported as a server error.
+ * Runs on the httpd task, must not block for long.
+ *
+ * @param[in] call Current call
+ * @param[in] ctx  Argument given at registration
+ * @return ESP_OK on success
+ */
+typedef esp_err_t (*http_hal_rpc_fn_t)(http_hal_rpc_call_t *call, void *ctx);
+
+/**
+ * @brief Register a method (at most CONFIG_HTTP_HAL_RPC_METHODS, never removed)
+ *
+ * @param[in] h    HAL instance
+ * @param[in] name Method name, must stay valid (e.g. a literal)
+ * @param[in] fn   Implementation
+ * @param[in] ctx  Argument passed to fn
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if the name is taken, ESP_ERR_NO_MEM if
+ *         the table is full
+ */
+esp_err_t http_hal_rpc_register_method(http_hal_t *h, const char *name, http_hal_rpc_fn_t fn, void *ctx);
+
+/**
+ * @brief POST handler executing a call or a batch
+ *
+ * Register it with user_ctx set to the HAL instance whose methods it serves.
+ * Replies 204 when every call was a notification (no id).
+ */
+esp_err_t http_hal_rpc_handler(httpd_req_t *req);
+
+/**
+ * @brief Request carrying the call (scratch arena, peer address)
+ */
+httpd_req_t *http_hal_rpc_req(http_hal_rpc_call_t *call);
+
+/**
+ * @brief Whether a named parameter is present
+ */
+bool http_hal_rpc_has_param(http_hal_rpc_call_t *call, const char *key);
+
+/**
+ * @brief Get a string parameter, unescaped into the scratch arena
+ *
+ * @return String, or NULL if missing, not a string or out of scratch memory
+ */
+const char *http_hal_rpc_param_str(http_hal_rpc_call_t *call, const char *key);
+
+/**
+ * @brief Get an integer parameter
+ *
+ * @return false if missing, not an integer or out of [min, max]
+ */
+bool http_hal_rpc_param_int(http_hal_rpc_call_t *call, const char *key, int64_t min, int64_t max, int64_t *out);
+
+/**
+ * @brief Get a boolean parameter (true/false or 1/0)
+ *
+ * @return false if missing or not a boolean
+ */
+bool http_hal_rpc_param_bool(http_hal_rpc_call_t *call, const char *key, int *out);
+
+/**
+ * @brief Set the result, a JSON value formatted into the scratch arena
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the arena is exhausted
+ */
+esp_err_t http_hal_rpc_result(http_hal_rpc_call_t *call, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Fail the call
+ *
+ * @param[in] call Current call
+ * @param[in] code JSON-RPC error code (HTTP_HAL_RPC_*, or a method specific one)
+ * @param[in] msg  Message, must stay valid and need no JSON escaping
+ * @return ESP_FAIL, to be returned by the method
+ */
+esp_err_t http_hal_rpc_error(http_hal_rpc_call_t *call, int code, const char *msg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,16 +25,44 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include "nvs_flash.h"
 #include "driver/gpio.h"
 #include "wifi.h"
 #include "common.h"
 #include "http_hal.h"
+#include "gpio_sched.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "pwm_hal.h"
+#include "rmt_pattern.h"
+#endif
+#include "gpio_bundle.h"
+#include "gpio_capture.h"
+#include "gpio_hal.h"
+#include "scene.h"
+#if CONFIG_PERSIST_ENABLE
+#include "persist.h"
+#endif
+#if CONFIG_PIXEL_STRIP_GPIO >= 0 && !CONFIG_IDF_TARGET_LINUX
+#include "pixel_strip.h"
+#endif
+#include "adc_stream.h"
+#include "adc_dsp.h"
+#if CONFIG_DAC_WAVE_ENABLE
+#include "dac_wave.h"
+#endif
+#if CONFIG_TELEMETRY_ENABLE
+#include "telemetry.h"
+#endif
+#include "state_log.h"
+#include "sys_status.h"
+#include "http_hal_rpc.h"
 
-#define GPIO_OUT    CONFIG_GPIO_OUT_PIN
-#define GPIO_OUT_PIN_SEL  (1ULL<<GPIO_OUT)
-#define LED_ACTIVE_LOW false
+// the LED is channel 0 of the output registry (menuconfig GPIO_OUT_CHANNELS)
+#define LED_CHANNEL 0
+#define GPIO_OUT    GPIO_HAL_CH0_PIN
+#define LED_ACTIVE_LOW GPIO_HAL_CH0_ACTIVE_LOW
 #define TASKAPP_TIME 1000 //ms
 
 static esp_err_t gpio_set(uint32_t gpio_num, bool* toogle);
@@ -43,8 +71,6 @@ static esp_err_t gpio_init(void);
 /* ====== HTTP HAL handle ====== */
 static http_hal_t *s_http = NULL;
 //uint32_t level = 1;
-bool log_request = false;
-int lvl, logical = 0;
 
 /* ====== Helpers ====== */
 static bool parse_state(const char *s, int *out_level)
@@ -62,6 +88,21 @@ static bool parse_state(const char *s, int *out_level)
     return false;
 }
 
+static size_t parse_pin_list(const char *s, gpio_num_t *out, size_t max)
+{
+    // "19,21,22" -> {19, 21, 22}; stops at the first malformed entry
+    size_t n = 0;
+    while (*s && n < max) {
+        char *end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v < 0 || v > 63) break;
+        out[n++] = (gpio_num_t)v;
+        s = end;
+        while (*s == ',' || *s == ' ') s++;
+    }
+    return n;
+}
+
 static int logical_from_gpio_level(int gpio_level)
 {
     // gpio_level is the logic level on pin (0/1)
@@ -79,69 +120,129 @@ static int gpio_level_from_logical(int logical_level)
 }
 
 /* ====== Handler: GET /api/led ====== */
+
+// reply with the current state, also called from the long-poll task
+static esp_err_t led_reply(httpd_req_t *req)
+{
+    // Reply with current state, read together with its version
+    uint32_t version;
+    int led_on = (int)((gpio_hal_snapshot(&version) >> LED_CHANNEL) & 1ULL);
+    int gpio_lvl = gpio_level_from_logical(led_on);
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"led\":%s,\"gpio_level\":%d,\"version\":%lu}",
+             led_on ? "true" : "false",
+             gpio_lvl, (unsigned long)version);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+
+    return http_hal_send_json(req, 200, resp);
+}
+
 static esp_err_t led_get_handler(httpd_req_t *req)
 {
-    char query[96] = {0};
-    
+    // query and values live in the per-session scratch arena, sized to the actual request
+    char *query = http_hal_scratch_query(req);
 
-    // manage: ?level=0|1 or ?state=on/off/true/false
-    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    // plain polls are answered with 304 while the output state version is unchanged
+    if (!query && http_hal_etag_check(req, gpio_hal_get_version())) {
+        return http_hal_send_not_modified(req);
+    }
+
+    // long poll: ?wait=<ms>&since=<version> replies once the state moves past since (read only)
+    char *wait_str = query ? http_hal_scratch_query_value(req, query, "wait") : NULL;
+    if (wait_str) {
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        int64_t wait_ms, since = gpio_hal_get_version();
+        if (!http_hal_parse_int(wait_str, 0, HTTP_HAL_LONGPOLL_MAX_MS, &wait_ms)) {
+            return http_hal_send_err(req, 400, "Invalid wait (ms)");
+        }
+        if (since_str && !http_hal_parse_int(since_str, 0, UINT32_MAX, &since)) {
+            return http_hal_send_err(req, 400, "Invalid since");
+        }
+        return http_hal_longpoll(req, (uint32_t)since, (uint32_t)wait_ms, gpio_hal_get_version, led_reply);
+    }
 
+    // manage: ?level=0|1 or ?state=on/off/true/false
+    if (query) {
         // 1) level=0|1 (no logical interpretation, directly set gpio level)
-        char level_str[8] = {0};
-        if (httpd_query_key_value(query, "level", level_str, sizeof(level_str)) == ESP_OK) {
-            if (!parse_state(level_str, &lvl)) {
-                return http_hal_send_err(req, 400, "Invalid level (use 0 or 1)");
-            }
-            gpio_set_level(GPIO_OUT, gpio_level_from_logical(lvl));
+        char *level_str = http_hal_scratch_query_value(req, query, "level");
+        int lvl = -1;
+        if (level_str && !parse_state(level_str, &lvl)) {
+            return http_hal_send_err(req, 400, "Invalid level (use 0 or 1)");
         }
 
-        // 2) state=on/off/true/false (logic\al interpretation, set gpio level based on logical state)
-        char state_str[16] = {0};
-        if (httpd_query_key_value(query, "state", state_str, sizeof(state_str)) == ESP_OK) {
-            if (!parse_state(state_str, &logical)) {
-                return http_hal_send_err(req, 400, "Invalid state (use on/off/true/false)");
+        // 2) state=on/off/true/false (logical interpretation, set gpio level based on logical state)
+        char *state_str = http_hal_scratch_query_value(req, query, "state");
+        int logical = -1;
+        if (state_str && !parse_state(state_str, &logical)) {
+            return http_hal_send_err(req, 400, "Invalid state (use on/off/true/false)");
+        }
+
+        // only a valid write takes the pin back from the PWM and RMT peripherals
+        if (level_str || state_str) {
+#if !CONFIG_IDF_TARGET_LINUX
+            if (pwm_hal_release() != ESP_OK) {
+                return http_hal_send_err(req, 500, "PWM release failed");
+            }
+            if (rmt_pattern_release() != ESP_OK) {
+                return http_hal_send_err(req, 500, "RMT release failed");
             }
-            log_request = true;
-            gpio_set_level(GPIO_OUT, gpio_level_from_logical(logical));
+#endif
+            gpio_hal_src_t src = { GPIO_HAL_SRC_LED, http_hal_peer_ipv4(req) };
+            if (level_str) gpio_hal_set_src(LED_CHANNEL, logical_from_gpio_level(lvl), &src);
+            if (state_str) gpio_hal_set_src(LED_CHANNEL, logical, &src);
         }
     }
-    int gpio_lvl;
-    if(log_request){
-        gpio_lvl = logical;
-    }else{
-        gpio_lvl = lvl;
+    return led_reply(req);
+}
+
+static esp_err_t gpio_init(void)
+{
+    // all registry channels are configured as outputs, restoring the saved state if any
+    uint64_t saved = 0;
+    uint64_t valid = 0;
+#if CONFIG_PERSIST_ENABLE
+    if (persist_load(&saved) == ESP_OK) valid = UINT64_MAX;
+#endif
+    esp_err_t err = gpio_hal_init_state(saved, valid);
+    if (err != ESP_OK) return err;
+
+    // optional output bundle updated in one write (menuconfig GPIO_BUNDLE_PINS)
+    gpio_num_t bundle[GPIO_BUNDLE_MAX_PINS];
+    size_t n = parse_pin_list(CONFIG_GPIO_BUNDLE_PINS, bundle, GPIO_BUNDLE_MAX_PINS);
+    if (n > 0) {
+        err = gpio_bundle_init(bundle, n);
+        if (err != ESP_OK) return err;
     }
-    // Reply with current state
-    
-    int led_on = logical_from_gpio_level(gpio_lvl);
 
-    char resp[80];
-    snprintf(resp, sizeof(resp),
-             "{\"ok\":true,\"led\":%s,\"gpio_level\":%d}",
-             led_on ? "true" : "false",
-             gpio_lvl);
+    // optional edge capture inputs (menuconfig GPIO_IN_PINS)
+    gpio_num_t inputs[GPIO_CAPTURE_MAX_PINS];
+    n = parse_pin_list(CONFIG_GPIO_IN_PINS, inputs, GPIO_CAPTURE_MAX_PINS);
+    if (n > 0) {
+        return gpio_capture_init(inputs, n);
+    }
 
-    return http_hal_send_json(req, 200, resp);
+    return ESP_OK;
 }
 
-static esp_err_t gpio_init(void)
+static esp_err_t adc_init(void)
 {
-    gpio_config_t io_conf = {};
-    //disable interrupt
-    io_conf.intr_type = GPIO_INTR_DISABLE;
-    //set as output mode
-    io_conf.mode = GPIO_MODE_OUTPUT;
-    //bit mask of the pins that you want to set,e.g.GPIO18/19
-    io_conf.pin_bit_mask = GPIO_OUT_PIN_SEL;
-    //disable pull-down mode
-    io_conf.pull_down_en = 0;
-    //disable pull-up mode
-    io_conf.pull_up_en = 0;
-    //configure GPIO with the given settings
-    gpio_config(&io_conf);
+    // optional continuous sampling (menuconfig ADC_STREAM_CHANNELS)
+    gpio_num_t list[ADC_STREAM_MAX_CHANNELS];
+    size_t n = parse_pin_list(CONFIG_ADC_STREAM_CHANNELS, list, ADC_STREAM_MAX_CHANNELS);
+    if (n == 0) return ESP_OK;
 
-    return ESP_OK;
+    int channels[ADC_STREAM_MAX_CHANNELS];
+    for (size_t i = 0; i < n; i++) channels[i] = list[i];
+    return adc_stream_init(channels, n, CONFIG_ADC_STREAM_SAMPLE_HZ);
+}
+
+static void on_output_change(void *arg)
+{
+    // parked ?wait= requests re-check the state version
+    http_hal_longpoll_wake((http_hal_t *)arg);
 }
 
 static void app_setup_http(void)
@@ -149,9 +250,16 @@ static void app_setup_http(void)
     http_hal_config_t cfg = {
         .port = 0,
         .lru_purge_enable = true,
-        .max_uri_handlers = 16
+        .max_uri_handlers = 16,
+        .max_open_sockets = 0,
+        .scratch_size = 0,
+        .stack_size = CONFIG_HTTP_HAL_STACK_SIZE,
+        // dedicated GPIO bundles can only be written from the core that owns them
+        .pin_core = gpio_bundle_core() >= 0,
+        .core_id = gpio_bundle_core()
     };
     ESP_ERROR_CHECK(http_hal_init(&s_http, &cfg));
+    ESP_ERROR_CHECK(gpio_hal_add_change_cb(on_output_change, s_http));
 
     http_hal_endpoint_t led_ep = {
         .uri = "/api/led",
@@ -160,6 +268,55 @@ static void app_setup_http(void)
         .user_ctx = NULL
     };
     ESP_ERROR_CHECK(http_hal_register_endpoint(s_http, &led_ep));
+    ESP_ERROR_CHECK(gpio_hal_register_endpoints(s_http));
+    ESP_ERROR_CHECK(scene_register_endpoints(s_http));
+    ESP_ERROR_CHECK(gpio_sched_register_endpoints(s_http, LED_CHANNEL));
+#if !CONFIG_IDF_TARGET_LINUX
+    ESP_ERROR_CHECK(pwm_hal_register_endpoints(s_http));
+    ESP_ERROR_CHECK(rmt_pattern_register_endpoints(s_http));
+#endif
+    if (gpio_bundle_size() > 0) {
+        ESP_ERROR_CHECK(gpio_bundle_register_endpoints(s_http));
+    }
+    if (strlen(CONFIG_GPIO_IN_PINS) > 0) {
+        ESP_ERROR_CHECK(gpio_capture_register_endpoints(s_http));
+    }
+#if CONFIG_PIXEL_STRIP_GPIO >= 0 && !CONFIG_IDF_TARGET_LINUX
+    ESP_ERROR_CHECK(pixel_strip_register_endpoints(s_http));
+#endif
+    if (strlen(CONFIG_ADC_STREAM_CHANNELS) > 0) {
+        ESP_ERROR_CHECK(adc_stream_register_endpoints(s_http));
+        ESP_ERROR_CHECK(adc_dsp_register_endpoints(s_http));
+    }
+#if CONFIG_DAC_WAVE_ENABLE
+    ESP_ERROR_CHECK(dac_wave_register_endpoints(s_http));
+#endif
+#if CONFIG_TELEMETRY_ENABLE
+    ESP_ERROR_CHECK(telemetry_register_endpoints(s_http));
+#endif
+#if CONFIG_STATE_LOG_ENABLE
+    ESP_ERROR_CHECK(state_log_register_endpoints(s_http));
+#endif
+    ESP_ERROR_CHECK(sys_status_register_endpoints(s_http));
+
+    // methods are added by the modules above (out.get, out.set, scene.apply)
+    http_hal_endpoint_t rpc_ep = {
+        .uri = "/api/rpc",
+        .method = HTTP_POST,
+        .handler = http_hal_rpc_handler,
+        .user_ctx = s_http
+    };
+    ESP_ERROR_CHECK(http_hal_register_endpoint(s_http, &rpc_ep));
+
+#if CONFIG_HTTP_HAL_ALLOC_TRACE
+    http_hal_endpoint_t alloc_ep = {
+        .uri = "/api/hal/alloc",
+        .method = HTTP_GET,
+        .handler = http_hal_alloc_stats_handler,
+        .user_ctx = NULL
+    };
+    ESP_ERROR_CHECK(http_hal_register_endpoint(s_http, &alloc_ep));
+#endif
 }
 
 void app_main(void)
@@ -172,19 +329,51 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
     ESP_ERROR_CHECK(gpio_init());
+    ESP_ERROR_CHECK(scene_init());
+#if CONFIG_PERSIST_ENABLE
+    ESP_ERROR_CHECK(persist_start());
+#endif
+#if CONFIG_STATE_LOG_ENABLE
+    // after gpio_init: the state restored at boot is not a transition
+    ESP_ERROR_CHECK(state_log_init());
+#endif
+    ESP_ERROR_CHECK(gpio_sched_init());
+#if !CONFIG_IDF_TARGET_LINUX
+    ESP_ERROR_CHECK(pwm_hal_init(LED_CHANNEL));
+    ESP_ERROR_CHECK(rmt_pattern_init(LED_CHANNEL));
+#endif
+    ESP_ERROR_CHECK(adc_init());
+#if CONFIG_ADC_DSP_BENCH
+    adc_dsp_bench();
+#endif
+#if CONFIG_DAC_WAVE_ENABLE
+    ESP_ERROR_CHECK(dac_wave_init(CONFIG_DAC_WAVE_CHANNEL));
+#endif
+#if CONFIG_PIXEL_STRIP_GPIO >= 0 && !CONFIG_IDF_TARGET_LINUX
+    ESP_ERROR_CHECK(pixel_strip_init(CONFIG_PIXEL_STRIP_GPIO, CONFIG_PIXEL_STRIP_PIXELS));
+#endif
     app_setup_http();
 
 
     ESP_ERROR_CHECK(wifi_init_connection());
     ESP_ERROR_CHECK(wifi_connect_sta());
     ESP_ERROR_CHECK(wifi_disable_powersave());
+#if CONFIG_PIXEL_STRIP_GPIO >= 0 && !CONFIG_IDF_TARGET_LINUX
+    ESP_ERROR_CHECK(pixel_strip_start(CONFIG_PIXEL_STRIP_UDP_PORT));
+#endif
 
      // Start server
     ESP_ERROR_CHECK(http_hal_start(s_http));
+#if CONFIG_TELEMETRY_ENABLE
+    ESP_ERROR_CHECK(telemetry_start(s_http));
+#endif
 
     LOG("Ready.");
     LOG("Try:");
     LOG("  curl \"http://ESP_IP/api/led?state=on\"");
     LOG("  curl \"http://ESP_IP/api/led?level=1\"");
+    LOG("  curl \"http://ESP_IP/api/led/schedule?state=on&in=500000\"");
+    LOG("  curl \"http://ESP_IP/api/led/pwm?duty=100&fade=2000\"");
+    LOG("  curl \"http://ESP_IP/api/led/pattern?p=100000:1,100000:0&repeat=5\"");
 
 }
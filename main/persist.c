@@ -0,0 +1,145 @@
+#include "persist.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "gpio_hal.h"
+
+static const char *TAG = "PERSIST";
+
+#define PERSIST_NS          "out_state"
+#define KEY_STATE           "state"
+#define KEY_LAYOUT          "layout"
+#define DEBOUNCE_MS         CONFIG_PERSIST_DEBOUNCE_MS
+#define TASK_STACK          3072
+#define TASK_PRIO           1
+
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_lock;
+static persist_stats_t s_stats;
+static bool s_have_saved;
+
+/* ====== Helpers ====== */
+
+static uint32_t layout_hash(void)
+{
+    // FNV-1a over channel names and pins: any table change invalidates the saved state
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < gpio_hal_channel_count(); i++) {
+        const gpio_hal_channel_t *ch = gpio_hal_channel(i);
+        for (const char *p = ch->name; *p; p++) {
+            h = (h ^ (uint8_t)*p) * 16777619u;
+        }
+        h = (h ^ (uint8_t)ch->pin) * 16777619u;
+    }
+    return h;
+}
+
+static void on_change(void *arg)
+{
+    (void)arg;
+    // only a notification: no flash access on the request path
+    if (s_task) xTaskNotifyGive(s_task);
+}
+
+static void persist_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        uint32_t n = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // changes arriving during the window are folded into the same write
+        vTaskDelay(pdMS_TO_TICKS(DEBOUNCE_MS));
+        s_stats.changes += n + ulTaskNotifyTake(pdTRUE, 0);
+        persist_flush();
+    }
+}
+
+static void shutdown_handler(void)
+{
+    persist_flush();
+}
+
+/* ====== API ====== */
+
+esp_err_t persist_load(uint64_t *values)
+{
+    ESP_RETURN_ON_FALSE(values, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    nvs_handle_t nvs;
+    if (nvs_open(PERSIST_NS, NVS_READONLY, &nvs) != ESP_OK) return ESP_ERR_NOT_FOUND;
+
+    uint32_t layout = 0;
+    uint64_t state = 0;
+    esp_err_t err = nvs_get_u32(nvs, KEY_LAYOUT, &layout);
+    if (err == ESP_OK) err = nvs_get_u64(nvs, KEY_STATE, &state);
+    nvs_close(nvs);
+
+    if (err != ESP_OK) return ESP_ERR_NOT_FOUND;
+    if (layout != layout_hash()) {
+        ESP_LOGW(TAG, "Channel table changed, saved state ignored");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *values = state;
+    s_stats.saved = state;
+    s_have_saved = true;
+    return ESP_OK;
+}
+
+esp_err_t persist_start(void)
+{
+    if (s_task) return ESP_OK;
+
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+    ESP_RETURN_ON_FALSE(xTaskCreate(persist_task, "persist", TASK_STACK, NULL, TASK_PRIO, &s_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+
+    ESP_RETURN_ON_ERROR(gpio_hal_add_change_cb(on_change, NULL), TAG, "change cb failed");
+    ESP_RETURN_ON_ERROR(esp_register_shutdown_handler(shutdown_handler), TAG, "shutdown handler failed");
+    return ESP_OK;
+}
+
+esp_err_t persist_flush(void)
+{
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG, "not started");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint64_t state = gpio_hal_get_mask();
+    esp_err_t err = ESP_OK;
+
+    // toggles that end where they started never reach flash
+    if (!s_have_saved || state != s_stats.saved) {
+        nvs_handle_t nvs;
+        err = nvs_open(PERSIST_NS, NVS_READWRITE, &nvs);
+        if (err == ESP_OK) {
+            err = nvs_set_u32(nvs, KEY_LAYOUT, layout_hash());
+            if (err == ESP_OK) err = nvs_set_u64(nvs, KEY_STATE, state);
+            if (err == ESP_OK) err = nvs_commit(nvs);
+            nvs_close(nvs);
+        }
+        if (err == ESP_OK) {
+            s_stats.saved = state;
+            s_stats.writes++;
+            s_have_saved = true;
+            ESP_LOGI(TAG, "State %llx saved (%u writes for %u changes)", (unsigned long long)state,
+                (unsigned)s_stats.writes, (unsigned)s_stats.changes);
+        } else {
+            ESP_LOGE(TAG, "NVS write failed: %s", esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void persist_get_stats(persist_stats_t *out)
+{
+    if (!out) return;
+    *out = s_stats;
+}
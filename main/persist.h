@@ -0,0 +1,81 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file persist.h
+ * @brief Output state persistence with coalesced NVS writes
+ * Changes of the gpio_hal channel state only wake a low priority task. The
+ * task waits CONFIG_PERSIST_DEBOUNCE_MS, so a burst of toggles costs a single
+ * NVS write, and skips the write when the state is back to what is already
+ * stored. Pending changes are also flushed from an esp_restart() shutdown
+ * handler. The saved state is tagged with a hash of the channel table, so a
+ * firmware with different channels starts from its defaults.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Persistence counters
+ */
+typedef struct {
+    uint32_t changes;       // state changes seen
+    uint32_t writes;        // NVS writes performed
+    uint64_t saved;         // state currently stored
+} persist_stats_t;
+
+/**
+ * @brief Read the saved channel state
+ *
+ * Call after nvs_flash_init() and before gpio_hal_init_state().
+ *
+ * @param[out] values Saved logical states
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if nothing valid is stored
+ */
+esp_err_t persist_load(uint64_t *values);
+
+/**
+ * @brief Start tracking changes (flush task, change callback, shutdown handler)
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t persist_start(void);
+
+/**
+ * @brief Write the current state now if it differs from the stored one
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t persist_flush(void);
+
+/**
+ * @brief Get persistence counters
+ *
+ * @param[out] out Returned counters
+ */
+void persist_get_stats(persist_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,342 @@
+#include "pixel_strip.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/rmt_tx.h"
+#include "soc/soc_caps.h"
+#include "lwip/sockets.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+
+static const char *TAG = "PIXEL_STRIP";
+
+#define MAX_PIXELS          CONFIG_PIXEL_STRIP_PIXELS
+#define MAX_BYTES           (MAX_PIXELS * 3)
+#define RMT_RES_HZ          10000000    // 1 tick = 0.1 us
+#define RESET_TICKS         1500        // two halves = 300 us low, enough for WS2812B
+#define DMA_BLOCK_SYMBOLS   1024
+#define TASK_STACK          3072
+#define TASK_PRIO           5
+#define FILL_WAIT_MS        100
+
+// DDP header: flags, sequence, data type, destination id, offset (BE32), length (BE16)
+#define DDP_HDR_LEN         10
+#define DDP_TIMECODE_LEN    4
+#define DDP_MAX_DATA        1440
+#define DDP_VER_MASK        0xC0
+#define DDP_VER1            0x40
+#define DDP_FLAG_TIMECODE   0x10
+#define DDP_FLAG_REPLY      0x04
+#define DDP_FLAG_QUERY      0x02
+#define DDP_FLAG_PUSH       0x01
+#define DDP_ID_CONTROL      246         // 246 and above: control, config, status
+
+#if CONFIG_PIXEL_STRIP_ORDER_GRB
+static const uint8_t s_order[3] = { 1, 0, 2 };     // R, G, B -> wire position
+#else
+static const uint8_t s_order[3] = { 0, 1, 2 };
+#endif
+
+// front buffer is read by the RMT encoder while the back one is being filled
+static uint8_t s_buf[2][MAX_BYTES];
+static uint8_t s_back;
+static size_t s_bytes;
+
+static uint8_t s_packet[DDP_HDR_LEN + DDP_TIMECODE_LEN + DDP_MAX_DATA];
+static const rmt_symbol_word_t s_reset = {
+    .duration0 = RESET_TICKS, .level0 = 0, .duration1 = RESET_TICKS, .level1 = 0
+};
+
+static rmt_channel_handle_t s_chan;
+static rmt_encoder_handle_t s_bytes_enc;
+static rmt_encoder_handle_t s_copy_enc;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static volatile uint32_t s_inflight;    // transactions of the frame on the wire
+
+static pixel_strip_stats_t s_stats;
+static uint8_t s_last_seq;
+static int64_t s_win_start;
+static uint32_t s_win_frames;
+
+/* ====== RMT ====== */
+
+static bool IRAM_ATTR strip_done_cb(rmt_channel_handle_t chan, const rmt_tx_done_event_data_t *edata, void *user_ctx)
+{
+    (void)chan;
+    (void)edata;
+    (void)user_ctx;
+
+    s_inflight--;
+    return false;
+}
+
+static void update_fps(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - s_win_start;
+    if (elapsed >= 1000000) {
+        s_stats.fps_x10 = (uint32_t)((int64_t)(s_stats.frames - s_win_frames) * 10000000 / elapsed);
+        s_win_start = now;
+        s_win_frames = s_stats.frames;
+    }
+}
+
+// caller holds s_lock
+static esp_err_t push_locked(void)
+{
+    if (s_inflight) {
+        s_stats.dropped++;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint8_t *front = s_buf[s_back];
+    s_back ^= 1;
+    // the new back buffer starts from the frame on the wire, so partial updates stay coherent
+    memcpy(s_buf[s_back], front, s_bytes);
+
+    rmt_transmit_config_t tx = { .loop_count = 0 };
+    s_inflight = 2;
+    esp_err_t err = rmt_transmit(s_chan, s_bytes_enc, front, s_bytes, &tx);
+    if (err == ESP_OK) {
+        // latch: the strip shows the frame after a long low period
+        err = rmt_transmit(s_chan, s_copy_enc, &s_reset, sizeof(s_reset), &tx);
+        if (err != ESP_OK) s_inflight = 1;
+    } else {
+        s_inflight = 0;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "rmt_transmit failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_stats.frames++;
+    update_fps();
+    return ESP_OK;
+}
+
+static void write_locked(size_t offset, const uint8_t *rgb, size_t len)
+{
+    uint8_t *back = s_buf[s_back];
+    for (size_t i = 0; i < len; i++) {
+        size_t b = offset + i;
+        back[b - b % 3 + s_order[b % 3]] = rgb[i];
+    }
+}
+
+/* ====== DDP receiver ====== */
+
+static uint32_t rd_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void ddp_handle(const uint8_t *p, size_t n)
+{
+    if (n < DDP_HDR_LEN || (p[0] & DDP_VER_MASK) != DDP_VER1) {
+        s_stats.bad_packets++;
+        return;
+    }
+    // queries and replies are for discovery tools, not for the display
+    if (p[0] & (DDP_FLAG_QUERY | DDP_FLAG_REPLY) || p[3] >= DDP_ID_CONTROL) return;
+
+    size_t hdr = DDP_HDR_LEN + ((p[0] & DDP_FLAG_TIMECODE) ? DDP_TIMECODE_LEN : 0);
+    uint32_t offset = rd_be32(&p[4]);
+    size_t len = ((size_t)p[8] << 8) | p[9];
+    if (n < hdr + len || offset > s_bytes || len > s_bytes - offset) {
+        s_stats.bad_packets++;
+        return;
+    }
+
+    // 4-bit sequence, 0 means the sender does not number its packets
+    uint8_t seq = p[1] & 0x0F;
+    if (seq && s_last_seq && seq != s_last_seq % 15 + 1) s_stats.seq_gaps++;
+    s_last_seq = seq;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.packets++;
+    write_locked(offset, p + hdr, len);
+    if (p[0] & DDP_FLAG_PUSH) push_locked();
+    xSemaphoreGive(s_lock);
+}
+
+static void rx_task(void *arg)
+{
+    int sock = (int)(intptr_t)arg;
+    for (;;) {
+        int n = recv(sock, s_packet, sizeof(s_packet), 0);
+        if (n < 0) {
+            ESP_LOGW(TAG, "recv failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        ddp_handle(s_packet, (size_t)n);
+    }
+}
+
+/* ====== API ====== */
+
+esp_err_t pixel_strip_init(gpio_num_t pin, size_t pixels)
+{
+    if (s_chan) return ESP_OK;
+    ESP_RETURN_ON_FALSE(pixels > 0 && pixels <= MAX_PIXELS, ESP_ERR_INVALID_ARG, TAG, "bad pixel count");
+
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+
+    rmt_tx_channel_config_t cfg = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RES_HZ,
+        .mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+        // frame data and latch are queued together
+        .trans_queue_depth = 2,
+    };
+#if SOC_RMT_SUPPORT_DMA
+    // long strips would need many ping-pong refills per frame without DMA
+    cfg.flags.with_dma = 1;
+    cfg.mem_block_symbols = DMA_BLOCK_SYMBOLS;
+#endif
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&cfg, &s_chan), TAG, "rmt_new_tx_channel failed");
+
+    // WS2812 bit timings: 0 = 0.3 us high + 0.9 us low, 1 = 0.9 us high + 0.3 us low
+    const rmt_bytes_encoder_config_t bytes_cfg = {
+        .bit0 = { .duration0 = 3, .level0 = 1, .duration1 = 9, .level1 = 0 },
+        .bit1 = { .duration0 = 9, .level0 = 1, .duration1 = 3, .level1 = 0 },
+        .flags.msb_first = 1,
+    };
+    const rmt_copy_encoder_config_t copy_cfg = {};
+    const rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = strip_done_cb
+    };
+    ESP_RETURN_ON_ERROR(rmt_new_bytes_encoder(&bytes_cfg, &s_bytes_enc), TAG, "rmt_new_bytes_encoder failed");
+    ESP_RETURN_ON_ERROR(rmt_new_copy_encoder(&copy_cfg, &s_copy_enc), TAG, "rmt_new_copy_encoder failed");
+    ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(s_chan, &cbs, NULL), TAG, "register callbacks failed");
+    ESP_RETURN_ON_ERROR(rmt_enable(s_chan), TAG, "rmt_enable failed");
+
+    s_bytes = pixels * 3;
+    s_stats.pixels = pixels;
+    s_win_start = esp_timer_get_time();
+
+    // blank the strip, whatever it latched at power up
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = push_locked();
+    xSemaphoreGive(s_lock);
+    LOG("Pixel strip: %u pixels on GPIO %d", (unsigned)pixels, pin);
+    return err;
+}
+
+esp_err_t pixel_strip_start(uint16_t port)
+{
+    ESP_RETURN_ON_FALSE(s_chan, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    if (s_task) return ESP_OK;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ESP_RETURN_ON_FALSE(sock >= 0, ESP_FAIL, TAG, "socket failed: errno %d", errno);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "bind to port %u failed: errno %d", port, errno);
+        close(sock);
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(rx_task, "pixel_rx", TASK_STACK, (void *)(intptr_t)sock, TASK_PRIO, &s_task) != pdPASS) {
+        close(sock);
+        return ESP_ERR_NO_MEM;
+    }
+    LOG("Pixel strip: DDP on UDP port %u", port);
+    return ESP_OK;
+}
+
+esp_err_t pixel_strip_write(size_t offset, const uint8_t *rgb, size_t len)
+{
+    ESP_RETURN_ON_FALSE(s_chan, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    if (offset > s_bytes || len > s_bytes - offset) return ESP_ERR_INVALID_SIZE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    write_locked(offset, rgb, len);
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t pixel_strip_push(void)
+{
+    ESP_RETURN_ON_FALSE(s_chan, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = push_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void pixel_strip_get_stats(pixel_strip_stats_t *out)
+{
+    if (!out) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    // no frame for a while: the last measured rate is stale
+    if (esp_timer_get_time() - s_win_start > 2000000) out->fps_x10 = 0;
+    xSemaphoreGive(s_lock);
+}
+
+/* ====== Handlers: /api/strip ====== */
+
+static esp_err_t strip_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    char *fill = query ? http_hal_scratch_query_value(req, query, "fill") : NULL;
+    if (fill) {
+        char *end;
+        unsigned long color = strtoul(fill, &end, 16);
+        if (strlen(fill) != 6 || *end != '\0') {
+            return http_hal_send_err(req, 400, "Invalid fill (use rrggbb)");
+        }
+        const uint8_t rgb[3] = { color >> 16, color >> 8, color };
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for (size_t i = 0; i < s_bytes; i += 3) {
+            write_locked(i, rgb, 3);
+        }
+        xSemaphoreGive(s_lock);
+        // unlike the stream, a single request waits for the strip rather than dropping
+        rmt_tx_wait_all_done(s_chan, FILL_WAIT_MS);
+        if (pixel_strip_push() != ESP_OK) {
+            return http_hal_send_err(req, 503, "Strip busy");
+        }
+    }
+
+    pixel_strip_stats_t st;
+    pixel_strip_get_stats(&st);
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"pixels\":%u,\"fps\":%u.%u,\"frames\":%u,\"dropped\":%u,"
+             "\"packets\":%u,\"bad_packets\":%u,\"seq_gaps\":%u}",
+             (unsigned)st.pixels, (unsigned)(st.fps_x10 / 10), (unsigned)(st.fps_x10 % 10),
+             (unsigned)st.frames, (unsigned)st.dropped, (unsigned)st.packets,
+             (unsigned)st.bad_packets, (unsigned)st.seq_gaps);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+esp_err_t pixel_strip_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/strip",
+        .method = HTTP_GET,
+        .handler = strip_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
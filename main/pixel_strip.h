@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file pixel_strip.h
+ * @brief WS2812-style addressable LED strip fed by a UDP stream
+ * Frames arrive as DDP (Distributed Display Protocol) datagrams, the format
+ * spoken by xLights, WLED and most pixel tools: each packet carries RGB bytes
+ * at a byte offset and the last one of a frame has the PUSH flag. Packets are
+ * written into a back buffer; on PUSH the buffers are swapped and the front one
+ * is clocked out by the RMT bytes encoder while the next frame is received.
+ * A frame pushed while the previous one is still on the wire is dropped.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIXEL_STRIP_DDP_PORT 4048   // default DDP port
+
+/**
+ * @brief Strip counters
+ */
+typedef struct {
+    size_t   pixels;        // strip length
+    uint32_t packets;       // datagrams accepted
+    uint32_t bad_packets;   // malformed or out of range datagrams
+    uint32_t seq_gaps;      // DDP sequence discontinuities (lost datagrams)
+    uint32_t frames;        // frames sent to the strip
+    uint32_t dropped;       // frames pushed while the strip was busy
+    uint32_t fps_x10;       // frame rate over the last second, x10
+} pixel_strip_stats_t;
+
+/**
+ * @brief Create the RMT channel and encoders for the strip
+ *
+ * @param[in] pin    Data pin
+ * @param[in] pixels Number of pixels (at most CONFIG_PIXEL_STRIP_PIXELS)
+ * @return ESP_OK on success
+ */
+esp_err_t pixel_strip_init(gpio_num_t pin, size_t pixels);
+
+/**
+ * @brief Start the UDP receiver task
+ *
+ * @param[in] port UDP port, PIXEL_STRIP_DDP_PORT for DDP senders
+ * @return ESP_OK on success
+ */
+esp_err_t pixel_strip_start(uint16_t port);
+
+/**
+ * @brief Write RGB data into the back buffer
+ *
+ * @param[in] offset Byte offset in the frame (pixel * 3)
+ * @param[in] rgb    RGB bytes
+ * @param[in] len    Number of bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if past the strip end
+ */
+esp_err_t pixel_strip_write(size_t offset, const uint8_t *rgb, size_t len);
+
+/**
+ * @brief Show the back buffer
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the previous frame is
+ *         still being sent (the frame is counted as dropped)
+ */
+esp_err_t pixel_strip_push(void);
+
+/**
+ * @brief Get strip counters
+ *
+ * @param[out] out Returned counters
+ */
+void pixel_strip_get_stats(pixel_strip_stats_t *out);
+
+/**
+ * @brief Register the /api/strip endpoint
+ *
+ * - GET /api/strip reports the counters
+ * - GET /api/strip?fill=<rrggbb> sets every pixel to one color
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t pixel_strip_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
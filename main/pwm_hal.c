@@ -0,0 +1,165 @@
+#include "pwm_hal.h"
+
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_hal.h"
+#include "rmt_pattern.h"
+
+static const char *TAG = "PWM_HAL";
+
+#define PWM_MODE        LEDC_LOW_SPEED_MODE
+#define PWM_TIMER       LEDC_TIMER_0
+#define PWM_CHANNEL     LEDC_CHANNEL_0
+#define PWM_RES         LEDC_TIMER_13_BIT
+#define PWM_DUTY_MAX    ((1u << PWM_RES) - 1)
+#define PWM_FADE_MAX_MS 60000
+
+static size_t s_channel;
+static gpio_num_t s_pin = -1;
+static bool s_active_low;
+static bool s_active;
+
+static uint32_t duty_from_percent(uint32_t percent)
+{
+    return (percent * PWM_DUTY_MAX + 50) / 100;
+}
+
+static esp_err_t pwm_attach(void)
+{
+    if (s_active) return ESP_OK;
+
+    // gpio_hal leaves the pin alone while LEDC owns it
+    ESP_RETURN_ON_ERROR(gpio_hal_claim(s_channel), TAG, "claim failed");
+    // routes the pin to the LEDC output through the GPIO matrix
+    ledc_channel_config_t ch = {
+        .gpio_num   = s_pin,
+        .speed_mode = PWM_MODE,
+        .channel    = PWM_CHANNEL,
+        .intr_type  = LEDC_INTR_DISABLE,
+        .timer_sel  = PWM_TIMER,
+        .duty       = 0,
+        .hpoint     = 0,
+        .flags.output_invert = s_active_low
+    };
+    esp_err_t err = ledc_channel_config(&ch);
+    if (err != ESP_OK) {
+        gpio_hal_release(s_channel);
+        ESP_LOGE(TAG, "ledc_channel_config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_active = true;
+    LOG_PWM("PWM attached to GPIO %d", s_pin);
+    return ESP_OK;
+}
+
+esp_err_t pwm_hal_init(size_t channel)
+{
+    const gpio_hal_channel_t *out = gpio_hal_channel(channel);
+    ESP_RETURN_ON_FALSE(out, ESP_ERR_INVALID_ARG, TAG, "bad channel");
+
+    ledc_timer_config_t timer = {
+        .speed_mode      = PWM_MODE,
+        .duty_resolution = PWM_RES,
+        .timer_num       = PWM_TIMER,
+        .freq_hz         = CONFIG_PWM_FREQ_HZ,
+        .clk_cfg         = LEDC_AUTO_CLK
+    };
+    ESP_RETURN_ON_ERROR(ledc_timer_config(&timer), TAG, "ledc_timer_config failed");
+    ESP_RETURN_ON_ERROR(ledc_fade_func_install(0), TAG, "ledc_fade_func_install failed");
+
+    s_channel = channel;
+    s_pin = out->pin;
+    s_active_low = out->active_low;
+    return ESP_OK;
+}
+
+esp_err_t pwm_hal_set_duty(uint32_t percent, uint32_t fade_ms)
+{
+    ESP_RETURN_ON_FALSE(s_pin >= 0, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(percent <= 100 && fade_ms <= PWM_FADE_MAX_MS, ESP_ERR_INVALID_ARG, TAG, "bad args");
+    ESP_RETURN_ON_ERROR(pwm_attach(), TAG, "attach failed");
+
+    uint32_t duty = duty_from_percent(percent);
+    if (fade_ms == 0) {
+        return ledc_set_duty_and_update(PWM_MODE, PWM_CHANNEL, duty, 0);
+    }
+
+    // the ramp runs in the LEDC hardware, no CPU involvement until it ends
+    LOG_PWM("Fade to %u%% in %u ms", (unsigned)percent, (unsigned)fade_ms);
+    return ledc_set_fade_time_and_start(PWM_MODE, PWM_CHANNEL, duty, fade_ms, LEDC_FADE_NO_WAIT);
+}
+
+uint32_t pwm_hal_get_duty(void)
+{
+    if (!s_active) return 0;
+    return (ledc_get_duty(PWM_MODE, PWM_CHANNEL) * 100 + PWM_DUTY_MAX / 2) / PWM_DUTY_MAX;
+}
+
+bool pwm_hal_is_active(void)
+{
+    return s_active;
+}
+
+esp_err_t pwm_hal_release(void)
+{
+    if (!s_active) return ESP_OK;
+
+    ESP_RETURN_ON_ERROR(ledc_stop(PWM_MODE, PWM_CHANNEL, s_active_low ? 1 : 0), TAG, "ledc_stop failed");
+
+    // the pin goes back to the GPIO output register at the gpio_hal channel state
+    ESP_RETURN_ON_ERROR(gpio_hal_release(s_channel), TAG, "gpio_hal release failed");
+
+    s_active = false;
+    LOG_PWM("PWM released GPIO %d", s_pin);
+    return ESP_OK;
+}
+
+/* ====== Handler: GET /api/led/pwm ====== */
+
+static esp_err_t pwm_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *duty_str = http_hal_scratch_query_value(req, query, "duty");
+        char *fade_str = http_hal_scratch_query_value(req, query, "fade");
+        int64_t duty = 0, fade = 0;
+
+        if (duty_str) {
+            if (!http_hal_parse_int(duty_str, 0, 100, &duty)) {
+                return http_hal_send_err(req, 400, "Invalid duty (use 0..100)");
+            }
+            if (fade_str && !http_hal_parse_int(fade_str, 0, PWM_FADE_MAX_MS, &fade)) {
+                return http_hal_send_err(req, 400, "Invalid fade (ms)");
+            }
+            if (rmt_pattern_release() != ESP_OK) {
+                return http_hal_send_err(req, 500, "RMT release failed");
+            }
+            if (pwm_hal_set_duty((uint32_t)duty, (uint32_t)fade) != ESP_OK) {
+                return http_hal_send_err(req, 500, "PWM update failed");
+            }
+        }
+    }
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"pwm\":%s,\"duty\":%u}",
+             s_active ? "true" : "false", (unsigned)pwm_hal_get_duty());
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+esp_err_t pwm_hal_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/led/pwm",
+        .method = HTTP_GET,
+        .handler = pwm_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
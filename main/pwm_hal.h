@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file pwm_hal.h
+ * @brief PWM brightness control (LEDC) with hardware fades
+ * This module drives the LED pin with the LEDC peripheral. A fade to a target
+ * duty over a given time is executed entirely by the LEDC hardware, so a single
+ * request replaces thousands of on/off requests.
+ * While PWM is active the pin is routed to LEDC and claimed in gpio_hal, which
+ * refuses writes to it; pwm_hal_release() gives it back at the channel state.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the LEDC timer and fade service
+ *
+ * The pin is not taken over until the first pwm_hal_set_duty() call. Output
+ * is inverted for active low channels, so duty is brightness.
+ *
+ * @param[in] channel gpio_hal output channel
+ * @return ESP_OK on success
+ */
+esp_err_t pwm_hal_init(size_t channel);
+
+/**
+ * @brief Set brightness, optionally with a hardware fade
+ *
+ * @param[in] percent Target brightness 0..100
+ * @param[in] fade_ms Fade duration in milliseconds (0 = immediate)
+ * @return ESP_OK on success
+ */
+esp_err_t pwm_hal_set_duty(uint32_t percent, uint32_t fade_ms);
+
+/**
+ * @brief Get the current brightness (follows a running fade)
+ *
+ * @return Brightness 0..100, or 0 if PWM is not active
+ */
+uint32_t pwm_hal_get_duty(void);
+
+/**
+ * @brief Whether the pin is currently driven by LEDC
+ */
+bool pwm_hal_is_active(void);
+
+/**
+ * @brief Stop PWM and give the pin back to gpio_hal as plain output
+ *
+ * The pin returns to the channel state last written through gpio_hal.
+ * Safe to call when PWM is not active.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t pwm_hal_release(void);
+
+/**
+ * @brief Register the GET /api/led/pwm endpoint
+ *
+ * Query parameters:
+ * - duty=<0..100> target brightness in percent
+ * - fade=<ms> optional hardware fade duration
+ * Without parameters the endpoint reports the current brightness.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t pwm_hal_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
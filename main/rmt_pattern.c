@@ -0,0 +1,425 @@
+#include "rmt_pattern.h"
+
+#include <string.h>
+#include <ctype.h>
+#include "driver/rmt_tx.h"
+#include "soc/soc_caps.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_hal.h"
+#include "pwm_hal.h"
+
+static const char *TAG = "RMT_PATTERN";
+
+#define RMT_RES_HZ          1000000     // 1 tick = 1 us
+#define MAX_SYMBOLS         CONFIG_RMT_PATTERN_MAX_SYMBOLS
+#define HALF_MAX_TICKS      32767       // 15-bit duration field
+#define STEP_MAX_US         60000000
+#define REPEAT_MAX          65535
+#define DMA_BLOCK_SYMBOLS   256
+#define RECV_CHUNK          64
+
+/*
+ * Endless or repeated playback without software copies uses the RMT loop
+ * counter. The driver only supports it without DMA, so the pattern must fit in
+ * one channel memory block (minus the end marker).
+ */
+#if SOC_RMT_SUPPORT_TX_LOOP_COUNT
+#define HW_LOOP_MAX_SYMBOLS (SOC_RMT_MEM_WORDS_PER_CHANNEL - 1)
+#else
+#define HW_LOOP_MAX_SYMBOLS 0
+#endif
+
+// each symbol holds two (duration, level) halves
+typedef struct {
+    uint32_t num;
+    uint32_t dur;
+    uint8_t  field;         // 0 = duration, 1 = level
+    bool     digits;
+    bool     err;
+    bool     overflow;
+    size_t   halves;
+} pattern_parser_t;
+
+// must stay valid (and DMA capable) for the whole transmission
+static DRAM_ATTR rmt_symbol_word_t s_symbols[MAX_SYMBOLS];
+
+static rmt_channel_handle_t s_chan;
+static rmt_encoder_handle_t s_encoder;
+static size_t s_channel;
+static gpio_num_t s_pin = -1;
+static uint32_t s_idle_level;
+static rmt_pattern_status_t s_status;
+static volatile bool s_playing;
+static volatile uint32_t s_completed;
+
+/* ====== Parser ====== */
+
+static bool parser_emit(pattern_parser_t *p, uint32_t us, uint32_t level)
+{
+    if (us == 0 || level > 1) return false;
+
+    // long steps are split into several halves at the same level
+    while (us > 0) {
+        if (p->halves >= (size_t)MAX_SYMBOLS * 2) {
+            p->overflow = true;
+            return false;
+        }
+        uint32_t d = us > HALF_MAX_TICKS ? HALF_MAX_TICKS : us;
+        rmt_symbol_word_t *s = &s_symbols[p->halves / 2];
+        if (p->halves & 1) {
+            s->duration1 = d;
+            s->level1 = level;
+        } else {
+            s->duration0 = d;
+            s->level0 = level;
+        }
+        p->halves++;
+        us -= d;
+    }
+    return true;
+}
+
+static void parser_end_step(pattern_parser_t *p)
+{
+    if (p->field == 1 && p->digits) {
+        if (!parser_emit(p, p->dur, p->num)) p->err = true;
+    } else if (p->field != 0 || p->digits) {
+        p->err = true;
+    }
+    p->num = 0;
+    p->field = 0;
+    p->digits = false;
+}
+
+static void parser_feed(pattern_parser_t *p, const char *s, size_t n)
+{
+    for (size_t i = 0; i < n && !p->err; i++) {
+        char c = s[i];
+        if (c >= '0' && c <= '9') {
+            p->num = p->num * 10 + (uint32_t)(c - '0');
+            if (p->num > STEP_MAX_US) p->err = true;
+            p->digits = true;
+        } else if (c == ':') {
+            if (p->field != 0 || !p->digits) {
+                p->err = true;
+            } else {
+                p->dur = p->num;
+                p->num = 0;
+                p->field = 1;
+                p->digits = false;
+            }
+        } else if (c == ',' || isspace((unsigned char)c)) {
+            parser_end_step(p);
+        } else {
+            p->err = true;
+        }
+    }
+}
+
+static size_t parser_finish(pattern_parser_t *p)
+{
+    parser_end_step(p);
+    if (p->err || p->halves == 0) return 0;
+
+    // an odd count leaves the last symbol half empty: split its last half in two
+    if (p->halves & 1) {
+        rmt_symbol_word_t *s = &s_symbols[p->halves / 2];
+        uint32_t d = s->duration0;
+        s->duration0 = d > 1 ? d - 1 : d;
+        s->duration1 = 1;
+        s->level1 = s->level0;
+        p->halves++;
+    }
+    return p->halves / 2;
+}
+
+/* ====== RMT channel ====== */
+
+static bool IRAM_ATTR pattern_done_cb(rmt_channel_handle_t chan, const rmt_tx_done_event_data_t *edata, void *user_ctx)
+{
+    (void)chan;
+    (void)edata;
+    (void)user_ctx;
+
+    s_playing = false;
+    s_completed++;
+    return false;
+}
+
+static esp_err_t channel_open(bool hw_loop)
+{
+    rmt_tx_channel_config_t cfg = {
+        .gpio_num = s_pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RES_HZ,
+        .mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+        .trans_queue_depth = 1,
+    };
+#if SOC_RMT_SUPPORT_DMA
+    // the loop counter does not work with DMA
+    if (!hw_loop) {
+        cfg.flags.with_dma = 1;
+        cfg.mem_block_symbols = DMA_BLOCK_SYMBOLS;
+    }
+#else
+    (void)hw_loop;
+#endif
+    // gpio_hal leaves the pin alone while RMT owns it
+    ESP_RETURN_ON_ERROR(gpio_hal_claim(s_channel), TAG, "claim failed");
+    esp_err_t err = rmt_new_tx_channel(&cfg, &s_chan);
+    if (err != ESP_OK) {
+        gpio_hal_release(s_channel);
+        ESP_LOGE(TAG, "rmt_new_tx_channel failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = pattern_done_cb
+    };
+    err = rmt_tx_register_event_callbacks(s_chan, &cbs, NULL);
+    if (err == ESP_OK) err = rmt_enable(s_chan);
+    if (err != ESP_OK) {
+        rmt_del_channel(s_chan);
+        s_chan = NULL;
+        gpio_hal_release(s_channel);
+        ESP_LOGE(TAG, "RMT channel setup failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static esp_err_t pattern_begin(pattern_parser_t *p)
+{
+    ESP_RETURN_ON_FALSE(s_encoder, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    // the symbol buffer belongs to the running transmission until it is stopped
+    ESP_RETURN_ON_ERROR(rmt_pattern_release(), TAG, "release failed");
+    memset(p, 0, sizeof(*p));
+    return ESP_OK;
+}
+
+static esp_err_t pattern_commit(pattern_parser_t *p, uint32_t repeat)
+{
+    size_t n = parser_finish(p);
+    if (p->overflow) return ESP_ERR_INVALID_SIZE;
+    if (n == 0) return ESP_ERR_INVALID_ARG;
+    ESP_RETURN_ON_FALSE(repeat <= REPEAT_MAX, ESP_ERR_INVALID_ARG, TAG, "repeat too large");
+
+    bool hw_loop = repeat != 1 && n <= HW_LOOP_MAX_SYMBOLS;
+    if (!hw_loop && repeat == 0) return ESP_ERR_NOT_SUPPORTED;
+    if (!hw_loop && repeat > 1) {
+        // unroll the repeats so one DMA transmission covers them all
+        if (n * repeat > MAX_SYMBOLS) return ESP_ERR_INVALID_SIZE;
+        for (uint32_t i = 1; i < repeat; i++) {
+            memcpy(&s_symbols[i * n], s_symbols, n * sizeof(s_symbols[0]));
+        }
+    }
+    size_t total = hw_loop ? n : n * (repeat ? repeat : 1);
+
+    ESP_RETURN_ON_ERROR(channel_open(hw_loop), TAG, "channel open failed");
+
+    rmt_transmit_config_t tx = {
+        .loop_count = hw_loop ? (repeat ? (int)repeat : -1) : 0,
+        .flags.eot_level = s_idle_level,
+    };
+    s_playing = true;
+    esp_err_t err = rmt_transmit(s_chan, s_encoder, s_symbols, total * sizeof(s_symbols[0]), &tx);
+    if (err != ESP_OK) {
+        s_playing = false;
+        rmt_pattern_release();
+        ESP_LOGE(TAG, "rmt_transmit failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_status.loaded = true;
+    s_status.hw_loop = hw_loop;
+    s_status.symbols = total;
+    s_status.repeat = repeat;
+    LOG_RMT("Playing %u symbols x%u (%s) on GPIO %d", (unsigned)n, (unsigned)repeat,
+            hw_loop ? "hw loop" : "unrolled", s_pin);
+    return ESP_OK;
+}
+
+/* ====== API ====== */
+
+esp_err_t rmt_pattern_init(size_t channel)
+{
+    if (s_encoder) return ESP_OK;
+    const gpio_hal_channel_t *out = gpio_hal_channel(channel);
+    ESP_RETURN_ON_FALSE(out, ESP_ERR_INVALID_ARG, TAG, "bad channel");
+
+    const rmt_copy_encoder_config_t enc_cfg = {};
+    ESP_RETURN_ON_ERROR(rmt_new_copy_encoder(&enc_cfg, &s_encoder), TAG, "rmt_new_copy_encoder failed");
+
+    s_channel = channel;
+    s_pin = out->pin;
+    // patterns end with the channel off
+    s_idle_level = out->active_low ? 1 : 0;
+    return ESP_OK;
+}
+
+esp_err_t rmt_pattern_play(const char *text, size_t len, uint32_t repeat)
+{
+    ESP_RETURN_ON_FALSE(text, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    pattern_parser_t p;
+    ESP_RETURN_ON_ERROR(pattern_begin(&p), TAG, "begin failed");
+    parser_feed(&p, text, len);
+    return pattern_commit(&p, repeat);
+}
+
+esp_err_t rmt_pattern_release(void)
+{
+    if (!s_chan) return ESP_OK;
+
+    // disabling aborts a transmission in progress
+    rmt_disable(s_chan);
+    ESP_RETURN_ON_ERROR(rmt_del_channel(s_chan), TAG, "rmt_del_channel failed");
+    s_chan = NULL;
+    s_playing = false;
+    s_status.loaded = false;
+
+    // the pin goes back to the GPIO output register at the gpio_hal channel state
+    ESP_RETURN_ON_ERROR(gpio_hal_release(s_channel), TAG, "gpio_hal release failed");
+
+    LOG_RMT("RMT released GPIO %d", s_pin);
+    return ESP_OK;
+}
+
+void rmt_pattern_get_status(rmt_pattern_status_t *out)
+{
+    if (!out) return;
+
+    *out = s_status;
+    out->playing = s_status.loaded && s_playing;
+    out->completed = s_completed;
+}
+
+/* ====== Handlers: /api/led/pattern ====== */
+
+static esp_err_t send_play_err(httpd_req_t *req, esp_err_t err)
+{
+    if (err == ESP_ERR_INVALID_ARG) {
+        return http_hal_send_err(req, 400, "Invalid pattern (use <us>:<0|1>,...)");
+    }
+    if (err == ESP_ERR_INVALID_SIZE) {
+        return http_hal_send_err(req, 413, "Pattern too long");
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        return http_hal_send_err(req, 400, "Endless loop not supported for this pattern");
+    }
+    return http_hal_send_err(req, 500, "RMT playback failed");
+}
+
+static esp_err_t send_status(httpd_req_t *req)
+{
+    rmt_pattern_status_t st;
+    rmt_pattern_get_status(&st);
+
+    char *resp = http_hal_scratch_printf(req,
+             "{\"ok\":true,\"loaded\":%s,\"playing\":%s,\"hw_loop\":%s,"
+             "\"symbols\":%u,\"repeat\":%u,\"completed\":%u}",
+             st.loaded ? "true" : "false", st.playing ? "true" : "false",
+             st.hw_loop ? "true" : "false", (unsigned)st.symbols,
+             (unsigned)st.repeat, (unsigned)st.completed);
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+static bool query_repeat(httpd_req_t *req, const char *query, uint32_t *out)
+{
+    *out = 1;
+    char *repeat_str = query ? http_hal_scratch_query_value(req, query, "repeat") : NULL;
+    if (!repeat_str) return true;
+
+    int64_t v;
+    if (!http_hal_parse_int(repeat_str, 0, REPEAT_MAX, &v)) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static esp_err_t pattern_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *stop = http_hal_scratch_query_value(req, query, "stop");
+        int do_stop = 0;
+        if (stop && http_hal_parse_bool(stop, &do_stop) && do_stop) {
+            if (rmt_pattern_release() != ESP_OK) {
+                return http_hal_send_err(req, 500, "RMT release failed");
+            }
+        }
+
+        char *p = http_hal_scratch_query_value(req, query, "p");
+        if (p) {
+            uint32_t repeat;
+            if (!query_repeat(req, query, &repeat)) {
+                return http_hal_send_err(req, 400, "Invalid repeat");
+            }
+            if (pwm_hal_release() != ESP_OK) {
+                return http_hal_send_err(req, 500, "PWM release failed");
+            }
+            esp_err_t err = rmt_pattern_play(p, strlen(p), repeat);
+            if (err != ESP_OK) return send_play_err(req, err);
+        }
+    }
+    return send_status(req);
+}
+
+static esp_err_t pattern_post_handler(httpd_req_t *req)
+{
+    uint32_t repeat;
+    if (!query_repeat(req, http_hal_scratch_query(req), &repeat)) {
+        return http_hal_send_err(req, 400, "Invalid repeat");
+    }
+    // "60000000:1," is the longest step, bound the body by the buffer capacity
+    if (req->content_len == 0 || req->content_len > (size_t)MAX_SYMBOLS * 2 * 12) {
+        return http_hal_send_err(req, 413, "Pattern too long");
+    }
+    if (pwm_hal_release() != ESP_OK) {
+        return http_hal_send_err(req, 500, "PWM release failed");
+    }
+
+    pattern_parser_t p;
+    if (pattern_begin(&p) != ESP_OK) {
+        return http_hal_send_err(req, 500, "RMT release failed");
+    }
+
+    // the body is parsed as it arrives, never buffered as a whole
+    char chunk[RECV_CHUNK];
+    size_t remaining = req->content_len;
+    while (remaining > 0) {
+        int r = http_hal_recv(req, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (r <= 0) return ESP_FAIL;
+        parser_feed(&p, chunk, (size_t)r);
+        remaining -= (size_t)r;
+    }
+
+    esp_err_t err = pattern_commit(&p, repeat);
+    if (err != ESP_OK) return send_play_err(req, err);
+    return send_status(req);
+}
+
+esp_err_t rmt_pattern_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t get_ep = {
+        .uri = "/api/led/pattern",
+        .method = HTTP_GET,
+        .handler = pattern_get_handler,
+        .user_ctx = NULL
+    };
+    ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &get_ep), TAG, "register GET failed");
+
+    http_hal_endpoint_t post_ep = {
+        .uri = "/api/led/pattern",
+        .method = HTTP_POST,
+        .handler = pattern_post_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &post_ep);
+}
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file rmt_pattern.h
+ * @brief Pulse pattern playback on the RMT peripheral
+ * This module plays a list of (duration, level) steps on the LED pin. The whole
+ * pattern is uploaded in one request, encoded into RMT symbols (1 us ticks) and
+ * clocked out by the RMT hardware, with DMA where the target has it, so edges
+ * cost neither network round-trips nor CPU time.
+ * While a pattern is loaded the pin is routed to RMT and claimed in gpio_hal,
+ * which refuses writes to it; rmt_pattern_release() gives it back at the
+ * channel state.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Playback status
+ */
+typedef struct {
+    bool     loaded;        // pin is currently routed to RMT
+    bool     playing;       // transmission still running
+    bool     hw_loop;       // repeats are done by the RMT loop counter
+    size_t   symbols;       // RMT symbols in the buffer
+    uint32_t repeat;        // requested repeat count (0 = forever)
+    uint32_t completed;     // patterns played to the end since init
+} rmt_pattern_status_t;
+
+/**
+ * @brief Initialize the module (creates the copy encoder)
+ *
+ * The pin is not taken over until the first rmt_pattern_play() call. A
+ * pattern that ends leaves the channel off until it is released.
+ *
+ * @param[in] channel gpio_hal output channel
+ * @return ESP_OK on success
+ */
+esp_err_t rmt_pattern_init(size_t channel);
+
+/**
+ * @brief Parse and play a pattern
+ *
+ * The pattern text is a list of "<us>:<level>" steps separated by ',' or
+ * whitespace, e.g. "500:1,500:0". Steps longer than the RMT symbol range are
+ * split transparently. Any running pattern is stopped first.
+ *
+ * @param[in] text   Pattern text (need not be NUL terminated)
+ * @param[in] len    Text length
+ * @param[in] repeat Number of times to play the pattern (0 = forever)
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a malformed pattern,
+ *         ESP_ERR_INVALID_SIZE if it does not fit the symbol buffer,
+ *         ESP_ERR_NOT_SUPPORTED if endless looping is unavailable
+ */
+esp_err_t rmt_pattern_play(const char *text, size_t len, uint32_t repeat);
+
+/**
+ * @brief Stop playback and give the pin back to gpio_hal as plain output
+ *
+ * The pin returns to the channel state last written through gpio_hal. Safe to
+ * call when no pattern is loaded.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t rmt_pattern_release(void);
+
+/**
+ * @brief Get the playback status
+ *
+ * @param[out] out Returned status
+ */
+void rmt_pattern_get_status(rmt_pattern_status_t *out);
+
+/**
+ * @brief Register the /api/led/pattern endpoints
+ *
+ * - GET  ?p=<us>:<level>,...&repeat=<n> plays a pattern given in the query
+ * - POST ?repeat=<n> plays the pattern sent as request body (long patterns)
+ * - GET  ?stop=1 releases the pin
+ * repeat defaults to 1, 0 loops forever. Without parameters the endpoint only
+ * reports the playback status.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t rmt_pattern_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,358 @@
+#include "scene.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "common.h"
+#include "gpio_hal.h"
+#include "http_hal_rpc.h"
+
+static const char *TAG = "SCENE";
+
+#define SCENE_NS        "scenes"
+#define SCENE_MAX       CONFIG_SCENE_MAX
+#define SPEC_MAX        CONFIG_SCENE_SPEC_MAX
+
+typedef struct {
+    char                name[SCENE_NAME_MAX + 1];
+    gpio_hal_compiled_t write;
+} scene_t;
+
+static scene_t s_scenes[SCENE_MAX];
+static size_t s_len;
+static SemaphoreHandle_t s_lock;
+
+/* ====== Helpers ====== */
+
+static bool valid_name(const char *name)
+{
+    size_t n = name ? strlen(name) : 0;
+    if (n == 0 || n > SCENE_NAME_MAX) return false;
+    for (size_t i = 0; i < n; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_')) return false;
+    }
+    return true;
+}
+
+static esp_err_t compile_spec(const char *spec, gpio_hal_compiled_t *out)
+{
+    uint64_t mask = 0, values = 0;
+    const char *p = spec;
+
+    while (*p) {
+        // one "<channel>=<state>" entry
+        char tok[48];
+        size_t n = strcspn(p, ",");
+        while (n > 0 && (*p == ' ' || *p == '\n')) { p++; n--; }
+        if (n >= sizeof(tok)) return ESP_ERR_INVALID_ARG;
+        memcpy(tok, p, n);
+        while (n > 0 && (tok[n - 1] == ' ' || tok[n - 1] == '\n' || tok[n - 1] == '\r')) n--;
+        tok[n] = '\0';
+        p += strcspn(p, ",");
+        if (*p == ',') p++;
+        if (n == 0) continue;
+
+        char *eq = strchr(tok, '=');
+        if (!eq) return ESP_ERR_INVALID_ARG;
+        *eq = '\0';
+        int idx = gpio_hal_find(tok);
+        int on;
+        if (idx < 0 || !http_hal_parse_bool(eq + 1, &on)) return ESP_ERR_INVALID_ARG;
+
+        mask |= 1ULL << idx;
+        if (on) values |= 1ULL << idx;
+    }
+    if (mask == 0) return ESP_ERR_INVALID_ARG;
+
+    gpio_hal_compile(mask, values, out);
+    return ESP_OK;
+}
+
+static bool canonical_spec(const gpio_hal_compiled_t *w, char *out, size_t size)
+{
+    // stored specs hold only channel names and on/off, so they can be echoed as JSON
+    size_t len = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < gpio_hal_channel_count(); i++) {
+        if (!((w->mask >> i) & 1ULL)) continue;
+        int n = snprintf(out + len, size - len, "%s%s=%s", len ? "," : "",
+                         gpio_hal_channel(i)->name, ((w->values >> i) & 1ULL) ? "on" : "off");
+        if (n < 0 || (size_t)n >= size - len) return false;
+        len += (size_t)n;
+    }
+    return true;
+}
+
+static scene_t *find_locked(const char *name)
+{
+    for (size_t i = 0; i < s_len; i++) {
+        if (!strcmp(s_scenes[i].name, name)) return &s_scenes[i];
+    }
+    return NULL;
+}
+
+static esp_err_t put_locked(const char *name, const gpio_hal_compiled_t *w)
+{
+    scene_t *s = find_locked(name);
+    if (!s) {
+        if (s_len >= SCENE_MAX) return ESP_ERR_NO_MEM;
+        s = &s_scenes[s_len++];
+        snprintf(s->name, sizeof(s->name), "%s", name);
+    }
+    s->write = *w;
+    return ESP_OK;
+}
+
+/* ====== API ====== */
+
+esp_err_t scene_init(void)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SCENE_NS, NVS_READONLY, &nvs);
+    // the namespace only exists once a scene was saved
+    if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_OK;
+    ESP_RETURN_ON_ERROR(err, TAG, "nvs_open failed");
+
+    char spec[SPEC_MAX];
+    nvs_iterator_t it = NULL;
+    err = nvs_entry_find(NVS_DEFAULT_PART_NAME, SCENE_NS, NVS_TYPE_STR, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+
+        size_t len = sizeof(spec);
+        gpio_hal_compiled_t w;
+        if (nvs_get_str(nvs, info.key, spec, &len) != ESP_OK || compile_spec(spec, &w) != ESP_OK) {
+            ESP_LOGW(TAG, "Skipping scene '%s' (unreadable or unknown channel)", info.key);
+        } else {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            if (put_locked(info.key, &w) != ESP_OK) {
+                ESP_LOGW(TAG, "Scene table full, '%s' not loaded", info.key);
+            }
+            xSemaphoreGive(s_lock);
+        }
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    nvs_close(nvs);
+
+    LOG("Loaded %u scenes", (unsigned)s_len);
+    return ESP_OK;
+}
+
+esp_err_t scene_save(const char *name, const char *spec)
+{
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    if (!valid_name(name) || !spec || strlen(spec) >= SPEC_MAX) return ESP_ERR_INVALID_ARG;
+
+    gpio_hal_compiled_t w;
+    char canon[SPEC_MAX];
+    ESP_RETURN_ON_ERROR(compile_spec(spec, &w), TAG, "bad spec");
+    if (!canonical_spec(&w, canon, sizeof(canon))) return ESP_ERR_INVALID_ARG;
+
+    // the lock covers the check and both writes, so two saves cannot overfill the table
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!find_locked(name) && s_len >= SCENE_MAX) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // flash first, so the RAM table never holds a scene that would not survive a reboot
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SCENE_NS, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, name, canon);
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err == ESP_OK) err = put_locked(name, &w);
+    xSemaphoreGive(s_lock);
+    if (err != ESP_OK) ESP_LOGE(TAG, "save '%s' failed: %s", name, esp_err_to_name(err));
+    return err;
+}
+
+esp_err_t scene_delete(const char *name)
+{
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    if (!valid_name(name)) return ESP_ERR_NOT_FOUND;
+
+    // flash first: a failed erase keeps the scene in RAM too, so both stay in sync
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    scene_t *s = find_locked(name);
+    esp_err_t err = s ? ESP_OK : ESP_ERR_NOT_FOUND;
+    nvs_handle_t nvs;
+    if (err == ESP_OK) err = nvs_open(SCENE_NS, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_erase_key(nvs, name);
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err == ESP_OK) *s = s_scenes[--s_len];
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t scene_apply(const char *name)
+{
+    return scene_apply_from(name, 0);
+}
+
+esp_err_t scene_apply_from(const char *name, uint32_t peer)
+{
+    ESP_RETURN_ON_FALSE(s_lock && name, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    scene_t *s = find_locked(name);
+    gpio_hal_compiled_t w;
+    if (s) w = s->write;
+    xSemaphoreGive(s_lock);
+    if (!s) return ESP_ERR_NOT_FOUND;
+
+    gpio_hal_src_t src = { GPIO_HAL_SRC_SCENE, peer };
+    gpio_hal_apply_src(&w, &src);
+    return ESP_OK;
+}
+
+/* ====== Handlers: /api/scene ====== */
+
+static esp_err_t send_scene_list(httpd_req_t *req)
+{
+    char line[96];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"ok\":true,\"scenes\":[");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_len; i++) {
+        snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"mask\":\"%llx\",\"values\":\"%llx\"}",
+                 i ? "," : "", s_scenes[i].name,
+                 (unsigned long long)s_scenes[i].write.mask,
+                 (unsigned long long)s_scenes[i].write.values);
+        httpd_resp_sendstr_chunk(req, line);
+    }
+    xSemaphoreGive(s_lock);
+
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t scene_get_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    char *name = query ? http_hal_scratch_query_value(req, query, "name") : NULL;
+    if (!name) return send_scene_list(req);
+    if (!valid_name(name)) return http_hal_send_err(req, 404, "Scene not found");
+
+    nvs_handle_t nvs;
+    char *spec = (char *)http_hal_scratch_alloc(req, SPEC_MAX);
+    size_t len = SPEC_MAX;
+    if (!spec) return http_hal_send_err(req, 500, "Out of scratch memory");
+    if (nvs_open(SCENE_NS, NVS_READONLY, &nvs) != ESP_OK) {
+        return http_hal_send_err(req, 404, "Scene not found");
+    }
+    esp_err_t err = nvs_get_str(nvs, name, spec, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK) return http_hal_send_err(req, 404, "Scene not found");
+
+    // stored specs are canonical (names and on/off only), no JSON escaping needed
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"ok\":true,\"name\":\"");
+    httpd_resp_sendstr_chunk(req, name);
+    httpd_resp_sendstr_chunk(req, "\",\"spec\":\"");
+    httpd_resp_sendstr_chunk(req, spec);
+    httpd_resp_sendstr_chunk(req, "\"}");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t scene_post_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    char *name = query ? http_hal_scratch_query_value(req, query, "name") : NULL;
+    if (!valid_name(name)) {
+        return http_hal_send_err(req, 400, "Invalid name (a-z, 0-9, _; max 15)");
+    }
+    if (req->content_len >= SPEC_MAX) {
+        return http_hal_send_err(req, 413, "Scene spec too long");
+    }
+    char *spec = http_hal_scratch_body(req, SPEC_MAX - 1);
+    if (!spec) {
+        return http_hal_send_err(req, 400, "Missing scene spec");
+    }
+
+    esp_err_t err = scene_save(name, spec);
+    if (err == ESP_ERR_INVALID_ARG) {
+        return http_hal_send_err(req, 400, "Invalid spec (use <channel>=on|off,...)");
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        return http_hal_send_err(req, 507, "Scene table full");
+    }
+    if (err != ESP_OK) {
+        return http_hal_send_err(req, 500, "Scene save failed");
+    }
+    return http_hal_send_json(req, 200, "{\"ok\":true}");
+}
+
+static esp_err_t scene_delete_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    char *name = query ? http_hal_scratch_query_value(req, query, "name") : NULL;
+
+    esp_err_t err = name ? scene_delete(name) : ESP_ERR_NOT_FOUND;
+    if (err == ESP_ERR_NOT_FOUND) {
+        return http_hal_send_err(req, 404, "Scene not found");
+    }
+    if (err != ESP_OK) {
+        return http_hal_send_err(req, 500, "Scene delete failed");
+    }
+    return http_hal_send_json(req, 200, "{\"ok\":true}");
+}
+
+static esp_err_t scene_apply_handler(httpd_req_t *req)
+{
+    char *query = http_hal_scratch_query(req);
+    char *name = query ? http_hal_scratch_query_value(req, query, "name") : NULL;
+    if (!name || scene_apply_from(name, http_hal_peer_ipv4(req)) != ESP_OK) {
+        return http_hal_send_err(req, 404, "Scene not found");
+    }
+
+    char *resp = http_hal_scratch_printf(req, "{\"ok\":true,\"mask\":\"%llx\"}",
+                                         (unsigned long long)gpio_hal_get_mask());
+    if (!resp) {
+        return http_hal_send_err(req, 500, "Out of scratch memory");
+    }
+    return http_hal_send_json(req, 200, resp);
+}
+
+// JSON-RPC scene.apply {name}
+static esp_err_t rpc_scene_apply(http_hal_rpc_call_t *call, void *ctx)
+{
+    const char *name = http_hal_rpc_param_str(call, "name");
+    if (!name || scene_apply_from(name, http_hal_peer_ipv4(http_hal_rpc_req(call))) != ESP_OK) {
+        return http_hal_rpc_error(call, HTTP_HAL_RPC_INVALID_PARAMS, "Scene not found");
+    }
+    return http_hal_rpc_result(call, "{\"mask\":\"%llx\"}", (unsigned long long)gpio_hal_get_mask());
+}
+
+esp_err_t scene_register_endpoints(http_hal_t *h)
+{
+    const http_hal_endpoint_t eps[] = {
+        { .uri = "/api/scene",       .method = HTTP_GET,    .handler = scene_get_handler,    .user_ctx = NULL },
+        { .uri = "/api/scene",       .method = HTTP_POST,   .handler = scene_post_handler,   .user_ctx = NULL },
+        { .uri = "/api/scene",       .method = HTTP_DELETE, .handler = scene_delete_handler, .user_ctx = NULL },
+        { .uri = "/api/scene/apply", .method = HTTP_GET,    .handler = scene_apply_handler,  .user_ctx = NULL },
+    };
+    for (size_t i = 0; i < sizeof(eps) / sizeof(eps[0]); i++) {
+        ESP_RETURN_ON_ERROR(http_hal_register_endpoint(h, &eps[i]), TAG, "register %s failed", eps[i].uri);
+    }
+    return http_hal_rpc_register_method(h, "scene.apply", rpc_scene_apply, NULL);
+}
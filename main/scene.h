@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file scene.h
+ * @brief Named output scenes stored in NVS
+ * A scene is a list of channel states such as "led=on,relay1=off". Scenes are
+ * stored as text in the "scenes" NVS namespace, so they survive changes to the
+ * channel order, and are compiled when loaded into a gpio_hal masked write.
+ * Applying a scene is then one request and one set of register stores.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCENE_NAME_MAX 15   // NVS key length limit
+
+/**
+ * @brief Load and compile all scenes from NVS
+ *
+ * Must run after nvs_flash_init() and gpio_hal_init(). Scenes naming channels
+ * that no longer exist are skipped with a warning.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t scene_init(void);
+
+/**
+ * @brief Create or replace a scene
+ *
+ * @param[in] name Scene name (a-z, 0-9, _; at most SCENE_NAME_MAX chars)
+ * @param[in] spec Channel states, "<channel>=<on|off>,..."
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad name or spec,
+ *         ESP_ERR_NO_MEM if the scene table is full
+ */
+esp_err_t scene_save(const char *name, const char *spec);
+
+/**
+ * @brief Delete a scene
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if it does not exist
+ */
+esp_err_t scene_delete(const char *name);
+
+/**
+ * @brief Apply a scene as one masked write
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if it does not exist
+ */
+esp_err_t scene_apply(const char *name);
+
+/**
+ * @brief Like scene_apply(), recording the client that asked for it
+ *
+ * @param[in] peer IPv4 address of the HTTP client (network order), 0 if none
+ */
+esp_err_t scene_apply_from(const char *name, uint32_t peer);
+
+/**
+ * @brief Register the /api/scene endpoints
+ *
+ * - GET    /api/scene                 lists scenes with their masks
+ * - GET    /api/scene?name=<n>        returns one scene
+ * - POST   /api/scene?name=<n>        creates/replaces it, body is the spec
+ * - DELETE /api/scene?name=<n>        deletes it
+ * - GET    /api/scene/apply?name=<n>  applies it
+ * - JSON-RPC method scene.apply {name}
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t scene_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,180 @@
+#include "state_log.h"
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STATE_LOG";
+
+#define LOG_LEN     CONFIG_STATE_LOG_LEN
+#define LOG_MASK    (LOG_LEN - 1)
+#define READ_BATCH  16
+#define MAX_DEFAULT 64
+#define FLAG_ON     0x01
+#define SRC_SHIFT   1
+
+_Static_assert((LOG_LEN & LOG_MASK) == 0, "STATE_LOG_LEN must be a power of two");
+
+// one array per field: no padding, and a reader copies only what it formats
+static uint32_t s_t_ms[LOG_LEN];
+static uint32_t s_peer[LOG_LEN];
+static uint8_t  s_channel[LOG_LEN];
+static uint8_t  s_flags[LOG_LEN];      // bit 0 new state, bits 1.. source kind
+static uint32_t s_head;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_src_names[] = {
+    [GPIO_HAL_SRC_LOCAL] = "local",
+    [GPIO_HAL_SRC_LED]   = "led",
+    [GPIO_HAL_SRC_OUT]   = "out",
+    [GPIO_HAL_SRC_SCENE] = "scene",
+    [GPIO_HAL_SRC_RPC]   = "rpc",
+    [GPIO_HAL_SRC_SCHED] = "sched",
+};
+
+static const char *src_name(gpio_hal_src_kind_t kind)
+{
+    return (size_t)kind < sizeof(s_src_names) / sizeof(s_src_names[0]) ? s_src_names[kind] : "?";
+}
+
+/* ====== Recording ====== */
+
+// runs under the gpio_hal lock, so entries and their timestamps follow the order of the writes
+static void on_transition(uint64_t changed, uint64_t state, const gpio_hal_src_t *src)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    while (changed) {
+        int ch = __builtin_ctzll(changed);
+        changed &= changed - 1;
+
+        uint32_t slot = s_head & LOG_MASK;
+        s_t_ms[slot] = t_ms;
+        s_peer[slot] = src->peer;
+        s_channel[slot] = (uint8_t)ch;
+        s_flags[slot] = (uint8_t)((((state >> ch) & 1ULL) ? FLAG_ON : 0) | (src->kind << SRC_SHIFT));
+        s_head++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* ====== API ====== */
+
+esp_err_t state_log_init(void)
+{
+    gpio_hal_set_transition_cb(on_transition);
+    ESP_LOGI(TAG, "Logging output transitions (%d entries)", LOG_LEN);
+    return ESP_OK;
+}
+
+uint32_t state_log_head(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t h = s_head;
+    portEXIT_CRITICAL(&s_lock);
+    return h;
+}
+
+size_t state_log_read(uint32_t *cursor, state_log_entry_t *out, size_t max, uint32_t *lost)
+{
+    uint32_t seq = *cursor;
+    uint32_t skipped = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t h = s_head;
+    // sequence numbers wrap, so compare distances rather than values
+    if (h - seq > LOG_LEN) {
+        uint32_t oldest = h > LOG_LEN ? h - LOG_LEN : 0;
+        skipped = oldest - seq;
+        seq = oldest;
+    }
+    size_t n = h - seq;
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t slot = (seq + i) & LOG_MASK;
+        out[i].t_ms = s_t_ms[slot];
+        out[i].peer = s_peer[slot];
+        out[i].channel = s_channel[slot];
+        out[i].on = s_flags[slot] & FLAG_ON;
+        out[i].src = (gpio_hal_src_kind_t)(s_flags[slot] >> SRC_SHIFT);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    *cursor = seq + n;
+    if (lost) *lost = skipped;
+    return n;
+}
+
+/* ====== Handler: GET /api/history ====== */
+
+static esp_err_t history_get_handler(httpd_req_t *req)
+{
+    uint32_t head = state_log_head();
+    uint32_t cursor = head > LOG_LEN ? head - LOG_LEN : 0;
+    int64_t max = MAX_DEFAULT;
+
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        char *max_str = http_hal_scratch_query_value(req, query, "max");
+        int64_t v;
+        if (since_str) {
+            if (!http_hal_parse_int(since_str, 0, UINT32_MAX, &v)) {
+                return http_hal_send_err(req, 400, "Invalid since");
+            }
+            cursor = (uint32_t)v;
+        }
+        if (max_str && !http_hal_parse_int(max_str, 1, LOG_LEN, &max)) {
+            return http_hal_send_err(req, 400, "Invalid max");
+        }
+    }
+
+    // read in small batches and stream them, the response size is not bounded by the arena
+    state_log_entry_t batch[READ_BATCH];
+    char buf[512];
+    uint32_t lost_total = 0, first = cursor;
+    size_t remaining = (size_t)max, sent = 0;
+
+    http_hal_stream_t o;
+    http_hal_stream_begin(&o, req, buf, sizeof(buf), "application/json");
+    http_hal_stream_printf(&o, "{\"ok\":true,\"entries\":[");
+    // a dropped client ends the read at the first failed chunk
+    while (remaining > 0 && o.err == ESP_OK) {
+        uint32_t lost;
+        size_t n = state_log_read(&cursor, batch, remaining < READ_BATCH ? remaining : READ_BATCH, &lost);
+        lost_total += lost;
+        if (sent == 0) first = cursor - n;
+        if (n == 0) break;
+
+        for (size_t i = 0; i < n; i++) {
+            const state_log_entry_t *e = &batch[i];
+            const gpio_hal_channel_t *ch = gpio_hal_channel(e->channel);
+            const uint8_t *ip = (const uint8_t *)&e->peer;
+            char peer[16] = "";
+            if (e->peer) snprintf(peer, sizeof(peer), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+            http_hal_stream_printf(&o, "%s[%lu,\"%s\",%d,%d,\"%s\",\"%s\"]",
+                                   sent + i ? "," : "", (unsigned long)e->t_ms, ch ? ch->name : "?",
+                                   !e->on, e->on, src_name(e->src), peer);
+        }
+        sent += n;
+        remaining -= n;
+    }
+
+    http_hal_stream_printf(&o, "],\"first\":%u,\"next\":%u,\"head\":%u,\"lost\":%u}",
+                           (unsigned)first, (unsigned)cursor, (unsigned)state_log_head(), (unsigned)lost_total);
+    return http_hal_stream_end(&o);
+}
+
+esp_err_t state_log_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/history",
+        .method = HTTP_GET,
+        .handler = history_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file state_log.h
+ * @brief History of output channel transitions
+ * Every write through gpio_hal that flips a channel adds one entry per flipped
+ * channel: time, channel, old/new state, source (endpoint) and client address.
+ * Entries live in a ring stored column by column (10 bytes per entry instead
+ * of a padded 16-byte struct) and carry sequence numbers, so a client keeps a
+ * cursor and fetches only what happened since its last call, as with
+ * gpio_capture. Outputs driven by the scheduler, PWM or RMT bypass gpio_hal
+ * and are not logged.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "http_hal.h"
+#include "gpio_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One transition
+ */
+typedef struct {
+    uint32_t            t_ms;       // ms since boot
+    uint8_t             channel;    // gpio_hal channel index
+    bool                on;         // new logical state, the old one is !on
+    gpio_hal_src_kind_t src;
+    uint32_t            peer;       // client IPv4 (network order), 0 if local
+} state_log_entry_t;
+
+/**
+ * @brief Start logging transitions (installs the gpio_hal transition hook)
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t state_log_init(void);
+
+/**
+ * @brief Sequence number the next entry will get
+ */
+uint32_t state_log_head(void);
+
+/**
+ * @brief Copy entries starting at *cursor and advance the cursor
+ *
+ * @param[in,out] cursor Sequence number of the next entry to read
+ * @param[out]    out    Entries
+ * @param[in]     max    Capacity of out
+ * @param[out]    lost   Optional, entries overwritten before they were read
+ * @return Number of entries copied
+ */
+size_t state_log_read(uint32_t *cursor, state_log_entry_t *out, size_t max, uint32_t *lost);
+
+/**
+ * @brief Register the GET /api/history endpoint
+ *
+ * Query parameters:
+ * - since=<seq> cursor returned as "next" by the previous call (default:
+ *   oldest entry kept)
+ * - max=<n> maximum number of entries to return
+ * Entries are [t_ms, "channel", old, new, "source", "client"] starting at
+ * "first"; client is "" for local writes.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t state_log_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+#include "stream_codec.h"
+
+#include <string.h>
+
+/* ====== Output ====== */
+
+static void put_byte(stream_codec_enc_t *e, uint8_t b)
+{
+    if (e->len == e->cap) {
+        if (stream_codec_flush(e) != ESP_OK) return;
+    }
+    e->buf[e->len++] = b;
+    e->bytes++;
+}
+
+static void put_varint(stream_codec_enc_t *e, uint32_t v)
+{
+    while (v >= 0x80) {
+        put_byte(e, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(e, (uint8_t)v);
+}
+
+static void put_le(stream_codec_enc_t *e, uint32_t v, int n)
+{
+    for (int i = 0; i < n; i++) put_byte(e, (uint8_t)(v >> (8 * i)));
+}
+
+/* ====== API ====== */
+
+void stream_codec_init(stream_codec_enc_t *e, uint8_t *buf, size_t cap, stream_codec_flush_t flush, void *ctx)
+{
+    memset(e, 0, sizeof(*e));
+    e->buf = buf;
+    e->cap = cap;
+    e->flush = flush;
+    e->ctx = ctx;
+}
+
+void stream_codec_frame(stream_codec_enc_t *e, uint32_t seq, uint32_t t_us, uint32_t channel_mask, uint16_t lost)
+{
+    put_byte(e, STREAM_CODEC_MAGIC);
+    put_byte(e, STREAM_CODEC_VERSION);
+    put_le(e, lost, 2);
+    put_le(e, seq, 4);
+    put_le(e, t_us, 4);
+    put_le(e, channel_mask, 4);
+}
+
+void stream_codec_channel(stream_codec_enc_t *e, uint32_t count)
+{
+    put_varint(e, count);
+    e->prev = 0;
+}
+
+void stream_codec_value(stream_codec_enc_t *e, uint32_t value)
+{
+    // zigzag maps small negative steps to small unsigned numbers
+    int32_t d = (int32_t)(value - e->prev);
+    put_varint(e, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+    e->prev = value;
+}
+
+esp_err_t stream_codec_flush(stream_codec_enc_t *e)
+{
+    if (e->err != ESP_OK) return e->err;
+    if (e->len > 0) {
+        e->err = e->flush(e->ctx, e->buf, e->len);
+        e->len = 0;
+    }
+    return e->err;
+}
+
+esp_err_t stream_codec_http_flush(void *ctx, const uint8_t *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, (const char *)data, len);
+}
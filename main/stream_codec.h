@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file stream_codec.h
+ * @brief Compact binary frames for sample streams
+ * A stream is a plain sequence of frames, each one self-delimiting:
+ *
+ *   offset size  field
+ *   0      1     magic 0xA5
+ *   1      1     version (1)
+ *   2      2     lost: frames/blocks dropped before this one (LE)
+ *   4      4     seq: sequence number of the frame (LE)
+ *   8      4     t_us: timestamp, low 32 bits of esp_timer (LE)
+ *   12     4     channel mask, bit i = channel i present (LE)
+ *   16     ...   one section per channel in the mask, lowest first:
+ *                varint count, then count varints, each the zigzag-encoded
+ *                difference to the previous value of that channel (the
+ *                first one relative to 0)
+ *
+ * Varints are LEB128 (7 bits per byte, low bits first). Values are 32-bit and
+ * differences wrap modulo 2^32, so counters and timestamps encode as small
+ * steps. Slowly changing 12-bit sensor data takes 1 byte per sample instead
+ * of 2 (raw) or 5-6 (JSON). tools/stream_decode.py decodes the format.
+ *
+ * The encoder never holds a whole frame: it writes into a small caller
+ * buffer and hands it to a flush callback (e.g. httpd_resp_send_chunk)
+ * whenever it fills up.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STREAM_CODEC_MAGIC      0xA5
+#define STREAM_CODEC_VERSION    1
+#define STREAM_CODEC_HDR_LEN    16
+#define STREAM_CODEC_MIME       "application/x-sample-frames"
+
+/**
+ * @brief Flush callback, called with the bytes encoded so far
+ */
+typedef esp_err_t (*stream_codec_flush_t)(void *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Encoder state
+ */
+typedef struct {
+    uint8_t             *buf;
+    size_t               cap;
+    size_t               len;
+    stream_codec_flush_t flush;
+    void                *ctx;
+    esp_err_t            err;       // first flush error, later writes are dropped
+    uint32_t             prev;      // previous value of the current channel
+    uint32_t             bytes;     // total bytes produced
+} stream_codec_enc_t;
+
+/**
+ * @brief Initialize an encoder
+ *
+ * @param[out] e     Encoder
+ * @param[in]  buf   Output buffer, at least STREAM_CODEC_HDR_LEN bytes
+ * @param[in]  cap   Buffer size
+ * @param[in]  flush Flush callback
+ * @param[in]  ctx   Callback argument
+ */
+void stream_codec_init(stream_codec_enc_t *e, uint8_t *buf, size_t cap, stream_codec_flush_t flush, void *ctx);
+
+/**
+ * @brief Start a frame
+ *
+ * Exactly one stream_codec_channel() section must follow for each bit of
+ * channel_mask, in ascending channel order.
+ */
+void stream_codec_frame(stream_codec_enc_t *e, uint32_t seq, uint32_t t_us, uint32_t channel_mask, uint16_t lost);
+
+/**
+ * @brief Start the section of the next channel
+ *
+ * @param[in] count Number of stream_codec_value() calls that follow
+ */
+void stream_codec_channel(stream_codec_enc_t *e, uint32_t count);
+
+/**
+ * @brief Append one value to the current channel
+ */
+void stream_codec_value(stream_codec_enc_t *e, uint32_t value);
+
+/**
+ * @brief Flush buffered bytes
+ *
+ * @return ESP_OK, or the first error returned by the flush callback
+ */
+esp_err_t stream_codec_flush(stream_codec_enc_t *e);
+
+/**
+ * @brief Flush callback sending the data as an HTTP chunk (ctx = httpd_req_t *)
+ */
+esp_err_t stream_codec_http_flush(void *ctx, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
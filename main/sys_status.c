@@ -0,0 +1,130 @@
+#include "sys_status.h"
+
+#include <string.h>
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "gpio_hal.h"
+#include "wifi.h"
+
+static const char *TAG = "SYS_STATUS";
+
+#define OUT_BUF 256
+
+typedef struct {
+    uint64_t            uptime_ms;
+    uint64_t            outputs;
+    uint32_t            version;
+    bool                connected;
+    wifi_ap_record_t    ap;
+    esp_netif_ip_info_t ip;
+    uint8_t             mac[6];
+    uint32_t            heap_free;
+    uint32_t            heap_min;
+    uint32_t            heap_largest;
+    http_hal_stats_t    http;
+} snapshot_t;
+
+/* ====== Snapshot ====== */
+
+static void take_snapshot(http_hal_t *h, snapshot_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->uptime_ms = (uint64_t)(esp_timer_get_time() / 1000);
+    s->outputs = gpio_hal_snapshot(&s->version);
+
+    s->connected = esp_wifi_sta_get_ap_info(&s->ap) == ESP_OK;
+    esp_netif_t *netif = wifi_get_netif_sta();
+    if (netif) {
+        esp_netif_get_ip_info(netif, &s->ip);
+        esp_netif_get_mac(netif, s->mac);
+    }
+
+    s->heap_free = esp_get_free_heap_size();
+    s->heap_min = esp_get_minimum_free_heap_size();
+    s->heap_largest = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (http_hal_get_stats(h, &s->http) != ESP_OK) {
+        ESP_LOGW(TAG, "No HTTP stats");
+    }
+}
+
+/* ====== Handler: GET /api/status ====== */
+
+static void out_names(http_hal_stream_t *o, const char *key, const snapshot_t *s, bool pins)
+{
+    http_hal_stream_printf(o, ",\"%s\":{", key);
+    for (size_t i = 0; i < gpio_hal_channel_count(); i++) {
+        const gpio_hal_channel_t *ch = gpio_hal_channel(i);
+        http_hal_stream_printf(o, "%s\"%s\":%d", i ? "," : "", ch->name,
+                               pins ? (int)ch->pin : (int)((s->outputs >> i) & 1ULL));
+    }
+    http_hal_stream_printf(o, "}");
+}
+
+static esp_err_t status_get_handler(httpd_req_t *req)
+{
+    http_hal_t *h = (http_hal_t *)req->user_ctx;
+    snapshot_t s;
+    char buf[OUT_BUF];
+
+    // read everything before the first byte goes out, a slow client cannot skew it
+    take_snapshot(h, &s);
+
+    http_hal_stream_t out, *o = &out;
+    http_hal_stream_begin(o, req, buf, sizeof(buf), "application/json");
+    http_hal_stream_printf(o, "{\"ok\":true,\"uptime_ms\":%llu,\"outputs\":{\"version\":%lu",
+                           (unsigned long long)s.uptime_ms, (unsigned long)s.version);
+    out_names(o, "state", &s, false);
+    out_names(o, "pins", &s, true);
+
+    const uint8_t *b = s.ap.bssid;
+    http_hal_stream_printf(o, "},\"wifi\":{\"connected\":%s", s.connected ? "true" : "false");
+    if (s.connected) {
+        // SSIDs are at most 32 bytes but may hold quotes, keep only printable safe ones
+        char ssid[33];
+        size_t n = 0;
+        for (size_t i = 0; i < 32 && s.ap.ssid[i]; i++) {
+            char c = (char)s.ap.ssid[i];
+            if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') ssid[n++] = c;
+        }
+        ssid[n] = '\0';
+        http_hal_stream_printf(o, ",\"ssid\":\"%s\",\"rssi\":%d,\"channel\":%u", ssid, s.ap.rssi, s.ap.primary);
+        http_hal_stream_printf(o, ",\"bssid\":\"%02x:%02x:%02x:%02x:%02x:%02x\"",
+                               b[0], b[1], b[2], b[3], b[4], b[5]);
+    }
+    http_hal_stream_printf(o, ",\"ip\":\"" IPSTR "\"", IP2STR(&s.ip.ip));
+    http_hal_stream_printf(o, ",\"mask\":\"" IPSTR "\"", IP2STR(&s.ip.netmask));
+    http_hal_stream_printf(o, ",\"gw\":\"" IPSTR "\"", IP2STR(&s.ip.gw));
+    http_hal_stream_printf(o, ",\"mac\":\"%02x:%02x:%02x:%02x:%02x:%02x\"}",
+                           s.mac[0], s.mac[1], s.mac[2], s.mac[3], s.mac[4], s.mac[5]);
+
+    http_hal_stream_printf(o, ",\"heap\":{\"free\":%lu,\"min_free\":%lu,\"largest\":%lu}",
+                           (unsigned long)s.heap_free, (unsigned long)s.heap_min,
+                           (unsigned long)s.heap_largest);
+
+    const http_hal_stats_t *st = &s.http;
+    http_hal_stream_printf(o, ",\"http\":{\"requests\":%lu,\"open_sockets\":%lu,\"in_flight\":%lu",
+                           (unsigned long)st->requests, (unsigned long)st->open_sockets,
+                           (unsigned long)st->in_flight);
+    http_hal_stream_printf(o, ",\"parked\":%lu,\"routes\":%lu,\"sessions\":%lu",
+                           (unsigned long)st->parked, (unsigned long)st->routes,
+                           (unsigned long)st->sessions);
+    http_hal_stream_printf(o, ",\"scratch_size\":%lu,\"scratch_peak\":%lu}}",
+                           (unsigned long)st->scratch_size, (unsigned long)st->scratch_peak);
+    return http_hal_stream_end(o);
+}
+
+esp_err_t sys_status_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/status",
+        .method = HTTP_GET,
+        .handler = status_get_handler,
+        .user_ctx = h
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
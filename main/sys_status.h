@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file sys_status.h
+ * @brief One-request device snapshot
+ * GET /api/status returns in one response what a dashboard would otherwise
+ * poll from several endpoints: every output with its state and the state
+ * version, the Wi-Fi link, uptime, heap and HTTP server counters. All values
+ * are read first and then streamed through a small fixed buffer, so the
+ * output list is consistent with its version and the response size does not
+ * depend on the scratch arena.
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Register GET /api/status
+ *
+ * Response fields: "uptime_ms", "outputs" ({"version", "state": {name: 0|1},
+ * "pins": {name: gpio}}), "wifi" ({"connected", "ssid", "bssid", "rssi",
+ * "channel", "ip", "mask", "gw", "mac"}), "heap" ({"free", "min_free",
+ * "largest"}) and "http" (see http_hal_stats_t).
+ *
+ * @param[in] h HAL instance, its statistics are reported
+ * @return ESP_OK on success
+ */
+esp_err_t sys_status_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
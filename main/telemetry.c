@@ -0,0 +1,318 @@
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "TELEMETRY";
+
+#define SAMPLE_MS       1000
+#define TASK_STACK      2560
+#define TASK_PRIO       1
+#define SEC_BUCKETS     CONFIG_TELEMETRY_SEC_BUCKETS
+#define MIN_BUCKETS     CONFIG_TELEMETRY_MIN_BUCKETS
+#define HOUR_BUCKETS    CONFIG_TELEMETRY_HOUR_BUCKETS
+
+typedef struct {
+    int64_t  sum;
+    int32_t  min;
+    int32_t  max;
+    uint32_t count;
+} acc_t;
+
+typedef struct {
+    const char         *name;
+    uint32_t            period_s;
+    size_t              len;
+    telemetry_bucket_t *ring;       // [TELEMETRY_METRICS][len]
+    uint32_t            head;       // buckets closed so far
+    acc_t               acc[TELEMETRY_METRICS];
+} level_t;
+
+static telemetry_bucket_t s_ring_sec[TELEMETRY_METRICS][SEC_BUCKETS];
+static telemetry_bucket_t s_ring_min[TELEMETRY_METRICS][MIN_BUCKETS];
+static telemetry_bucket_t s_ring_hour[TELEMETRY_METRICS][HOUR_BUCKETS];
+
+static level_t s_levels[TELEMETRY_RESOLUTIONS] = {
+    [TELEMETRY_RES_SEC]  = { "1s", 1,    SEC_BUCKETS,  &s_ring_sec[0][0] },
+    [TELEMETRY_RES_MIN]  = { "1m", 60,   MIN_BUCKETS,  &s_ring_min[0][0] },
+    [TELEMETRY_RES_HOUR] = { "1h", 3600, HOUR_BUCKETS, &s_ring_hour[0][0] },
+};
+
+static const char *const s_metric_names[TELEMETRY_METRICS] = {
+    [TELEMETRY_RSSI]       = "rssi",
+    [TELEMETRY_HEAP_FREE]  = "heap",
+    [TELEMETRY_HEAP_BLOCK] = "heap_block",
+    [TELEMETRY_REQ_RATE]   = "req_rate",
+};
+
+static SemaphoreHandle_t s_lock;
+static http_hal_t *s_http;
+static uint32_t s_uptime;
+
+/* ====== Rollups ====== */
+
+static void acc_add(acc_t *a, int32_t v)
+{
+    if (a->count == 0 || v < a->min) a->min = v;
+    if (a->count == 0 || v > a->max) a->max = v;
+    a->sum += v;
+    a->count++;
+}
+
+static telemetry_bucket_t acc_bucket(const acc_t *a)
+{
+    telemetry_bucket_t b = { 0 };
+    if (a->count > 0) {
+        b.min = a->min;
+        b.max = a->max;
+        b.avg = (int32_t)(a->sum / (int64_t)a->count);
+        b.count = a->count;
+    }
+    return b;
+}
+
+// called with s_lock held, once per second
+static void add_sample(const int32_t *v, const bool *valid)
+{
+    s_uptime++;
+    for (size_t r = 0; r < TELEMETRY_RESOLUTIONS; r++) {
+        level_t *l = &s_levels[r];
+        for (size_t m = 0; m < TELEMETRY_METRICS; m++) {
+            if (valid[m]) acc_add(&l->acc[m], v[m]);
+        }
+        if (s_uptime % l->period_s != 0) continue;
+
+        size_t slot = l->head % l->len;
+        for (size_t m = 0; m < TELEMETRY_METRICS; m++) {
+            l->ring[m * l->len + slot] = acc_bucket(&l->acc[m]);
+            memset(&l->acc[m], 0, sizeof(acc_t));
+        }
+        l->head++;
+    }
+}
+
+/* ====== Task ====== */
+
+static void telemetry_task(void *arg)
+{
+    (void)arg;
+    uint32_t prev_req = http_hal_request_count(s_http);
+    TickType_t last = xTaskGetTickCount();
+
+    for (;;) {
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(SAMPLE_MS));
+
+        int32_t v[TELEMETRY_METRICS];
+        bool valid[TELEMETRY_METRICS] = { false };
+
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+            v[TELEMETRY_RSSI] = ap.rssi;
+            valid[TELEMETRY_RSSI] = true;
+        }
+        v[TELEMETRY_HEAP_FREE] = (int32_t)esp_get_free_heap_size();
+        valid[TELEMETRY_HEAP_FREE] = true;
+        v[TELEMETRY_HEAP_BLOCK] = (int32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+        valid[TELEMETRY_HEAP_BLOCK] = true;
+        uint32_t req = http_hal_request_count(s_http);
+        v[TELEMETRY_REQ_RATE] = (int32_t)(req - prev_req);
+        valid[TELEMETRY_REQ_RATE] = s_http != NULL;
+        prev_req = req;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        add_sample(v, valid);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+/* ====== API ====== */
+
+esp_err_t telemetry_start(http_hal_t *h)
+{
+    ESP_RETURN_ON_FALSE(!s_lock, ESP_ERR_INVALID_STATE, TAG, "already started");
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "no mem for lock");
+    s_http = h;
+
+    if (xTaskCreate(telemetry_task, "telemetry", TASK_STACK, NULL, TASK_PRIO, NULL) != pdPASS) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "History: %d x 1s, %d x 1m, %d x 1h", SEC_BUCKETS, MIN_BUCKETS, HOUR_BUCKETS);
+    return ESP_OK;
+}
+
+const char *telemetry_metric_name(telemetry_metric_t m)
+{
+    return m < TELEMETRY_METRICS ? s_metric_names[m] : "?";
+}
+
+size_t telemetry_read(telemetry_res_t res, uint32_t *seq, telemetry_bucket_t *out, size_t max,
+                      telemetry_bucket_t *open)
+{
+    if (!s_lock || res >= TELEMETRY_RESOLUTIONS) {
+        if (open) memset(open, 0, TELEMETRY_METRICS * sizeof(telemetry_bucket_t));
+        return 0;
+    }
+    level_t *l = &s_levels[res];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t head = l->head;
+    uint32_t s = *seq;
+    // sequence numbers wrap, so compare distances rather than values
+    if (head - s > l->len) {
+        s = head > l->len ? head - l->len : 0;
+    }
+    size_t n = head - s;
+    if (n > max) n = max;
+    for (size_t m = 0; m < TELEMETRY_METRICS; m++) {
+        for (size_t i = 0; i < n; i++) {
+            out[m * max + i] = l->ring[m * l->len + (s + i) % l->len];
+        }
+        if (open) open[m] = acc_bucket(&l->acc[m]);
+    }
+    xSemaphoreGive(s_lock);
+
+    *seq = s;
+    return n;
+}
+
+uint32_t telemetry_head(telemetry_res_t res)
+{
+    if (!s_lock || res >= TELEMETRY_RESOLUTIONS) return 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t head = s_levels[res].head;
+    xSemaphoreGive(s_lock);
+    return head;
+}
+
+size_t telemetry_read_metric(telemetry_res_t res, telemetry_metric_t m, uint32_t seq,
+                             telemetry_bucket_t *out, size_t max)
+{
+    if (!s_lock || res >= TELEMETRY_RESOLUTIONS || m >= TELEMETRY_METRICS) return 0;
+    const level_t *l = &s_levels[res];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t n = l->head - seq;
+    if (n > l->len) n = 0;      // seq is ahead of head
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = l->ring[m * l->len + (seq + i) % l->len];
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+/* ====== Handler: GET /api/telemetry ====== */
+
+#define OUT_BUF     256
+#define READ_BATCH  16
+
+static void out_bucket(http_hal_stream_t *o, const char *prefix, const telemetry_bucket_t *b)
+{
+    http_hal_stream_printf(o, "%s[%ld,%ld,%ld,%lu]", prefix,
+                           (long)b->min, (long)b->max, (long)b->avg, (unsigned long)b->count);
+}
+
+static esp_err_t telemetry_get_handler(httpd_req_t *req)
+{
+    telemetry_res_t res = TELEMETRY_RES_MIN;
+    int metric = -1;
+    uint32_t seq = 0;       // too old: telemetry_read() starts from the oldest bucket kept
+
+    char *query = http_hal_scratch_query(req);
+    if (query) {
+        char *res_str = http_hal_scratch_query_value(req, query, "res");
+        char *since_str = http_hal_scratch_query_value(req, query, "since");
+        char *m_str = http_hal_scratch_query_value(req, query, "m");
+        int64_t v;
+        if (res_str) {
+            size_t r = 0;
+            while (r < TELEMETRY_RESOLUTIONS && strcmp(res_str, s_levels[r].name) != 0) r++;
+            if (r == TELEMETRY_RESOLUTIONS) {
+                return http_hal_send_err(req, 400, "Invalid res (1s, 1m, 1h)");
+            }
+            res = (telemetry_res_t)r;
+        }
+        if (since_str) {
+            if (!http_hal_parse_int(since_str, 0, UINT32_MAX, &v)) {
+                return http_hal_send_err(req, 400, "Invalid since");
+            }
+            seq = (uint32_t)v;
+        }
+        if (m_str) {
+            for (int m = 0; m < TELEMETRY_METRICS; m++) {
+                if (strcmp(m_str, s_metric_names[m]) == 0) metric = m;
+            }
+            if (metric < 0) {
+                return http_hal_send_err(req, 400, "Invalid m");
+            }
+        }
+    }
+    if (!s_lock) {
+        return http_hal_send_err(req, 503, "Telemetry not running");
+    }
+    const level_t *l = &s_levels[res];
+
+    // the window is fixed up front, then each metric is copied in small batches
+    // into the stack: a whole ring per metric does not fit the httpd stack or the arena
+    telemetry_bucket_t open[TELEMETRY_METRICS];
+    telemetry_bucket_t batch[READ_BATCH];
+    char buf[OUT_BUF];
+    telemetry_read(res, &seq, NULL, 0, open);
+    size_t n = telemetry_head(res) - seq;
+    if (n > l->len) n = l->len;
+
+    http_hal_stream_t out, *o = &out;
+    http_hal_stream_begin(o, req, buf, sizeof(buf), "application/json");
+    http_hal_stream_printf(o, "{\"ok\":true,\"uptime\":%lu,\"res\":\"%s\",\"period\":%lu,",
+                           (unsigned long)s_uptime, l->name, (unsigned long)l->period_s);
+    http_hal_stream_printf(o, "\"metrics\":{");
+
+    bool first_metric = true;
+    for (int m = 0; m < TELEMETRY_METRICS && o->err == ESP_OK; m++) {
+        if (metric >= 0 && m != metric) continue;
+        http_hal_stream_printf(o, "%s\"%s\":{\"open\":", first_metric ? "" : ",", s_metric_names[m]);
+        first_metric = false;
+        out_bucket(o, "", &open[m]);
+        http_hal_stream_printf(o, ",\"buckets\":[");
+        size_t i = 0;
+        while (i < n && o->err == ESP_OK) {
+            size_t want = n - i < READ_BATCH ? n - i : READ_BATCH;
+            size_t k = telemetry_read_metric(res, (telemetry_metric_t)m, seq + (uint32_t)i, batch, want);
+            if (k == 0) break;
+            for (size_t j = 0; j < k; j++) {
+                out_bucket(o, i + j ? "," : "", &batch[j]);
+            }
+            i += k;
+        }
+        // the ring may move on while sending: later metrics stop where this one did
+        n = i;
+        http_hal_stream_printf(o, "]}");
+    }
+    // next counts the buckets every metric got, so a poll from there leaves no gap
+    http_hal_stream_printf(o, "},\"first\":%lu,\"next\":%lu}", (unsigned long)seq, (unsigned long)(seq + n));
+    return http_hal_stream_end(o);
+}
+
+esp_err_t telemetry_register_endpoints(http_hal_t *h)
+{
+    http_hal_endpoint_t ep = {
+        .uri = "/api/telemetry",
+        .method = HTTP_GET,
+        .handler = telemetry_get_handler,
+        .user_ctx = NULL
+    };
+    return http_hal_register_endpoint(h, &ep);
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * Copyright (c) 2025 Marconatale Parise.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+/**
+ * @file telemetry.h
+ * @brief Fixed-memory history of device metrics
+ * A housekeeping task samples Wi-Fi RSSI, free heap, the largest free heap
+ * block and the HTTP request rate once per second. Each sample feeds three
+ * resolutions (1 s, 1 min, 1 h); every resolution keeps a ring of closed
+ * buckets with min/max/avg/count, so memory is fixed at build time and a
+ * dashboard gets hours of history in one request.
+ * Bucket n of a resolution covers seconds [n * period, (n + 1) * period)
+ * after telemetry_start(); a bucket with count 0 had no valid sample (e.g.
+ * RSSI while disconnected).
+ * @author Marconatale Parise
+ * @date 16 Oct 2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "http_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TELEMETRY_RSSI,         // dBm of the associated AP
+    TELEMETRY_HEAP_FREE,    // free heap, bytes
+    TELEMETRY_HEAP_BLOCK,   // largest free heap block, bytes
+    TELEMETRY_REQ_RATE,     // HTTP requests per second
+    TELEMETRY_METRICS
+} telemetry_metric_t;
+
+typedef enum {
+    TELEMETRY_RES_SEC,
+    TELEMETRY_RES_MIN,
+    TELEMETRY_RES_HOUR,
+    TELEMETRY_RESOLUTIONS
+} telemetry_res_t;
+
+/**
+ * @brief Rollup of the samples of one period
+ */
+typedef struct {
+    int32_t  min;
+    int32_t  max;
+    int32_t  avg;
+    uint32_t count;
+} telemetry_bucket_t;
+
+/**
+ * @brief Start the sampling task
+ *
+ * @param[in] h HAL instance whose requests are counted (may be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t telemetry_start(http_hal_t *h);
+
+/**
+ * @brief Name of a metric as used by the endpoint
+ */
+const char *telemetry_metric_name(telemetry_metric_t m);
+
+/**
+ * @brief Copy closed buckets of all metrics
+ *
+ * All metrics are copied at the same instant, so out[m * max + i] are the
+ * buckets of metric m and share sequence numbers.
+ *
+ * @param[in]     res    Resolution
+ * @param[in,out] seq    In: first bucket wanted; out: first bucket copied
+ *                       (moved forward if the wanted one was overwritten)
+ * @param[out]    out    TELEMETRY_METRICS * max buckets (may be NULL if max is 0)
+ * @param[in]     max    Buckets per metric
+ * @param[out]    open   Optional, TELEMETRY_METRICS buckets: the period
+ *                       still being accumulated
+ * @return Number of buckets copied per metric
+ */
+size_t telemetry_read(telemetry_res_t res, uint32_t *seq, telemetry_bucket_t *out, size_t max,
+                      telemetry_bucket_t *open);
+
+/**
+ * @brief Sequence number of the next bucket to be closed
+ */
+uint32_t telemetry_head(telemetry_res_t res);
+
+/**
+ * @brief Copy closed buckets of one metric, from seq on
+ *
+ * Used to read a window in small batches. Buckets overwritten since the
+ * window was chosen are returned with their newer content.
+ *
+ * @param[in]  res Resolution
+ * @param[in]  m   Metric
+ * @param[in]  seq First bucket wanted
+ * @param[out] out max buckets
+ * @param[in]  max Buckets wanted
+ * @return Number of buckets copied (fewer than max only past the last closed one)
+ */
+size_t telemetry_read_metric(telemetry_res_t res, telemetry_metric_t m, uint32_t seq,
+                             telemetry_bucket_t *out, size_t max);
+
+/**
+ * @brief Register GET /api/telemetry
+ *
+ * Query parameters:
+ * - res=1s|1m|1h resolution (default 1m)
+ * - since=<seq> first bucket (default: oldest kept), pass "next" to poll
+ * - m=<name> only this metric (rssi, heap, heap_block, req_rate)
+ * Each metric carries "buckets" ([min,max,avg,count], oldest first, starting
+ * at "first") and "open", the bucket being filled. "first" and "next" follow
+ * the metrics and cover the buckets every metric got: if the ring overwrote
+ * the window while sending, an earlier metric may list more of them.
+ *
+ * @param[in] h HAL instance
+ * @return ESP_OK on success
+ */
+esp_err_t telemetry_register_endpoints(http_hal_t *h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# Licensed under the Apache License, Version 2.0
+"""Fetch and decode the binary ADC stream of /api/adc/stream.
+
+Format: see main/adc_stream.h. Without --csv, prints one line per block;
+with --csv, writes "seq,channel,value" rows to stdout. --frames requests the
+compact delta-encoded frames (main/stream_codec.h) instead of raw blocks.
+
+  adc_stream.py <host> [--ms T] [--blocks N] [--since SEQ] [--csv] [--frames]
+"""
+import argparse
+import struct
+import sys
+import urllib.request
+
+import stream_decode
+
+STREAM_HDR = struct.Struct("<4sHHII")
+BLOCK_HDR = struct.Struct("<IIHH")
+
+
+def read_exact(resp, n):
+    data = resp.read(n)
+    if len(data) != n:
+        raise EOFError
+    return data
+
+
+def blocks(resp):
+    magic, version, block_samples, sample_hz, first = STREAM_HDR.unpack(read_exact(resp, STREAM_HDR.size))
+    if magic != b"ADCS" or version != 1:
+        raise ValueError("not an ADC stream")
+    yield {"block_samples": block_samples, "sample_hz": sample_hz, "first": first}
+    while True:
+        try:
+            seq, t_us, count, lost = BLOCK_HDR.unpack(read_exact(resp, BLOCK_HDR.size))
+        except EOFError:
+            return
+        samples = struct.unpack(f"<{count}H", read_exact(resp, count * 2))
+        yield {"seq": seq, "t_us": t_us, "lost": lost,
+               "samples": [(s >> 12, s & 0x0FFF) for s in samples]}
+
+
+def frame_blocks(resp):
+    # frames keep the samples of each channel together, the interleaving is lost
+    yield None
+    for fr in stream_decode.frames(resp):
+        yield {"seq": fr["seq"], "t_us": fr["t_us"], "lost": fr["lost"],
+               "samples": [(ch, v) for ch, values in fr["channels"].items() for v in values]}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("--ms", type=int, default=1000, help="stop after this long without new blocks")
+    ap.add_argument("--blocks", type=int)
+    ap.add_argument("--since", type=int)
+    ap.add_argument("--csv", action="store_true")
+    ap.add_argument("--frames", action="store_true", help="use the compact frame format")
+    args = ap.parse_args()
+
+    # the device ends a stream after ADC_STREAM_MAX_MS, continue from the next block
+    since, remaining = args.since, args.blocks
+    total = lost = 0
+    header = True
+    while remaining is None or remaining > 0:
+        query = [f"ms={args.ms}"]
+        if remaining:
+            query.append(f"blocks={remaining}")
+        if since is not None:
+            query.append(f"since={since}")
+        if args.frames:
+            query.append("fmt=frames")
+        url = f"http://{args.host}/api/adc/stream?{'&'.join(query)}"
+
+        got = 0
+        with urllib.request.urlopen(url) as resp:
+            it = frame_blocks(resp) if args.frames else blocks(resp)
+            info = next(it)
+            if info and header:
+                print(f"# {info['sample_hz']} Hz, {info['block_samples']} samples/block, first {info['first']}",
+                      file=sys.stderr)
+            header = False
+            for b in it:
+                got += 1
+                since = b["seq"] + 1
+                total += len(b["samples"])
+                lost += b["lost"]
+                if args.csv:
+                    for ch, v in b["samples"]:
+                        print(f"{b['seq']},{ch},{v}")
+                else:
+                    by_ch = {}
+                    for ch, v in b["samples"]:
+                        by_ch.setdefault(ch, []).append(v)
+                    means = " ".join(f"ch{ch}={sum(v) / len(v):.0f}" for ch, v in sorted(by_ch.items()))
+                    print(f"block {b['seq']} t={b['t_us']} n={len(b['samples'])} lost={b['lost']} {means}")
+        # nothing new within --ms: the stream went idle
+        if got == 0:
+            break
+        if remaining is not None:
+            remaining -= got
+    print(f"# {total} samples, {lost} blocks lost", file=sys.stderr)
+
+if __name__ == "__main__":
+    main()
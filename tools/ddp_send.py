@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# Licensed under the Apache License, Version 2.0
+"""Stream test frames to the LED strip over DDP.
+
+Each frame is split into datagrams of at most 480 pixels; the last one has the
+PUSH flag. Compare the sent rate with "fps" and "dropped" from /api/strip.
+
+  ddp_send.py <host> <pixels> [--fps F] [--seconds S] [--port P]
+"""
+import argparse
+import colorsys
+import socket
+import struct
+import time
+
+DDP_VER1 = 0x40
+DDP_PUSH = 0x01
+DDP_RGB24 = 0x0B
+DDP_ID_DISPLAY = 1
+MAX_DATA = 480 * 3
+
+
+def frame_packets(data, seq):
+    for off in range(0, len(data), MAX_DATA):
+        chunk = data[off:off + MAX_DATA]
+        flags = DDP_VER1 | (DDP_PUSH if off + len(chunk) == len(data) else 0)
+        yield struct.pack(">BBBBIH", flags, seq, DDP_RGB24, DDP_ID_DISPLAY, off, len(chunk)) + chunk
+
+
+def rainbow(pixels, t):
+    out = bytearray()
+    for i in range(pixels):
+        r, g, b = colorsys.hsv_to_rgb((i / pixels + t) % 1.0, 1.0, 0.3)
+        out += bytes((int(r * 255), int(g * 255), int(b * 255)))
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("pixels", type=int)
+    ap.add_argument("--fps", type=float, default=40.0)
+    ap.add_argument("--seconds", type=float, default=10.0)
+    ap.add_argument("--port", type=int, default=4048)
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    period = 1.0 / args.fps
+    start = time.monotonic()
+    frames = 0
+    seq = 1
+    while time.monotonic() - start < args.seconds:
+        t = time.monotonic() - start
+        for pkt in frame_packets(rainbow(args.pixels, t / 4), seq):
+            sock.sendto(pkt, (args.host, args.port))
+            seq = seq % 15 + 1
+        frames += 1
+        time.sleep(max(0.0, start + frames * period - time.monotonic()))
+    elapsed = time.monotonic() - start
+    print(f"{frames} frames in {elapsed:.1f} s ({frames / elapsed:.1f} fps)")
+
+
+if __name__ == "__main__":
+    main()
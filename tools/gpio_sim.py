@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# Licensed under the Apache License, Version 2.0
+"""Observe and drive the simulated GPIO pins of the linux target build.
+
+The firmware maps CONFIG_GPIO_SIM_PATH (layout: gpio_sim_map_t in
+main/gpio_backend.h). This tool maps the same file, so reads and writes are
+zero-copy and timestamps share the CLOCK_MONOTONIC time base.
+
+  gpio_sim.py show                      levels of all used pins
+  gpio_sim.py set <pin> <0|1>           inject an input level (an edge for
+                                        /api/gpio/capture)
+  gpio_sim.py watch [pin]               print output changes as they happen
+  gpio_sim.py latency <url> <pin> [-n N]
+                                        request-in to pin-change latency
+"""
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+import urllib.request
+
+MAGIC = 0x4F495047
+VERSION = 2
+HDR = struct.Struct("<IIII")
+PIN = struct.Struct("<IIIIqq")
+MODES = {0: "-", 1: "in", 2: "out"}
+
+
+class SimMap:
+    def __init__(self, path):
+        fd = os.open(path, os.O_RDWR)
+        try:
+            self.mm = mmap.mmap(fd, 0)
+        finally:
+            os.close(fd)
+        magic, version, self.pins, _ = HDR.unpack_from(self.mm, 0)
+        if magic != MAGIC:
+            sys.exit(f"{path}: not a GPIO simulation file (firmware not started?)")
+        if version != VERSION:
+            sys.exit(f"{path}: layout version {version}, expected {VERSION}")
+
+    def _off(self, pin):
+        if not 0 <= pin < self.pins:
+            sys.exit(f"pin {pin} out of range")
+        return HDR.size + pin * PIN.size
+
+    def read(self, pin):
+        # changes is odd while the writer updates level and t_ns: retry until stable
+        off = self._off(pin)
+        while True:
+            changes = struct.unpack_from("<I", self.mm, off + 8)[0]
+            if changes & 1:
+                continue
+            level, mode, _, _, t_ns, _ = PIN.unpack_from(self.mm, off)
+            if struct.unpack_from("<I", self.mm, off + 8)[0] == changes:
+                return level, mode, changes, t_ns
+
+    def set_level(self, pin, level):
+        # the firmware only reads input pins, so this process is their single writer
+        off = self._off(pin)
+        level = 1 if level else 0
+        if struct.unpack_from("<I", self.mm, off)[0] == level:
+            return
+        changes = struct.unpack_from("<I", self.mm, off + 8)[0]
+        struct.pack_into("<I", self.mm, off + 8, (changes + 1) & 0xFFFFFFFF)
+        struct.pack_into("<I", self.mm, off, level)
+        struct.pack_into("<q", self.mm, off + 16, time.monotonic_ns())
+        struct.pack_into("<I", self.mm, off + 8, (changes + 2) & 0xFFFFFFFF)
+
+
+def wait_change(sim, pin, changes, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        state = sim.read(pin)
+        if state[2] != changes:
+            return state
+    return None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--path", default="/tmp/esp_gpio_sim")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    sub.add_parser("show")
+    p = sub.add_parser("set")
+    p.add_argument("pin", type=int)
+    p.add_argument("level", type=int, choices=(0, 1))
+    p = sub.add_parser("watch")
+    p.add_argument("pin", type=int, nargs="?")
+    p = sub.add_parser("latency")
+    p.add_argument("url")
+    p.add_argument("pin", type=int)
+    p.add_argument("-n", type=int, default=20, help="number of requests")
+    args = ap.parse_args()
+
+    sim = SimMap(args.path)
+
+    if args.cmd == "show":
+        for pin in range(sim.pins):
+            level, mode, changes, t_ns = sim.read(pin)
+            if mode:
+                print(f"GPIO{pin:<3} {MODES.get(mode, '?'):>3} level={level} changes={changes} t_ns={t_ns}")
+    elif args.cmd == "set":
+        sim.set_level(args.pin, args.level)
+    elif args.cmd == "watch":
+        pins = [args.pin] if args.pin is not None else range(sim.pins)
+        last = {pin: sim.read(pin)[2] for pin in pins}
+        while True:
+            for pin in pins:
+                level, mode, changes, t_ns = sim.read(pin)
+                if changes != last[pin]:
+                    last[pin] = changes
+                    print(f"{t_ns / 1e9:.6f} GPIO{pin} -> {level}")
+            time.sleep(0.0005)
+    elif args.cmd == "latency":
+        # each request must change the pin: the caller passes a toggling URL, e.g.
+        # http://localhost:8080/api/out/led?state={state} with {state} alternating
+        samples = []
+        for i in range(args.n):
+            url = args.url.format(state="on" if i % 2 == 0 else "off", level=1 - i % 2)
+            changes = sim.read(args.pin)[2]
+            t0 = time.monotonic_ns()
+            urllib.request.urlopen(url, timeout=5).read()
+            state = wait_change(sim, args.pin, changes, 1.0)
+            if state is None:
+                print(f"request {i}: pin did not change")
+                continue
+            samples.append((state[3] - t0) / 1000)
+        if samples:
+            samples.sort()
+            print(f"n={len(samples)} min={samples[0]:.1f}us "
+                  f"p50={samples[len(samples) // 2]:.1f}us max={samples[-1]:.1f}us")
+
+
+if __name__ == "__main__":
+    main()
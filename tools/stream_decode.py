@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Marconatale Parise.
+# Licensed under the Apache License, Version 2.0
+"""Decode compact sample frames (application/x-sample-frames).
+
+Format: see main/stream_codec.h. Reads from an URL (e.g. a streaming endpoint
+with fmt=frames) or a file, and prints one line per frame or, with --csv,
+"seq,channel,index,value" rows. Can also be imported: frames() yields dicts.
+
+  stream_decode.py http://<host>/api/adc/stream?fmt=frames&ms=1000 [--csv]
+  stream_decode.py http://<host>/api/gpio/capture?fmt=frames
+  stream_decode.py capture.bin
+"""
+import argparse
+import struct
+import sys
+import urllib.request
+
+MAGIC = 0xA5
+VERSION = 1
+FRAME_HDR = struct.Struct("<BBHIII")
+
+
+def read_exact(f, n):
+    data = f.read(n)
+    if len(data) != n:
+        raise EOFError
+    return data
+
+
+def read_varint(f):
+    v = shift = 0
+    while True:
+        b = read_exact(f, 1)[0]
+        v |= (b & 0x7F) << shift
+        if b < 0x80:
+            return v
+        shift += 7
+
+
+def frames(f):
+    """Yield {"seq", "t_us", "lost", "channels": {ch: [values]}} per frame."""
+    while True:
+        hdr = f.read(FRAME_HDR.size)
+        if not hdr:
+            return
+        if len(hdr) != FRAME_HDR.size:
+            raise EOFError("truncated frame header")
+        magic, version, lost, seq, t_us, mask = FRAME_HDR.unpack(hdr)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"bad frame header {hdr[:2].hex()}")
+        channels = {}
+        for ch in range(32):
+            if not mask & (1 << ch):
+                continue
+            values, prev = [], 0
+            for _ in range(read_varint(f)):
+                z = read_varint(f)
+                prev = (prev + ((z >> 1) ^ -(z & 1))) & 0xFFFFFFFF
+                values.append(prev)
+            channels[ch] = values
+        yield {"seq": seq, "t_us": t_us, "lost": lost, "channels": channels}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("source", help="URL or file")
+    ap.add_argument("--csv", action="store_true")
+    args = ap.parse_args()
+
+    if "://" in args.source:
+        f = urllib.request.urlopen(args.source)
+    else:
+        f = open(args.source, "rb")
+    with f:
+        n_frames = n_values = lost = 0
+        for fr in frames(f):
+            n_frames += 1
+            lost += fr["lost"]
+            n_values += sum(len(v) for v in fr["channels"].values())
+            if args.csv:
+                for ch, values in fr["channels"].items():
+                    for i, v in enumerate(values):
+                        print(f"{fr['seq']},{ch},{i},{v}")
+            else:
+                desc = " ".join(f"ch{ch}:{len(v)}" for ch, v in fr["channels"].items())
+                print(f"frame {fr['seq']} t={fr['t_us']} lost={fr['lost']} {desc}")
+        print(f"# {n_frames} frames, {n_values} values, {lost} lost", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()